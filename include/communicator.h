@@ -33,6 +33,14 @@ struct tcore_communitor_operations {
         unsigned int data_len, const void *data);
 };
 
+struct tcore_communicator_batch_stats {
+	unsigned int queued;    /* held back for a batch window */
+	unsigned int merged;    /* superseded by a later one before delivery */
+	unsigned int dropped;   /* lost to allocation or delivery failure */
+	unsigned int delivered; /* held ones passed to send_notification */
+	unsigned int batches;   /* batch windows that expired */
+};
+
 Communicator* tcore_communicator_new(TcorePlugin *plugin, const char *name,
                   struct tcore_communitor_operations *ops);
 void          tcore_communicator_free();
@@ -53,6 +61,17 @@ TReturn       tcore_communicator_send_notification(Communicator *comm,
 
 TReturn       tcore_communicator_dispatch_request(Communicator *comm, UserRequest *ur);
 
+TReturn       tcore_communicator_set_notification_batch(Communicator *comm,
+                  unsigned int window_ms);
+TReturn       tcore_communicator_add_batch_notification(Communicator *comm,
+                  enum tcore_notification_command command);
+TReturn       tcore_communicator_remove_batch_notification(Communicator *comm,
+                  enum tcore_notification_command command);
+TReturn       tcore_communicator_flush_notification(Communicator *comm,
+                  CoreObject *source);
+TReturn       tcore_communicator_get_batch_stats(Communicator *comm,
+                  struct tcore_communicator_batch_stats *stats);
+
 __END_DECLS
 
 #endif
@@ -83,6 +83,7 @@ TReturn          tcore_object_dispatch_request(CoreObject *co, UserRequest *ur);
 TReturn          tcore_object_add_callback(CoreObject *co, const char *event, CoreObjectCallback callback, void *user_data);
 TReturn          tcore_object_del_callback(CoreObject *co, const char *event, CoreObjectCallback callback);
 TReturn          tcore_object_emit_callback(CoreObject *co, const char *event, const void *event_info);
+TReturn          tcore_object_emit_callback_quark(CoreObject *co, GQuark event_id, const void *event_info);
 
 __END_DECLS
 
@@ -26,6 +26,9 @@ __BEGIN_DECLS
 typedef void (*TcoreHalReceiveCallback)(TcoreHal *hal, unsigned int data_len, const void *data, void *user_data);
 typedef enum tcore_hook_return (*TcoreHalSendHook)(TcoreHal *hal, unsigned int data_len, void *data, void *user_data);
 
+struct iovec;
+typedef TReturn (*TcoreHalSendv)(TcoreHal *hal, const struct iovec *iov, int iovcnt);
+
 enum tcore_hal_recv_data_type {
 	TCORE_HAL_RECV_INDICATION,
 	TCORE_HAL_RECV_RESPONSE,
@@ -62,7 +65,15 @@ TReturn      tcore_hal_set_power(TcoreHal *hal, gboolean flag);
 TReturn      tcore_hal_link_user_data(TcoreHal *hal, void *user_data);
 void*        tcore_hal_ref_user_data(TcoreHal *hal);
 
+TReturn      tcore_hal_link_mux(TcoreHal *hal, TcoreMux *mux);
+TcoreMux*    tcore_hal_ref_mux(TcoreHal *hal);
+
+/* Optional scatter/gather send (e.g. writev), used by CMUX */
+TReturn      tcore_hal_set_sendv(TcoreHal *hal, TcoreHalSendv func);
+
 TReturn      tcore_hal_send_data(TcoreHal *hal, unsigned int data_len, void *data);
+TReturn      tcore_hal_send_datav(TcoreHal *hal, const struct iovec *iov,
+                 int iovcnt);
 TReturn      tcore_hal_send_request(TcoreHal *hal, TcorePending *pending);
 TReturn      tcore_hal_send_force(TcoreHal *hal);
 
@@ -79,6 +90,8 @@ TReturn      tcore_hal_emit_recv_callback(TcoreHal *hal,
 TReturn      tcore_hal_add_send_hook(TcoreHal *hal, TcoreHalSendHook func,
                  void *user_data);
 TReturn      tcore_hal_remove_send_hook(TcoreHal *hal, TcoreHalSendHook func);
+/* trace id of the queued request being sent, 0 outside of a queue send */
+guint64      tcore_hal_get_trace_id(TcoreHal *hal);
 
 TReturn      tcore_hal_set_power_state(TcoreHal *hal, gboolean flag);
 gboolean     tcore_hal_get_power_state(TcoreHal *hal);
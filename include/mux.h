@@ -21,8 +21,88 @@
 #ifndef __MUX_H__
 #define __MUX_H__
 
+__BEGIN_DECLS
+
+/* Maximum Core objects per Logical HAL (indirectly per Channel) */
+#define MAX_CMUX_CORE_OBJECTS		3
+
+/* Channel map entry: Logical HAL created for the Channel (DLCI = index in
+ * the map, index 0 is the Control Channel) and the Core Objects using it.
+ * Unused core_object_name entries are NULL.
+ */
+struct tcore_cmux_channel_object {
+	const char *channel_id_name;
+	const char *core_object_name[MAX_CMUX_CORE_OBJECTS];
+
+	/* Credits granted to the modem when credit based flow control is
+	 * accepted in parameter negotiation (at most 255), 0 disables it.
+	 */
+	unsigned int credits;
+
+	/* Transmit scheduling: share of the link (weight * N1 octets per
+	 * round, 0 is 1) among the other Channels, or strict priority over
+	 * all of them (call and emergency Channels).
+	 */
+	unsigned int weight;
+	gboolean priority;
+};
+
+/* Transmit flow control state and statistics of a Channel */
+struct tcore_cmux_channel_stats {
+	gboolean flow_controlled;
+	unsigned int flow_control_count;
+	unsigned long long flow_control_time;	/* usec, including the current stop */
+	unsigned int queued_bytes;
+
+	gboolean credit_flow_control;
+	unsigned int tx_credits;
+	unsigned int rx_credits;
+
+	unsigned long long tx_bytes;
+	unsigned int tx_frames;
+	unsigned int tx_writes;
+	unsigned long long latency_avg;	/* usec, write to last frame sent */
+	unsigned long long latency_max;
+};
+
+/* 27.010 mode of operation, the same <mode> as given to the modem with AT+CMUX */
+enum tcore_cmux_mode {
+	CMUX_MODE_BASIC = 0x00,
+	CMUX_MODE_ADVANCED = 0x01
+};
+
+/* Single-MUX entry points: basic mode, default N1 and the default 8
+ * Channel map on one Physical HAL at a time, for plugins written against
+ * the original API.
+ */
 TReturn tcore_cmux_init(TcorePlugin *plugin, TcoreHal *hal);
 void tcore_cmux_close(void);
 int tcore_cmux_rcv_from_hal(unsigned char *data, size_t length);
 
+/* The MUX object is owned by the Physical HAL 'hal', several Physical HALs
+ * (modems) may run their own CMUX session concurrently.
+ *
+ * 'frame_size' is the N1 (maximum Information field size) proposed to the
+ * modem for every DLC with parameter negotiation; larger writes are split
+ * into N1 sized frames. 0 keeps the default (4096) without negotiation.
+ *
+ * 'mode' must match the mode the modem was switched to (AT+CMUX=<mode>).
+ *
+ * 'channel_map' holds 'channel_count' entries (at most 64) and is copied;
+ * NULL uses the default 8 Channel map.
+ */
+TReturn tcore_cmux_init_hal(TcorePlugin *plugin, TcoreHal *hal, enum tcore_cmux_mode mode, unsigned int frame_size,
+            const struct tcore_cmux_channel_object *channel_map, unsigned int channel_count);
+void tcore_cmux_close_hal(TcoreHal *hal);
+int tcore_cmux_rcv_hal(TcoreHal *hal, unsigned char *data, size_t length);
+
+/* Frames stopped by MSC (FC/RTR), FCoff or lack of credits are queued per
+ * Channel and sent once the Channel is resumed. Backlogged Channels share
+ * the Physical HAL by weight (Deficit Round Robin), priority Channels and
+ * the Control Channel are always sent first.
+ */
+TReturn tcore_cmux_get_channel_stats(TcoreHal *hal, unsigned int channel_id, struct tcore_cmux_channel_stats *stats);
+
+__END_DECLS
+
 #endif  /* __MUX_H__ */
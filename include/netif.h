@@ -0,0 +1,66 @@
+/*
+ * libtcore
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Ja-young Gu <jygu@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TCORE_NETIF_H__
+#define __TCORE_NETIF_H__
+
+__BEGIN_DECLS
+
+/*
+ * PDP context interface configuration
+ *
+ * tcore_netif_configure() builds every rtnetlink message a context needs
+ * (link state and MTU, IPv4/IPv6 addresses, default routes) and sends them
+ * to the kernel with a single sendto() on a socket kept open for the life
+ * of the process. Acks are collected from the main loop and the callback
+ * runs once all of them arrived, so several contexts can be brought up
+ * without blocking. If rtnetlink is unavailable the request falls back
+ * to the tcore_util_netif_*() ioctl path (IPv4 only).
+ *
+ * Must be called from the server (default main context) thread, the
+ * callback is invoked there as well.
+ */
+struct tcore_netif_config {
+	const char *name;              /* interface, mandatory */
+	gboolean up;                   /* FALSE removes the addresses below and downs the link */
+	unsigned int mtu;              /* 0 leaves the MTU untouched */
+
+	const char *ipv4_addr;
+	const char *ipv4_netmask;      /* NULL means /32 */
+	const char *ipv4_gateway;
+
+	const char *ipv6_addr;
+	unsigned int ipv6_prefix_len;  /* 0 means /64 */
+	const char *ipv6_gateway;
+
+	gboolean default_route;        /* route 0.0.0.0/0 and ::/0 through this interface,
+	                                * with a higher metric than wlan/eth, so
+	                                * those stay preferred */
+};
+
+typedef void (*TcoreNetifCallback)(const char *name, TReturn result, void *user_data);
+
+TReturn tcore_netif_configure(const struct tcore_netif_config *config,
+            TcoreNetifCallback cb, void *user_data);
+void    tcore_netif_close(void);
+
+__END_DECLS
+
+#endif
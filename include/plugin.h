@@ -55,17 +55,68 @@ TReturn      tcore_plugin_link_user_data(TcorePlugin *plugin, void *user_data);
 void*        tcore_plugin_ref_user_data(TcorePlugin *plugin);
 
 TReturn      tcore_plugin_add_core_object(TcorePlugin *plugin, CoreObject *co);
+TReturn      tcore_plugin_remove_core_object(TcorePlugin *plugin,
+                 CoreObject *co);
+void         tcore_plugin_update_core_object(TcorePlugin *plugin,
+                 CoreObject *co);
 CoreObject*  tcore_plugin_ref_core_object(TcorePlugin *plugin, const char *name);
+GSList*      tcore_plugin_ref_core_objects_bytype(TcorePlugin *plugin,
+                 unsigned int type);
 GSList*      tcore_plugin_get_core_objects_bytype(TcorePlugin *plugin,
                  unsigned int type);
 
 TReturn      tcore_plugin_core_object_event_emit(TcorePlugin *plugin,
                  const char *event, const void *event_info);
+TReturn      tcore_plugin_core_object_event_emit_quark(TcorePlugin *plugin,
+                 GQuark event_id, const void *event_info);
+TReturn      tcore_plugin_add_event_subscriber(TcorePlugin *plugin,
+                 GQuark event_id, CoreObject *co);
+TReturn      tcore_plugin_remove_event_subscriber(TcorePlugin *plugin,
+                 GQuark event_id, CoreObject *co);
 
 TReturn      tcore_plugin_link_property(TcorePlugin *plugin, const char *key,
                  void *data);
 void*        tcore_plugin_ref_property(TcorePlugin *plugin, const char *key);
 
+/*
+ * Threading
+ *
+ * By default every plugin runs on the server main loop. A plugin may call
+ * tcore_plugin_start_worker() from its init() to get a thread with its
+ * own GMainContext instead:
+ *
+ * - HAL queueing, pending timeouts and CMUX scheduling of its HALs run on
+ *   that thread. I/O watches the plugin creates itself must be attached
+ *   to tcore_plugin_ref_main_context().
+ * - tcore_server_dispatch_request() hands requests over to the worker
+ *   with tcore_plugin_invoke(), and core objects of the plugin are only
+ *   touched from there.
+ * - Notifications and responses sent from the worker are delivered to
+ *   communicators on the server main loop.
+ * - Core objects, HALs and hooks must be added before the worker starts
+ *   or from the worker itself. Server tables (plugins, communicators,
+ *   hooks) are owned by the server thread.
+ *
+ * The source helpers below attach to the plugin context, or to the
+ * default context when no worker was ever started, so callers need not
+ * care which model is in use.
+ */
+TReturn      tcore_plugin_start_worker(TcorePlugin *plugin);
+void         tcore_plugin_stop_worker(TcorePlugin *plugin);
+GMainContext*
+             tcore_plugin_ref_main_context(TcorePlugin *plugin);
+gboolean     tcore_plugin_is_worker_thread(TcorePlugin *plugin);
+
+guint        tcore_plugin_add_idle(TcorePlugin *plugin, gint priority,
+                 GSourceFunc func, void *user_data);
+guint        tcore_plugin_add_timeout(TcorePlugin *plugin, guint interval,
+                 GSourceFunc func, void *user_data);
+guint        tcore_plugin_add_timeout_seconds(TcorePlugin *plugin,
+                 guint interval, GSourceFunc func, void *user_data);
+gboolean     tcore_plugin_remove_source(TcorePlugin *plugin, guint id);
+TReturn      tcore_plugin_invoke(TcorePlugin *plugin, GSourceFunc func,
+                 void *user_data, GDestroyNotify notify);
+
 __END_DECLS
 
 #endif
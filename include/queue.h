@@ -60,6 +60,7 @@ TReturn       tcore_pending_get_send_status(TcorePending *pending,
 TReturn       tcore_pending_link_user_request(TcorePending *pending,
                   UserRequest *ur);
 UserRequest*  tcore_pending_ref_user_request(TcorePending *pending);
+guint64       tcore_pending_get_trace_id(TcorePending *pending);
 
 TReturn       tcore_pending_set_send_callback(TcorePending *pending,
                   TcorePendingSendCallback func, void *user_data);
@@ -40,6 +40,7 @@ GSList*       tcore_server_ref_plugins(Server *s);
 TcorePlugin*  tcore_server_find_plugin(Server *s, const char *name);
 
 TReturn       tcore_server_add_communicator(Server *s, Communicator *comm);
+TReturn       tcore_server_remove_communicator(Server *s, Communicator *comm);
 GSList*       tcore_server_ref_communicators(Server *s);
 Communicator* tcore_server_find_communicator(Server *s, const char *name);
 
@@ -54,6 +55,16 @@ TcoreHal*     tcore_server_find_hal(Server *s, const char *name);
 TReturn       tcore_server_link_udev(Server *s, TcoreUdev *udev);
 TcoreUdev*    tcore_server_ref_udev(Server *s);
 
+/*
+ * Everything else in this file must be called from the server main loop.
+ * dispatch_request hands requests for worker plugins over to the worker
+ * and returns success at once. send_notification may be called from any
+ * thread; data is copied and delivered on the server main loop.
+ */
+gboolean      tcore_server_is_main_thread(Server *s);
+TReturn       tcore_server_invoke(Server *s, GSourceFunc func, void *user_data,
+                  GDestroyNotify notify);
+
 TReturn       tcore_server_dispatch_request(Server *s, UserRequest *ur);
 TReturn       tcore_server_send_notification(Server *s, CoreObject *source,
                   enum tcore_notification_command command,
@@ -105,11 +105,65 @@ enum storage_value {
 	STORAGE_VALUE_STATE_9 = 9,
 };
 
+/*
+ * One typed key/value of a batch, the member of value used follows the
+ * key class (STORAGE_KEY_INT, STORAGE_KEY_BOOL or STORAGE_KEY_STRING).
+ */
+struct tcore_storage_value {
+	enum tcore_storage_key key;
+	union {
+		int i;
+		gboolean b;
+		const char *s;
+	} value;
+};
+
+enum tcore_storage_step {
+	TCORE_STORAGE_STEP_ERROR = -1,
+	TCORE_STORAGE_STEP_DONE = 0,  /* statement ran to completion */
+	TCORE_STORAGE_STEP_ROW,       /* a result row is available */
+};
+
+/*
+ * value is the new value of the key as a GVariant: int32, boolean or
+ * string following the key class. It may be NULL when the backend does
+ * not report it.
+ */
 typedef void (*TcoreStorageKeyCallback) (enum tcore_storage_key key,
     void *value, void *user_data);
 typedef void (*TcoreStorageDispatchCallback) (Storage *strg,
     enum tcore_storage_key key, void *value);
 
+/*
+ * Applies all values in one backend transaction and notifies each changed
+ * key once, after the whole batch is stored.
+ */
+typedef gboolean (*TcoreStorageBatchWriter) (Storage *strg,
+    const struct tcore_storage_value *values, unsigned int count);
+
+/*
+ * Write policy of a cached key. Only keys given a policy with
+ * tcore_storage_set_write_policy() are cached, so it is meant for keys
+ * this daemon owns (RSSI, cell info, packet counters...). Gets of a cached
+ * key are served from memory and sets of an unchanged value never reach
+ * the backend. Deferred writes run on the context of the plugin owning
+ * the Storage, sets may come from any plugin thread.
+ */
+enum tcore_storage_write_policy {
+	TCORE_STORAGE_WRITE_IMMEDIATE, /* changed values are written at once */
+	TCORE_STORAGE_WRITE_DEBOUNCE,  /* written once no change came for interval_ms */
+	TCORE_STORAGE_WRITE_PERIODIC,  /* latest value written at most every interval_ms */
+};
+
+struct tcore_storage_cache_stats {
+	unsigned int hits;      /* gets served from memory */
+	unsigned int misses;    /* gets that had to read the backend */
+	unsigned int writes;    /* sets passed to the backend */
+	unsigned int unchanged; /* sets dropped, value already stored */
+	unsigned int coalesced; /* superseded by a later set before written */
+	unsigned int failed;    /* backend writes that failed */
+};
+
 struct storage_operations {
 	void* (*create_handle)(Storage *strg, const char *path);
 	gboolean (*remove_handle)(Storage *strg, void *handle);
@@ -135,11 +189,39 @@ struct storage_operations {
 			const char *query, GHashTable *in_param);
 };
 
+/*
+ * Optional prepared statements and transactions on database handles.
+ * stmt is the backend's own statement object, reset_query must also
+ * clear the bindings. Indexes start at 1 for bind and at 0 for column,
+ * as in sqlite, bind_string binds NULL for a NULL value.
+ */
+struct storage_statement_operations {
+	void* (*prepare_query)(Storage *strg, void *handle, const char *query);
+	gboolean (*finalize_query)(Storage *strg, void *stmt);
+	gboolean (*reset_query)(Storage *strg, void *stmt);
+	gboolean (*bind_int)(Storage *strg, void *stmt, int index, int value);
+	gboolean (*bind_string)(Storage *strg, void *stmt, int index,
+			const char *value);
+	enum tcore_storage_step (*step_query)(Storage *strg, void *stmt);
+	int (*column_int)(Storage *strg, void *stmt, int column);
+	const char* (*column_string)(Storage *strg, void *stmt, int column);
+
+	gboolean (*begin_transaction)(Storage *strg, void *handle);
+	gboolean (*end_transaction)(Storage *strg, void *handle, gboolean commit);
+};
+
 Storage*     tcore_storage_new(TcorePlugin *plugin, const char *name,
                  struct storage_operations *ops);
 void         tcore_storage_free(Storage *strg);
 const char*  tcore_storage_ref_name(Storage *strg);
 
+/* Optional, without it tcore_storage_set_batch() sets values one by one */
+TReturn      tcore_storage_set_batch_writer(Storage *strg,
+                 TcoreStorageBatchWriter func);
+/* Optional, set before the first statement is prepared */
+TReturn      tcore_storage_set_statement_operations(Storage *strg,
+                 struct storage_statement_operations *ops);
+
 void*        tcore_storage_create_handle(Storage *strg, const char *path);
 gboolean     tcore_storage_remove_handle(Storage *strg, void *handle);
 
@@ -156,12 +238,24 @@ gboolean     tcore_storage_set_bool(Storage *strg, enum tcore_storage_key key,
                  gboolean value);
 gboolean     tcore_storage_get_bool(Storage *strg, enum tcore_storage_key key);
 
+gboolean     tcore_storage_set_batch(Storage *strg,
+                 const struct tcore_storage_value *values, unsigned int count);
+
 gboolean     tcore_storage_set_key_callback(Storage *strg,
                  enum tcore_storage_key key, TcoreStorageKeyCallback cb,
                  void *user_data);
 gboolean     tcore_storage_remove_key_callback(Storage *strg,
                  enum tcore_storage_key key, TcoreStorageKeyCallback cb);
 
+TReturn      tcore_storage_set_write_policy(Storage *strg,
+                 enum tcore_storage_key key,
+                 enum tcore_storage_write_policy policy, unsigned int interval_ms);
+TReturn      tcore_storage_remove_write_policy(Storage *strg,
+                 enum tcore_storage_key key);
+TReturn      tcore_storage_flush(Storage *strg);
+TReturn      tcore_storage_get_cache_stats(Storage *strg,
+                 struct tcore_storage_cache_stats *stats);
+
 //storage database
 gboolean     tcore_storage_update_query_database(Storage *strg, void *handle,
                  const char *query, GHashTable *in_param);
@@ -172,6 +266,39 @@ gboolean     tcore_storage_insert_query_database(Storage *strg, void *handle,
                  const char *query, GHashTable *in_param);
 gboolean     tcore_storage_remove_query_database(Storage *strg, void *handle,
                  const char *query, GHashTable *in_param);
+/*
+ * in_params is a list of in_param tables as the other query calls take
+ * them: bind index as a decimal string -> text value, an empty value
+ * binds NULL.
+ */
+gboolean     tcore_storage_insert_bulk_query_database(Storage *strg,
+                 void *handle, const char *query, GSList *in_params);
+
+/*
+ * Prepared statements are cached per handle and query text, so preparing
+ * the same query again hands back the already compiled statement.
+ * Release a statement when done with it, it stays cached until the
+ * handle is removed. A handle is not removed while one of its
+ * statements is in use.
+ */
+TcoreStorageStatement*
+             tcore_storage_prepare_query(Storage *strg, void *handle,
+                 const char *query);
+void         tcore_storage_release_query(TcoreStorageStatement *stmt);
+gboolean     tcore_storage_reset_query(TcoreStorageStatement *stmt);
+gboolean     tcore_storage_bind_int(TcoreStorageStatement *stmt, int index,
+                 int value);
+gboolean     tcore_storage_bind_string(TcoreStorageStatement *stmt, int index,
+                 const char *value);
+enum tcore_storage_step
+             tcore_storage_step_query(TcoreStorageStatement *stmt);
+int          tcore_storage_column_int(TcoreStorageStatement *stmt, int column);
+const char*  tcore_storage_ref_column_string(TcoreStorageStatement *stmt,
+                 int column);
+
+gboolean     tcore_storage_begin_transaction(Storage *strg, void *handle);
+gboolean     tcore_storage_end_transaction(Storage *strg, void *handle,
+                 gboolean commit);
 
 __END_DECLS
 
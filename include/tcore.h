@@ -54,6 +54,9 @@ typedef struct tcore_server_type Server;
 typedef struct tcore_storage_type Storage;
 typedef struct tcore_at_type TcoreAT;
 typedef struct tcore_udev_type TcoreUdev;
+typedef struct tcore_cmux_type TcoreMux;
+typedef struct tcore_marshal_record_type TcoreMarshalRecord;
+typedef struct tcore_storage_statement_type TcoreStorageStatement;
 
 enum tcore_hook_return {
 	TCORE_HOOK_RETURN_STOP_PROPAGATION = FALSE,
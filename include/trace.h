@@ -0,0 +1,58 @@
+/*
+ * libtcore
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Ja-young Gu <jygu@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TCORE_TRACE_H__
+#define __TCORE_TRACE_H__
+
+__BEGIN_DECLS
+
+/*
+ * Request lifecycle tracing
+ *
+ * Every UserRequest gets a trace id when it is created. TcorePending
+ * inherits it in tcore_pending_link_user_request(), and HAL send hooks
+ * can read it with tcore_hal_get_trace_id(). While tracing is enabled each
+ * step is recorded in a ring buffer of the calling thread. Recording
+ * takes no locks. tcore_trace_export() writes all rings as a Chrome trace
+ * (also readable by Perfetto).
+ */
+enum tcore_trace_event {
+	TCORE_TRACE_DISPATCH,      /* arg: request command */
+	TCORE_TRACE_ENQUEUE,       /* arg: queue length */
+	TCORE_TRACE_SEND,          /* arg: bytes sent */
+	TCORE_TRACE_FIRST_BYTE,    /* arg: bytes in the first chunk */
+	TCORE_TRACE_RESPONSE,      /* arg: response length */
+	TCORE_TRACE_USER_RESPONSE, /* arg: response command */
+	TCORE_TRACE_EVENT_MAX
+};
+
+guint64  tcore_trace_new_id(void);
+
+void     tcore_trace_set_enabled(gboolean enable);
+gboolean tcore_trace_is_enabled(void);
+
+void     tcore_trace_record(guint64 trace_id, enum tcore_trace_event event,
+             unsigned int arg);
+
+TReturn  tcore_trace_export(const char *path);
+
+__END_DECLS
+
+#endif
@@ -53,6 +53,8 @@ TReturn       tcore_user_request_set_response_hook(UserRequest *ur,
 
 Communicator* tcore_user_request_ref_communicator(UserRequest *ur);
 char*         tcore_user_request_get_modem_name(UserRequest *ur);
+const char*   tcore_user_request_ref_modem_name(UserRequest *ur);
+guint64       tcore_user_request_get_trace_id(UserRequest *ur);
 
 TReturn       tcore_user_request_set_user_info(UserRequest *ur,
                   const struct tcore_user_info *ui);
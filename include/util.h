@@ -36,6 +36,32 @@ enum tcore_util_marshal_data_type {
 	TCORE_UTIL_MARSHAL_DATA_STRING_MAX = 0xFF,
 };
 
+#define TCORE_UTIL_MARSHAL_BINARY_VERSION 1
+
+/*
+ * Schema-typed marshal records.
+ *
+ * A schema is a static table of { key, type } pairs indexed by a
+ * compile-time field id. Values live in a flat slot array, so typed
+ * getters and setters are O(1) and do not allocate (strings are
+ * copied on set). tcore_util_marshal_record_to_hash() and
+ * tcore_util_marshal_record_new_from_hash() convert to and from the
+ * GHashTable form at the IPC edges.
+ */
+struct tcore_util_marshal_field {
+	const char *key;
+	enum tcore_util_marshal_data_type type;
+};
+
+struct tcore_util_marshal_schema {
+	const char *name;
+	const struct tcore_util_marshal_field *fields;
+	unsigned int field_count;
+};
+
+#define TCORE_UTIL_MARSHAL_SCHEMA(name, fields) \
+	{ (name), (fields), G_N_ELEMENTS(fields) }
+
 
 union tcore_ip4_type {
 	uint32_t i;
@@ -63,6 +89,9 @@ void        tcore_util_marshal_destory(GHashTable *ht);
 GHashTable* tcore_util_marshal_deserialize_string(const gchar *serialized_string);
 gchar*      tcore_util_marshal_serialize(GHashTable *ht);
 
+GHashTable* tcore_util_marshal_deserialize_binary(const guint8 *data, gsize len);
+gboolean    tcore_util_marshal_serialize_binary(GHashTable *ht, GByteArray *buf);
+
 gboolean    tcore_util_marshal_add_data(GHashTable *ht, const gchar *key,
                 const void *data, enum tcore_util_marshal_data_type type);
 gboolean    tcore_util_marshal_get_data(GHashTable *ht, const gchar *key,
@@ -72,14 +101,65 @@ gint        tcore_util_marshal_get_int(GHashTable *ht, const gchar *key);
 gchar*      tcore_util_marshal_get_string(GHashTable *ht, const gchar *key);
 GHashTable* tcore_util_marshal_get_object(GHashTable *ht, const gchar *key);
 
+TcoreMarshalRecord*
+            tcore_util_marshal_record_new(const struct tcore_util_marshal_schema *schema);
+void        tcore_util_marshal_record_free(TcoreMarshalRecord *rec);
+const struct tcore_util_marshal_schema*
+            tcore_util_marshal_record_ref_schema(TcoreMarshalRecord *rec);
+
+gboolean    tcore_util_marshal_record_has_field(TcoreMarshalRecord *rec, unsigned int id);
+void        tcore_util_marshal_record_unset(TcoreMarshalRecord *rec, unsigned int id);
+
+gboolean    tcore_util_marshal_record_set_char(TcoreMarshalRecord *rec, unsigned int id, gchar value);
+gboolean    tcore_util_marshal_record_set_boolean(TcoreMarshalRecord *rec, unsigned int id, gboolean value);
+gboolean    tcore_util_marshal_record_set_int(TcoreMarshalRecord *rec, unsigned int id, gint value);
+gboolean    tcore_util_marshal_record_set_double(TcoreMarshalRecord *rec, unsigned int id, gdouble value);
+gboolean    tcore_util_marshal_record_set_string(TcoreMarshalRecord *rec, unsigned int id, const gchar *value);
+gboolean    tcore_util_marshal_record_set_object(TcoreMarshalRecord *rec, unsigned int id, GHashTable *value);
+
+gchar       tcore_util_marshal_record_get_char(TcoreMarshalRecord *rec, unsigned int id);
+gboolean    tcore_util_marshal_record_get_boolean(TcoreMarshalRecord *rec, unsigned int id);
+gint        tcore_util_marshal_record_get_int(TcoreMarshalRecord *rec, unsigned int id);
+gdouble     tcore_util_marshal_record_get_double(TcoreMarshalRecord *rec, unsigned int id);
+const gchar*
+            tcore_util_marshal_record_ref_string(TcoreMarshalRecord *rec, unsigned int id);
+GHashTable* tcore_util_marshal_record_ref_object(TcoreMarshalRecord *rec, unsigned int id);
+
+GHashTable* tcore_util_marshal_record_to_hash(TcoreMarshalRecord *rec);
+TcoreMarshalRecord*
+            tcore_util_marshal_record_new_from_hash(const struct tcore_util_marshal_schema *schema,
+                GHashTable *ht);
+
 enum tcore_dcs_type
             tcore_util_get_cbs_coding_scheme(unsigned char encode);
 
 unsigned char* tcore_util_decode_hex(const char *src, int len);
+TReturn     tcore_util_hex_encode(const unsigned char *src, unsigned int src_len,
+                char *dest, unsigned int dest_size);
+TReturn     tcore_util_hex_decode(const char *src, unsigned int src_len,
+                unsigned char *dest, unsigned int dest_size, unsigned int *decoded_len);
 
 unsigned char* tcore_util_unpack_gsm7bit(const unsigned char *src, unsigned int src_len);
 unsigned char* tcore_util_pack_gsm7bit(const unsigned char *src, unsigned int src_len);
+TReturn     tcore_util_gsm7bit_pack(const unsigned char *septets, unsigned int septet_count,
+                unsigned int fill_bits, unsigned char *dest, unsigned int dest_size,
+                unsigned int *packed_len);
+TReturn     tcore_util_gsm7bit_unpack(const unsigned char *src, unsigned int src_len,
+                unsigned int fill_bits, unsigned char *dest, unsigned int dest_size,
+                unsigned int *septet_count);
+TReturn     tcore_util_gsm7bit_to_utf8(const unsigned char *septets, unsigned int septet_count,
+                char *dest, unsigned int dest_size, unsigned int *utf8_len);
+TReturn     tcore_util_utf8_to_gsm7bit(const char *src, unsigned int src_len,
+                unsigned char *dest, unsigned int dest_size, unsigned int *septet_count);
 char*       tcore_util_convert_bcd2ascii(const char *src, int src_len, int max_len);
+TReturn     tcore_util_bcd_decode(const unsigned char *src, unsigned int src_len,
+                char *dest, unsigned int dest_size, unsigned int *digit_len);
+TReturn     tcore_util_bcd_encode(const char *digits, unsigned int digit_len,
+                unsigned char *dest, unsigned int dest_size, unsigned int *bcd_len);
+unsigned char
+            tcore_util_encode_ton_npi(unsigned int ton, unsigned int npi);
+void        tcore_util_decode_ton_npi(unsigned char ton_npi, unsigned int *ton,
+                unsigned int *npi);
 
 __END_DECLS
 
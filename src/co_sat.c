@@ -350,18 +350,17 @@ static void _sat_decode_dcs(unsigned char dcs, struct data_coding_scheme* dsc_ob
 
 static void _sat_decode_ton_npi(unsigned char ton_npi, enum type_of_number *ton, enum numbering_plan_identifier *npi)
 {
-	int ton_value = 0;
-	int npi_value = 0;
+	unsigned int ton_value = 0;
+	unsigned int npi_value = 0;
 
 	if(!ton || !npi)
 		return;
 
-	ton_value = (ton_npi & 0x70) >> 4;
+	tcore_util_decode_ton_npi(ton_npi, &ton_value, &npi_value);
 	*ton = ton_value;
 	if(*ton > TON_NETWORK_SPECIFIC)
 		*ton = TON_UNKNOWN;
 
-	npi_value = (ton_npi & 0x0F);
 	switch(npi_value){
 		case NPI_ISDN_TEL:
 		case NPI_DATA_NUMBERING_PLAN:
@@ -467,13 +466,16 @@ static enum tcore_sat_result _sat_decode_address_tlv(unsigned char* tlv_str, int
 
 	address_obj->dialing_number_len = 0;
 	if(address_len > 1){
-		char* str_ascii = NULL;
+		char digits[SAT_DIALING_NUMBER_LEN_MAX + 1];
+		unsigned int digit_len = 0;
+
 		_sat_decode_ton_npi(src_data[index++], &address_obj->ton, &address_obj->npi);
-		str_ascii = tcore_util_convert_bcd2ascii((const char*)&src_data[index], address_len-1, SAT_DIALING_NUMBER_LEN_MAX);
-		if(str_ascii){
-			memcpy(address_obj->dialing_number, str_ascii, strlen(str_ascii));
-			address_obj->dialing_number_len = strlen(str_ascii);
-			g_free(str_ascii);
+		if(tcore_util_bcd_decode(&src_data[index], address_len-1, digits, sizeof(digits), &digit_len) == TCORE_RETURN_SUCCESS){
+			memcpy(address_obj->dialing_number, digits, digit_len);
+			address_obj->dialing_number_len = digit_len;
+		}
+		else{
+			err("[SAT] PARSER - number length exceeds the max");
 		}
 	}
 
@@ -1066,7 +1068,8 @@ static enum tcore_sat_result _sat_decode_item_identifier_tlv(unsigned char* tlv_
 static enum tcore_sat_result _sat_decode_ss_string_tlv(unsigned char* tlv_str, int tlv_len,
 		int curr_offset, struct tel_sat_ss_string *ss_str_obj, int* consumed_data_len)
 {
-	char* str_ascii = NULL;
+	char digits[SAT_SS_STRING_LEN_MAX + 1];
+	unsigned int digit_len = 0;
 	int index, len_of_len=0;
 	int ss_len =0;
 	unsigned char* src_data;
@@ -1110,11 +1113,12 @@ static enum tcore_sat_result _sat_decode_ss_string_tlv(unsigned char* tlv_str, i
 		return TCORE_SAT_REQUIRED_VALUE_MISSING;
 
 	_sat_decode_ton_npi(src_data[index++], &ss_str_obj->ton, &ss_str_obj->npi);
-	str_ascii = tcore_util_convert_bcd2ascii((const char*)&src_data[index], ss_len-1, SAT_SS_STRING_LEN_MAX);
-	if(str_ascii){
-		memcpy(ss_str_obj->ss_string, str_ascii, sizeof(str_ascii));
-		ss_str_obj->string_len = sizeof(str_ascii);
-		g_free(str_ascii);
+	if(tcore_util_bcd_decode(&src_data[index], ss_len-1, digits, sizeof(digits), &digit_len) == TCORE_RETURN_SUCCESS){
+		memcpy(ss_str_obj->ss_string, digits, digit_len);
+		ss_str_obj->string_len = digit_len;
+	}
+	else{
+		err("[SAT] PARSER - ss string length exceeds the max");
 	}
 
 	 // 1 is the length of Tag.
@@ -1716,7 +1720,8 @@ static enum tcore_sat_result _sat_decode_dtmf_string_tlv(unsigned char* tlv_str,
 	int index, len_of_len = 0;
 	int dtmf_len = 0;
 	gboolean comprehension_req = FALSE;
-	char* str_ascii = NULL;
+	char digits[SAT_DTMF_STRING_LEN_MAX + 1];
+	unsigned int digit_len = 0;
 
 	if (tlv_str == NULL || consumed_data_len == NULL || dtmf_string_obj == NULL) {
 		dbg("[SAT] SAT PARSER -  tlv_str == NULL || consumed_data_len == NULL || dtmf_string_obj == NULL");
@@ -1759,11 +1764,9 @@ static enum tcore_sat_result _sat_decode_dtmf_string_tlv(unsigned char* tlv_str,
 	dtmf_string_obj->dtmf_length = 0;
 
 	if(dtmf_len > 0){
-		str_ascii = tcore_util_convert_bcd2ascii((const char*)&src_data[index], dtmf_len, SAT_DTMF_STRING_LEN_MAX);
-		if(str_ascii){
-			memcpy(dtmf_string_obj->dtmf_string, str_ascii, sizeof(str_ascii));
-			dtmf_string_obj->dtmf_length = sizeof(str_ascii);
-			g_free(str_ascii);
+		if(tcore_util_bcd_decode(&src_data[index], dtmf_len, digits, sizeof(digits), &digit_len) == TCORE_RETURN_SUCCESS){
+			memcpy(dtmf_string_obj->dtmf_string, digits, digit_len);
+			dtmf_string_obj->dtmf_length = digit_len;
 		}
 	}
 
@@ -29,6 +29,7 @@
 #include "queue.h"
 #include "user_request.h"
 #include "core_object.h"
+#include "util.h"
 #include "co_sim.h"
 
 struct private_object_data {
@@ -238,56 +239,6 @@ static char* _acitoa(int n, char* str, int b)
  1032547698		0123456789
 
  ********************************************************************************/
-/**
- * This function is used to Convert Digit to BCD (Digit to BCD)
- *
- * @return		None
- * @param[out]	bcdCode - BCD output
- * @param[in]		digits - Digit input
- * @param[in]		digitLen - digit length
- * @Interface		Synchronous.
- * @remark
- * @Refer
- */
-static void _digit_to_bcd(char* bcdCode, char* digits, int digitLen)
-{
-	int i, j, digit;
-	unsigned char higher, lower;
-
-	// 0123456789 -> 1032547698
-	for (i = 0, j = 0; i < digitLen; i = i + 2, j++) {
-		if (digits[i] == '*')
-			digit = 0x0A;
-		else if (digits[i] == '#')
-			digit = 0x0B;
-		else if (toupper((int) digits[i]) == 'P')
-			digit = 0x0C;
-		else if ((digits[i]) == '?')
-			digit = 0x0D;
-		else
-			digit = (int) digits[i];
-
-		lower = digit & 0x0F;
-
-		if (digitLen != i + 1) {
-			if (digits[i + 1] == '*')
-				digit = 0x0A;
-			else if (digits[i + 1] == '#')
-				digit = 0x0B;
-			else if (toupper((int) digits[i + 1]) == 'P')
-				digit = 0x0C;
-			else if (digits[i + 1] == '?')
-				digit = 0x0D;
-			else
-				digit = (int) digits[i + 1];
-			higher = digit & 0x0F;
-		} else {
-			higher = 0xFF;
-		}
-		bcdCode[j] = (higher << 4) | lower;
-	}
-}
-
 /**
  * This function is used to Convert BCD to Digit (BCD to Digit)
  *
@@ -516,7 +467,7 @@ static int _ucs2_to_utf8(int in_length, unsigned char *in_data, int *out_length,
 gboolean tcore_sim_decode_iccid(struct tel_sim_iccid *p_out, unsigned char *p_in, int in_length)
 {
 	int bcd_byte = 0;
-	int char_length = 0;
+	unsigned int char_length = 0;
 
 	if (p_in == NULL || p_out == NULL)
 		return FALSE;
@@ -529,11 +480,9 @@ gboolean tcore_sim_decode_iccid(struct tel_sim_iccid *p_out, unsigned char *p_in
 	bcd_byte = _get_valid_bcd_byte(p_in, in_length);
 	dbg( "ICCID valid bcd byte is[%d]", bcd_byte);
 
-	char_length = _bcd_to_digit(p_out->iccid, (char*) p_in, bcd_byte);
+	tcore_util_bcd_decode(p_in, bcd_byte, p_out->iccid, sizeof(p_out->iccid), &char_length);
 	dbg( "ICCID string length is[%d]", char_length);
 
-	*(p_out->iccid+char_length) = '\0';
-
 	return TRUE;
 }
 
@@ -921,6 +870,7 @@ gboolean tcore_sim_decode_msisdn(struct tel_sim_msisdn *p_msisdn, unsigned char
 	int X;	// alpha id max length
 	int value_length;
 	int bcd_byte;	// dialing number max length
+	unsigned int ton;
 
 	memset((void*) p_msisdn, 0, sizeof(struct tel_sim_msisdn));
 
@@ -946,15 +896,15 @@ gboolean tcore_sim_decode_msisdn(struct tel_sim_msisdn *p_msisdn, unsigned char
 		dbg( "Dialing number Length %d, BCD length 0x%x ",  (p_in[X] - 1) * 2, p_in[X]);
 
 		// get TON and NPI
-		p_msisdn->ton = (p_in[X + 1] >> 4) & 0x07;
+		tcore_util_decode_ton_npi(p_in[X + 1], &ton, NULL);
+		p_msisdn->ton = ton;
 
 		// get actual dialing number length
 		bcd_byte = _get_valid_bcd_byte(&p_in[X + 2], SIM_XDN_NUMBER_LEN_MAX / 2);
 		dbg( "bcd_byte[%x]", bcd_byte);
 
 		// get dialing number/SSC string
-		value_length = _bcd_to_digit((char*) p_msisdn->num, (char*) &p_in[X + 2], bcd_byte); // actual dialing number length in BCD.
-		p_msisdn->num[value_length] = '\0';
+		tcore_util_bcd_decode(&p_in[X + 2], bcd_byte, (char*) p_msisdn->num, sizeof(p_msisdn->num), NULL);
 		dbg( "p_msisdn->num[%s]", p_msisdn->num);
 	}
 	return TRUE;
@@ -964,6 +914,8 @@ gboolean tcore_sim_decode_xdn(struct tel_sim_dialing_number *p_xdn, unsigned cha
 {
 	int X;	// alpha id max length
 	int bcd_byte;	// dialing number max length
+	unsigned int ton, npi;
+	unsigned int digit_len = 0;
 
 	memset((void*) p_xdn, 0, sizeof(struct tel_sim_dialing_number));
 
@@ -1013,15 +965,17 @@ gboolean tcore_sim_decode_xdn(struct tel_sim_dialing_number *p_xdn, unsigned cha
 		}
 
 		// get TON and NPI
-		p_xdn->TypeOfNumber = (p_in[X + 1] >> 4) & 0x07;
-		p_xdn->NumberingPlanIdent = p_in[X + 1] & 0x0F;
+		tcore_util_decode_ton_npi(p_in[X + 1], &ton, &npi);
+		p_xdn->TypeOfNumber = ton;
+		p_xdn->NumberingPlanIdent = npi;
 
 		// get actual dialing number length
 		bcd_byte = _get_valid_bcd_byte(&p_in[X + 2], SIM_XDN_NUMBER_LEN_MAX / 2);
 		dbg( "bcd_byte[%x]", bcd_byte);
 
 		// get dialing number/SSC string
-		p_xdn->DiallingnumLength = _bcd_to_digit((char*) p_xdn->DiallingNum, (char*) &p_in[X + 2], bcd_byte); // actual dialing number length in BCD.
+		tcore_util_bcd_decode(&p_in[X + 2], bcd_byte, p_xdn->DiallingNum, sizeof(p_xdn->DiallingNum), &digit_len);
+		p_xdn->DiallingnumLength = digit_len;
 		dbg( "p_xdn->DiallingnumLength[%x]", p_xdn->DiallingnumLength);
 		dbg( "p_xdn->DiallingNum[%s]", p_xdn->DiallingNum);
 		// get Capability/Configuration id
@@ -1035,7 +989,6 @@ gboolean tcore_sim_decode_xdn(struct tel_sim_dialing_number *p_xdn, unsigned cha
 gboolean tcore_sim_encode_xdn(char *p_out, int out_length, struct tel_sim_dialing_number *p_xdn)
 {
 	int X;
-	char bcdCode[SIM_XDN_NUMBER_LEN_MAX / 2];
 
 	memset((void*) p_out, 0xFF, out_length);
 
@@ -1055,16 +1008,12 @@ gboolean tcore_sim_encode_xdn(char *p_out, int out_length, struct tel_sim_dialin
 	p_out[X] = ((p_xdn->DiallingnumLength + 1) / 2) + 1;
 
 	// set TON and NPI
-	p_out[X + 1] = 0x80;
-	p_out[X + 1] |= (p_xdn->TypeOfNumber & 0x07) << 4;
-	p_out[X + 1] |= p_xdn->NumberingPlanIdent & 0x0F;
-
-	// set dialing number/SSC string
-	memset((void*) bcdCode, 0xFF, SIM_XDN_NUMBER_LEN_MAX / 2);
+	p_out[X + 1] = tcore_util_encode_ton_npi(p_xdn->TypeOfNumber, p_xdn->NumberingPlanIdent);
 
-	_digit_to_bcd((char*) bcdCode, (char*) p_xdn->DiallingNum, p_xdn->DiallingnumLength);
-
-	memcpy((void*) &p_out[X + 2], bcdCode, SIM_XDN_NUMBER_LEN_MAX / 2);
+	// set dialing number/SSC string, unused octets stay 0xFF
+	if (tcore_util_bcd_encode(p_xdn->DiallingNum, p_xdn->DiallingnumLength,
+			(unsigned char *) &p_out[X + 2], SIM_XDN_NUMBER_LEN_MAX / 2, NULL) != TCORE_RETURN_SUCCESS)
+		return FALSE;
 
 	// set Capability/Configuration Identifier
 	p_out[X + 12] = (unsigned char) p_xdn->CapaConfigId;
@@ -1078,7 +1027,6 @@ gboolean tcore_sim_decode_ecc(struct tel_sim_ecc_list *p_ecc, unsigned char *p_i
 {
 	int bcd_byte;	// dialing number max length
 	int i;
-	int valid_ecc_length;
 	memset((void*)p_ecc, 0x00, sizeof(struct tel_sim_ecc_list));
 
 	if(in_length%3 != 0) {
@@ -1090,8 +1038,8 @@ gboolean tcore_sim_decode_ecc(struct tel_sim_ecc_list *p_ecc, unsigned char *p_i
 		//get the BCD length of the ECC
 		bcd_byte = _get_valid_bcd_byte((unsigned char*) p_in+(i*3), 3);
 		if(bcd_byte != 0) {
-			valid_ecc_length = _bcd_to_digit(p_ecc->ecc[p_ecc->ecc_count].ecc_num, (char *)p_in+(i*3), bcd_byte);
-			p_ecc->ecc[p_ecc->ecc_count].ecc_num[valid_ecc_length] = '\0';
+			tcore_util_bcd_decode(p_in + (i * 3), bcd_byte, p_ecc->ecc[p_ecc->ecc_count].ecc_num,
+					sizeof(p_ecc->ecc[p_ecc->ecc_count].ecc_num), NULL);
 			p_ecc->ecc_count++;
 		}
 	}
@@ -1153,7 +1101,7 @@ gboolean tcore_sim_decode_uecc(struct tel_sim_ecc *p_ecc, unsigned char* p_in, i
 	bcd_byte = _get_valid_bcd_byte(&p_in[0], SIM_ECC_BYTE_LEN_MAX);
 
 	//get the ECC codes in digits and the length as well
-	_bcd_to_digit((char*) p_ecc->ecc_num, (char*) &p_in[0], bcd_byte);
+	tcore_util_bcd_decode(&p_in[0], bcd_byte, p_ecc->ecc_num, sizeof(p_ecc->ecc_num), NULL);
 
 	//get the alpha identifier of ECC (
 	_get_string((unsigned char*) p_ecc->ecc_string, (unsigned char*) &p_in[3], in_length - 3);
@@ -1870,6 +1818,8 @@ gboolean tcore_sim_decode_cfis(struct tel_sim_callforwarding *cfis, unsigned cha
 {
 	int bcd_byte;	// dialing number max length
 	int i = 0;
+	unsigned int ton, npi;
+	unsigned int digit_len = 0;
 	struct tel_sim_cfis p_cfis = {0,};
 
 	if (in_length == 0)
@@ -1884,15 +1834,18 @@ gboolean tcore_sim_decode_cfis(struct tel_sim_callforwarding *cfis, unsigned cha
 	p_cfis.Status = p_in[i++];
 
 	// get TON and NPI
-	p_cfis.TypeOfNumber = (p_in[++i] >> 4) & 0x07;
-	p_cfis.NumberingPlanIdent = p_in[i++] & 0x0F;
+	i++;	// skip length of BCD number
+	tcore_util_decode_ton_npi(p_in[i++], &ton, &npi);
+	p_cfis.TypeOfNumber = ton;
+	p_cfis.NumberingPlanIdent = npi;
 
 	// get actual dialing number length
 	/* current telephony supports 20 byte dialing number format. */
 	bcd_byte = _get_valid_bcd_byte(&p_in[i], SIM_XDN_NUMBER_LEN_MAX / 2);
 
 	// get dialing number/SSC string
-	p_cfis.DiallingnumLen = _bcd_to_digit((char*) p_cfis.DiallingNum, (char*) &p_in[i], bcd_byte); // actual dialing number length in BCD.
+	tcore_util_bcd_decode(&p_in[i], bcd_byte, p_cfis.DiallingNum, sizeof(p_cfis.DiallingNum), &digit_len);
+	p_cfis.DiallingnumLen = digit_len;
 	dbg( "Dialing number Length %d \n", p_cfis.DiallingnumLen);
 
 	i = i + SIM_XDN_NUMBER_LEN_MAX / 2;
@@ -2088,6 +2041,7 @@ gboolean tcore_sim_decode_short_ons(unsigned char *p_out, unsigned char *p_in, i
 gboolean tcore_sim_decode_information_number(struct tel_sim_cphs_info_number *p_info, unsigned char* p_in, int in_length)
 {
 	int i;
+	unsigned int ton, npi;
 
 	if (in_length == 0)
 		return FALSE;
@@ -2114,11 +2068,13 @@ gboolean tcore_sim_decode_information_number(struct tel_sim_cphs_info_number *p_
 	_get_string(p_info->Alpha_id, &p_in[2],	p_info->AlphaIdLength);
 
 	p_info->DiallingnumLength = p_in[2 + p_info->AlphaIdLength] * 2;
-	p_info->TypeOfNumber = (p_in[3 + p_info->AlphaIdLength] >> 4) & 0x07;
-	p_info->NumberingPlanIdentity = p_in[3 + p_info->AlphaIdLength]	& 0x0F;
+	tcore_util_decode_ton_npi(p_in[3 + p_info->AlphaIdLength], &ton, &npi);
+	p_info->TypeOfNumber = ton;
+	p_info->NumberingPlanIdentity = npi;
 
 	// get dialing number/SSC string
-	_bcd_to_digit((char*) p_info->DiallingnumLength, (char*) &p_in[4 + p_info->AlphaIdLength],	p_info->DiallingnumLength / 2); // actual dialing number length in BCD.
+	tcore_util_bcd_decode(&p_in[4 + p_info->AlphaIdLength], p_info->DiallingnumLength / 2,
+			p_info->DiallingNum, sizeof(p_info->DiallingNum), NULL);
 	// get Extension1 id
 	p_info->Ext1RecordId = p_in[4 + p_info->AlphaIdLength + p_info->DiallingnumLength / 2];
 
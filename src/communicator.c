@@ -27,8 +27,17 @@
 #include "tcore.h"
 #include "plugin.h"
 #include "server.h"
+#include "user_request.h"
 #include "communicator.h"
 
+struct batch_entry_type {
+	CoreObject *source;
+	enum tcore_notification_command command;
+	unsigned int key;
+	unsigned int data_len;
+	void *data;
+};
+
 struct tcore_communicator_type {
 	const char *name;
 	struct tcore_communitor_operations *ops;
@@ -36,8 +45,185 @@ struct tcore_communicator_type {
 	void *user_data;
 
 	TcorePlugin *parent_plugin;
+
+	/* notification batching, disabled while batch_window is 0 */
+	unsigned int batch_window;
+	guint batch_timer;
+	GQueue *batch_queue;
+	GHashTable *batch_commands;
+	struct tcore_communicator_batch_stats batch_stats;
+};
+
+/*
+ * State notifications where only the latest value matters. Coalescing
+ * them is safe, anything else is delivered as soon as it is sent.
+ */
+static const enum tcore_notification_command batch_default_commands[] = {
+	TNOTI_NETWORK_REGISTRATION_STATUS,
+	TNOTI_NETWORK_LOCATION_CELLINFO,
+	TNOTI_NETWORK_ICON_INFO,
+	TNOTI_PS_CURRENT_SESSION_DATA_COUNTER,
+};
+
+static unsigned int _batch_key(enum tcore_notification_command command,
+		unsigned int data_len, const void *data)
+{
+	const struct tnoti_network_icon_info *icon;
+
+	/*
+	 * Icon info carries rssi and battery updates in the same command,
+	 * only an update of the same kind supersedes an earlier one.
+	 */
+	if (command == TNOTI_NETWORK_ICON_INFO && data
+			&& data_len >= sizeof(struct tnoti_network_icon_info)) {
+		icon = data;
+		return icon->type;
+	}
+
+	return 0;
+}
+
+struct response_type {
+	Communicator *comm;
+	UserRequest *ur;
+	enum tcore_response_command command;
+	unsigned int data_len;
+	void *data;
 };
 
+static gboolean _on_main_response(gpointer user_data)
+{
+	struct response_type *r = user_data;
+
+	r->comm->ops->send_response(r->comm, r->ur, r->command, r->data_len, r->data);
+
+	tcore_user_request_unref(r->ur);
+
+	if (r->data)
+		free(r->data);
+
+	free(r);
+
+	return FALSE;
+}
+
+static void _batch_entry_free(struct batch_entry_type *entry)
+{
+	if (entry->data)
+		free(entry->data);
+
+	free(entry);
+}
+
+/* source NULL and command TNOTI_UNKNOWN match any held notification */
+static void _batch_deliver(Communicator *comm, CoreObject *source,
+		enum tcore_notification_command command)
+{
+	struct batch_entry_type *entry;
+	GList *list, *next;
+	TReturn ret;
+
+	if (!comm->batch_queue)
+		return;
+
+	for (list = comm->batch_queue->head; list; list = next) {
+		next = list->next;
+
+		entry = list->data;
+		if (source && entry->source != source)
+			continue;
+
+		if (command != TNOTI_UNKNOWN && entry->command != command)
+			continue;
+
+		g_queue_delete_link(comm->batch_queue, list);
+
+		ret = comm->ops->send_notification(comm, entry->source,
+				entry->command, entry->data_len, entry->data);
+		if (ret == TCORE_RETURN_SUCCESS)
+			comm->batch_stats.delivered++;
+		else
+			comm->batch_stats.dropped++;
+
+		_batch_entry_free(entry);
+	}
+}
+
+static gboolean _on_batch_timeout(gpointer user_data)
+{
+	Communicator *comm = user_data;
+
+	comm->batch_timer = 0;
+	comm->batch_stats.batches++;
+
+	_batch_deliver(comm, NULL, TNOTI_UNKNOWN);
+
+	return FALSE;
+}
+
+static TReturn _batch_queue(Communicator *comm, CoreObject *source,
+		enum tcore_notification_command command,
+		unsigned int data_len, const void *data)
+{
+	struct batch_entry_type *entry = NULL;
+	unsigned int key;
+	void *copy = NULL;
+	GList *list;
+
+	if (data && data_len) {
+		copy = malloc(data_len);
+		if (!copy) {
+			comm->batch_stats.dropped++;
+			return TCORE_RETURN_ENOMEM;
+		}
+
+		memcpy(copy, data, data_len);
+	}
+
+	key = _batch_key(command, data_len, data);
+
+	for (list = comm->batch_queue->head; list; list = list->next) {
+		entry = list->data;
+		if (entry->source == source && entry->command == command
+				&& entry->key == key)
+			break;
+	}
+
+	if (list) {
+		/* superseded, the new value takes the place at the tail */
+		g_queue_delete_link(comm->batch_queue, list);
+		if (entry->data)
+			free(entry->data);
+
+		comm->batch_stats.merged++;
+	} else {
+		entry = calloc(sizeof(struct batch_entry_type), 1);
+		if (!entry) {
+			if (copy)
+				free(copy);
+
+			comm->batch_stats.dropped++;
+			return TCORE_RETURN_ENOMEM;
+		}
+
+		entry->source = source;
+		entry->command = command;
+		entry->key = key;
+	}
+
+	entry->data_len = copy ? data_len : 0;
+	entry->data = copy;
+
+	g_queue_push_tail(comm->batch_queue, entry);
+	comm->batch_stats.queued++;
+
+	if (!comm->batch_timer)
+		comm->batch_timer = g_timeout_add(comm->batch_window,
+				_on_batch_timeout, comm);
+
+	return TCORE_RETURN_SUCCESS;
+}
+
 
 Communicator* tcore_communicator_new(TcorePlugin *plugin, const char *name,
 		struct tcore_communitor_operations *ops)
@@ -61,9 +247,32 @@ Communicator* tcore_communicator_new(TcorePlugin *plugin, const char *name,
 
 void tcore_communicator_free(Communicator *comm)
 {
+	struct batch_entry_type *entry;
+
 	if (!comm)
 		return;
 
+	/* core objects flush batches through the server list on release */
+	tcore_server_remove_communicator(tcore_plugin_ref_server(comm->parent_plugin), comm);
+
+	if (comm->batch_timer) {
+		g_source_remove(comm->batch_timer);
+		comm->batch_timer = 0;
+	}
+
+	if (comm->batch_queue) {
+		while ((entry = g_queue_pop_head(comm->batch_queue)) != NULL)
+			_batch_entry_free(entry);
+
+		g_queue_free(comm->batch_queue);
+		comm->batch_queue = NULL;
+	}
+
+	if (comm->batch_commands) {
+		g_hash_table_destroy(comm->batch_commands);
+		comm->batch_commands = NULL;
+	}
+
 	if (comm->name)
 		free((void *)comm->name);
 
@@ -120,12 +329,39 @@ TReturn tcore_communicator_send_response(Communicator *comm, UserRequest *ur,
 		enum tcore_response_command command,
 		unsigned int data_len, const void *data)
 {
+	Server *s;
+	struct response_type *r;
+
 	if (!comm || !comm->ops || !comm->ops->send_response)
 		return TCORE_RETURN_EINVAL;
 
 	dbg("ur = 0x%x", ur);
 
-	return comm->ops->send_response(comm, ur, command, data_len, data);
+	s = tcore_plugin_ref_server(comm->parent_plugin);
+	if (!s || tcore_server_is_main_thread(s))
+		return comm->ops->send_response(comm, ur, command, data_len, data);
+
+	/* responses from a plugin worker are sent on the server main loop */
+	r = calloc(sizeof(struct response_type), 1);
+	if (!r)
+		return TCORE_RETURN_ENOMEM;
+
+	if (data && data_len) {
+		r->data = malloc(data_len);
+		if (!r->data) {
+			free(r);
+			return TCORE_RETURN_ENOMEM;
+		}
+
+		memcpy(r->data, data, data_len);
+		r->data_len = data_len;
+	}
+
+	r->comm = comm;
+	r->ur = tcore_user_request_ref(ur);
+	r->command = command;
+
+	return tcore_server_invoke(s, _on_main_response, r, NULL);
 }
 
 TReturn tcore_communicator_send_notification(Communicator *comm,
@@ -135,5 +371,105 @@ TReturn tcore_communicator_send_notification(Communicator *comm,
 	if (!comm || !comm->ops || !comm->ops->send_notification)
 		return TCORE_RETURN_EINVAL;
 
+	if (comm->batch_window && g_hash_table_lookup(comm->batch_commands,
+				GUINT_TO_POINTER(command)))
+		return _batch_queue(comm, source, command, data_len, data);
+
 	return comm->ops->send_notification(comm, source, command, data_len, data);
 }
+
+TReturn tcore_communicator_set_notification_batch(Communicator *comm,
+		unsigned int window_ms)
+{
+	unsigned int i;
+
+	if (!comm)
+		return TCORE_RETURN_EINVAL;
+
+	if (!comm->batch_commands) {
+		comm->batch_commands = g_hash_table_new(g_direct_hash, g_direct_equal);
+		if (!comm->batch_commands)
+			return TCORE_RETURN_ENOMEM;
+
+		for (i = 0; i < G_N_ELEMENTS(batch_default_commands); i++)
+			g_hash_table_insert(comm->batch_commands,
+					GUINT_TO_POINTER(batch_default_commands[i]),
+					GUINT_TO_POINTER(TRUE));
+	}
+
+	if (!comm->batch_queue) {
+		comm->batch_queue = g_queue_new();
+		if (!comm->batch_queue)
+			return TCORE_RETURN_ENOMEM;
+	}
+
+	dbg("comm(%s) notification batch window %d ms", comm->name, window_ms);
+
+	/*
+	 * A running window keeps its length, the new one applies from the
+	 * next batch. Disabling delivers whatever is still held.
+	 */
+	comm->batch_window = window_ms;
+
+	if (window_ms == 0)
+		tcore_communicator_flush_notification(comm, NULL);
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+TReturn tcore_communicator_add_batch_notification(Communicator *comm,
+		enum tcore_notification_command command)
+{
+	if (!comm || !comm->batch_commands)
+		return TCORE_RETURN_EINVAL;
+
+	g_hash_table_insert(comm->batch_commands, GUINT_TO_POINTER(command),
+			GUINT_TO_POINTER(TRUE));
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+TReturn tcore_communicator_remove_batch_notification(Communicator *comm,
+		enum tcore_notification_command command)
+{
+	if (!comm || !comm->batch_commands)
+		return TCORE_RETURN_EINVAL;
+
+	g_hash_table_remove(comm->batch_commands, GUINT_TO_POINTER(command));
+
+	/* deliver what is already held so the command is not delayed further */
+	if (command != TNOTI_UNKNOWN)
+		_batch_deliver(comm, NULL, command);
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+TReturn tcore_communicator_flush_notification(Communicator *comm,
+		CoreObject *source)
+{
+	if (!comm || !comm->ops || !comm->ops->send_notification)
+		return TCORE_RETURN_EINVAL;
+
+	if (!comm->batch_queue)
+		return TCORE_RETURN_SUCCESS;
+
+	_batch_deliver(comm, source, TNOTI_UNKNOWN);
+
+	if (g_queue_is_empty(comm->batch_queue) && comm->batch_timer) {
+		g_source_remove(comm->batch_timer);
+		comm->batch_timer = 0;
+	}
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+TReturn tcore_communicator_get_batch_stats(Communicator *comm,
+		struct tcore_communicator_batch_stats *stats)
+{
+	if (!comm || !stats)
+		return TCORE_RETURN_EINVAL;
+
+	memcpy(stats, &comm->batch_stats, sizeof(struct tcore_communicator_batch_stats));
+
+	return TCORE_RETURN_SUCCESS;
+}
@@ -26,13 +26,16 @@
 
 #include "tcore.h"
 #include "plugin.h"
+#include "server.h"
+#include "communicator.h"
 #include "core_object.h"
 #include "hal.h"
 #include "at.h"
 
 struct callback_type {
 	CoreObject *co;
-	char *event;
+	GQuark event_id;
+	const char *event; /* interned, owned by the quark table */
 	CoreObjectCallback callback;
 	void *user_data;
 };
@@ -50,10 +53,16 @@ struct tcore_object_type {
 	CoreObjectCloneHook clone_hook;
 	CoreObjectDispatcher dispatcher;
 	GSList *callbacks;
+	GHashTable *callback_table; /* event quark -> callbacks in order */
 
 	TcoreHal *hal;
 };
 
+static void _free_callback_bucket(gpointer data)
+{
+	g_slist_free(data);
+}
+
 static CoreObject *_object_new(TcorePlugin *plugin, const char *name, unsigned int type)
 {
 	CoreObject *co;
@@ -63,6 +72,8 @@ static CoreObject *_object_new(TcorePlugin *plugin, const char *name, unsigned i
 		return NULL;
 
 	co->parent_plugin = plugin;
+	co->callback_table = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+			NULL, _free_callback_bucket);
 
 	if (name)
 		co->name = strdup(name);
@@ -91,6 +102,40 @@ static void _remove_at_callback(TcoreAT *at, struct callback_type *cb)
 	tcore_at_remove_notification_full(at, cb->event, _on_at_event, cb);
 }
 
+static void _callback_table_add(CoreObject *co, struct callback_type *cb)
+{
+	gpointer key = GUINT_TO_POINTER(cb->event_id);
+	GSList *bucket;
+
+	bucket = g_hash_table_lookup(co->callback_table, key);
+	if (!bucket && co->parent_plugin)
+		tcore_plugin_add_event_subscriber(co->parent_plugin, cb->event_id, co);
+
+	g_hash_table_steal(co->callback_table, key);
+	g_hash_table_insert(co->callback_table, key, g_slist_append(bucket, cb));
+}
+
+static void _callback_remove(CoreObject *co, struct callback_type *cb)
+{
+	gpointer key = GUINT_TO_POINTER(cb->event_id);
+	GSList *bucket;
+
+	if (co->hal && tcore_hal_get_mode(co->hal) == TCORE_HAL_MODE_AT)
+		_remove_at_callback(tcore_hal_get_at(co->hal), cb);
+
+	co->callbacks = g_slist_remove(co->callbacks, cb);
+
+	bucket = g_hash_table_lookup(co->callback_table, key);
+	bucket = g_slist_remove(bucket, cb);
+	g_hash_table_steal(co->callback_table, key);
+	if (bucket)
+		g_hash_table_insert(co->callback_table, key, bucket);
+	else if (co->parent_plugin)
+		tcore_plugin_remove_event_subscriber(co->parent_plugin, cb->event_id, co);
+
+	free(cb);
+}
+
 CoreObject *tcore_object_new(TcorePlugin *plugin,
 		const char *name, TcoreHal *hal)
 {
@@ -108,18 +153,19 @@ CoreObject *tcore_object_new(TcorePlugin *plugin,
 	return co;
 }
 
-void tcore_object_free(CoreObject *co)
+struct release_type {
+	Server *s;
+	CoreObject *co;
+};
+
+static void _object_release(Server *s, CoreObject *co)
 {
 	GSList *l = NULL;
 	struct callback_type *cb = NULL;
 
-	if (!co)
-		return;
-
-	dbg("co_name=%s", co->name);
-
-	if (co->free_hook)
-		co->free_hook(co);
+	/* batched notifications must not outlive their source */
+	for (l = tcore_server_ref_communicators(s); l; l = l->next)
+		tcore_communicator_flush_notification(l->data, co);
 
 	if (co->callbacks) {
 		for (l = co->callbacks; l; l = l->next) {
@@ -130,9 +176,6 @@ void tcore_object_free(CoreObject *co)
 			if (!cb)
 				continue;
 
-			if (cb->event)
-				g_free(cb->event);
-
 			g_free(cb);
 		}
 
@@ -140,12 +183,62 @@ void tcore_object_free(CoreObject *co)
 		co->callbacks = NULL;
 	}
 
+	if (co->callback_table) {
+		g_hash_table_destroy(co->callback_table);
+		co->callback_table = NULL;
+	}
+
 	if (co->name)
 		g_free(co->name);
 
 	g_free(co);
 }
 
+static gboolean _on_main_release(gpointer user_data)
+{
+	struct release_type *r = user_data;
+
+	_object_release(r->s, r->co);
+	free(r);
+
+	return FALSE;
+}
+
+void tcore_object_free(CoreObject *co)
+{
+	Server *s = NULL;
+	struct release_type *r;
+
+	if (!co)
+		return;
+
+	dbg("co_name=%s", co->name);
+
+	if (co->free_hook)
+		co->free_hook(co);
+
+	if (co->parent_plugin) {
+		s = tcore_plugin_ref_server(co->parent_plugin);
+		tcore_plugin_remove_core_object(co->parent_plugin, co);
+	}
+
+	/*
+	 * Notifications a worker sent are still queued for the server thread
+	 * and carry co as their source, so it is released behind them.
+	 */
+	if (s && !tcore_server_is_main_thread(s)) {
+		r = calloc(sizeof(struct release_type), 1);
+		if (r) {
+			r->s = s;
+			r->co = co;
+			tcore_server_invoke(s, _on_main_release, r, NULL);
+			return;
+		}
+	}
+
+	_object_release(s, co);
+}
+
 CoreObject *tcore_object_clone(CoreObject *src, TcorePlugin *new_parent, const char *new_name)
 {
 	CoreObject *dest;
@@ -277,6 +370,9 @@ TReturn tcore_object_set_type(CoreObject *co, unsigned int type)
 
 	co->type = type;
 
+	if (co->parent_plugin)
+		tcore_plugin_update_core_object(co->parent_plugin, co);
+
 	return TCORE_RETURN_SUCCESS;
 }
 
@@ -407,11 +503,13 @@ TReturn tcore_object_add_callback(CoreObject *co,
 		return TCORE_RETURN_ENOMEM;
 
 	cb->co = co;
-	cb->event = strdup(event);
+	cb->event_id = g_quark_from_string(event);
+	cb->event = g_quark_to_string(cb->event_id);
 	cb->callback = callback;
 	cb->user_data = user_data;
 
 	co->callbacks = g_slist_append(co->callbacks, cb);
+	_callback_table_add(co, cb);
 
 	if (co->hal) {
 		if (tcore_hal_get_mode(co->hal) == TCORE_HAL_MODE_AT) {
@@ -431,8 +529,8 @@ TReturn tcore_object_del_callback(CoreObject *co,
 		const char *event, CoreObjectCallback callback)
 {
 	struct callback_type *cb = NULL;
-	GSList *l = NULL;
-	TcoreAT *at = NULL;
+	GSList *l = NULL, *next;
+	GQuark event_id;
 
 	if (!co || !event || !callback || !co->callbacks)
 		return TCORE_RETURN_EINVAL;
@@ -440,14 +538,14 @@ TReturn tcore_object_del_callback(CoreObject *co,
 	if (strlen(event) < 1)
 		return TCORE_RETURN_EINVAL;
 
-	if (co->hal) {
-		if (tcore_hal_get_mode(co->hal) == TCORE_HAL_MODE_AT)
-			at = tcore_hal_get_at(co->hal);
-	}
+	/* never registered by anyone, nothing to remove */
+	event_id = g_quark_try_string(event);
+	if (!event_id)
+		return TCORE_RETURN_SUCCESS;
 
-	for (l = co->callbacks; l; l = l->next) {
-		if (!l)
-			continue;
+	l = g_hash_table_lookup(co->callback_table, GUINT_TO_POINTER(event_id));
+	for (; l; l = next) {
+		next = l->next;
 
 		cb = l->data;
 		if (!cb)
@@ -456,15 +554,7 @@ TReturn tcore_object_del_callback(CoreObject *co,
 		if (cb->callback != callback)
 			continue;
 
-		if (g_strcmp0(cb->event, event) != 0)
-			continue;
-
-		if (at)
-			_remove_at_callback(at, cb);
-
-		free(cb->event);
-		co->callbacks = g_slist_remove(co->callbacks, cb);
-		free(cb);
+		_callback_remove(co, cb);
 	}
 
 	return TCORE_RETURN_SUCCESS;
@@ -472,37 +562,39 @@ TReturn tcore_object_del_callback(CoreObject *co,
 
 TReturn tcore_object_emit_callback(CoreObject *co,
 		const char *event, const void *event_info)
+{
+	if (!co || !event)
+		return TCORE_RETURN_EINVAL;
+
+	return tcore_object_emit_callback_quark(co, g_quark_try_string(event),
+			event_info);
+}
+
+TReturn tcore_object_emit_callback_quark(CoreObject *co,
+		GQuark event_id, const void *event_info)
 {
 	struct callback_type *cb = NULL;
-	GSList *l = NULL;
+	GSList *l = NULL, *next;
 	TReturn ret;
 
-	if (!co || !event)
+	if (!co)
 		return TCORE_RETURN_EINVAL;
 
-	l = co->callbacks;
-	while (l) {
-		cb = l->data;
-		if (!cb) {
-			l = l->next;
-			continue;
-		}
+	/* a string never interned has no subscribers */
+	if (!event_id)
+		return TCORE_RETURN_SUCCESS;
 
-		if (g_strcmp0(cb->event, event) != 0) {
-			l = l->next;
-			continue;
-		}
+	l = g_hash_table_lookup(co->callback_table, GUINT_TO_POINTER(event_id));
+	for (; l; l = next) {
+		next = l->next;
 
-		if (cb->callback) {
-			ret = cb->callback(co, event_info, cb->user_data);
-			if (ret == FALSE) {
-				l = l->next;
-				co->callbacks = g_slist_remove(co->callbacks, cb);
-				continue;
-			}
-		}
+		cb = l->data;
+		if (!cb || !cb->callback)
+			continue;
 
-		l = l->next;
+		ret = cb->callback(co, event_info, cb->user_data);
+		if (ret == FALSE)
+			_callback_remove(co, cb);
 	}
 
 	return TCORE_RETURN_SUCCESS;
@@ -24,6 +24,7 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <time.h>
+#include <sys/uio.h>
 
 #include <glib.h>
 
@@ -35,11 +36,15 @@
 #include "user_request.h"
 #include "server.h"
 #include "mux.h"
+#include "trace.h"
 
 
 //#define IDLE_SEND_PRIORITY G_PRIORITY_DEFAULT
 #define IDLE_SEND_PRIORITY G_PRIORITY_HIGH
 
+/* Scattered data up to this size is gathered on stack for 'send' */
+#define HAL_SENDV_STACK_SIZE 256
+
 struct hook_send_type {
 	TcoreHalSendHook func;
 	void *user_data;
@@ -55,6 +60,7 @@ struct tcore_hal_type {
 	TcoreQueue *queue;
 	char *name;
 	struct tcore_hal_operations *ops;
+	TcoreHalSendv sendv;
 	void *user_data;
 	GSList *callbacks;
 	gboolean power_state;
@@ -62,8 +68,29 @@ struct tcore_hal_type {
 
 	enum tcore_hal_mode mode;
 	TcoreAT *at;
+
+	/* CMUX object (Physical HAL in TRANSPARENT mode) */
+	TcoreMux *mux;
+
+	/* gathers scattered data for 'send', kept across sends */
+	unsigned char *gather_buf;
+	unsigned int gather_size;
+	gboolean gather_busy;
+
+	/* trace id of the pending being sent, and of the one awaiting data */
+	guint64 tx_trace_id;
+	guint64 rx_trace_id;
 };
 
+static void _hal_trace_first_byte(TcoreHal *h, unsigned int data_len)
+{
+	if (!h->rx_trace_id || data_len == 0)
+		return;
+
+	tcore_trace_record(h->rx_trace_id, TCORE_TRACE_FIRST_BYTE, data_len);
+	h->rx_trace_id = 0;
+}
+
 static gboolean _hal_idle_send(void *user_data)
 {
 	TcoreHal *h = user_data;
@@ -89,6 +116,8 @@ static gboolean _hal_idle_send(void *user_data)
 	dbg("queue len=%d, pending=0x%x, id=0x%x, data_len=%d",
 			tcore_queue_get_length(h->queue), (unsigned int)p, tcore_pending_get_id(p), data_len);
 
+	h->tx_trace_id = tcore_pending_get_trace_id(p);
+
 	if (h->mode == TCORE_HAL_MODE_AT) {
 		ret = tcore_at_set_request(h->at, data, TRUE);
 	}
@@ -96,6 +125,13 @@ static gboolean _hal_idle_send(void *user_data)
 		ret = tcore_hal_send_data(h, data_len, data);
 	}
 
+	if (ret == TCORE_RETURN_SUCCESS) {
+		tcore_trace_record(h->tx_trace_id, TCORE_TRACE_SEND, data_len);
+		h->rx_trace_id = h->tx_trace_id;
+	}
+
+	h->tx_trace_id = 0;
+
 	if (ret == TCORE_RETURN_SUCCESS) {
 		tcore_pending_emit_send_callback(p, TRUE);
 	}
@@ -163,6 +199,10 @@ void tcore_hal_free(TcoreHal *hal)
 
 	dbg("hal=%s", hal->name);
 
+	/* Close the CMUX session owned by this HAL */
+	if (hal->mux)
+		tcore_cmux_close_hal(hal);
+
 	if (hal->name)
 		free(hal->name);
 
@@ -175,6 +215,7 @@ void tcore_hal_free(TcoreHal *hal)
 	if (hal->at)
 		tcore_at_free(hal->at);
 
+	free(hal->gather_buf);
 	free(hal);
 }
 
@@ -249,6 +290,24 @@ void *tcore_hal_ref_user_data(TcoreHal *hal)
 	return hal->user_data;
 }
 
+TReturn tcore_hal_link_mux(TcoreHal *hal, TcoreMux *mux)
+{
+	if (!hal)
+		return TCORE_RETURN_EINVAL;
+
+	hal->mux = mux;
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+TcoreMux *tcore_hal_ref_mux(TcoreHal *hal)
+{
+	if (!hal)
+		return NULL;
+
+	return hal->mux;
+}
+
 /* Send data without Queue */
 TReturn tcore_hal_send_data(TcoreHal *hal, unsigned int data_len, void *data)
 {
@@ -272,6 +331,74 @@ TReturn tcore_hal_send_data(TcoreHal *hal, unsigned int data_len, void *data)
 	return hal->ops->send(hal, data_len, data);
 }
 
+TReturn tcore_hal_set_sendv(TcoreHal *hal, TcoreHalSendv func)
+{
+	if (!hal)
+		return TCORE_RETURN_EINVAL;
+
+	hal->sendv = func;
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+/* Send scattered data without Queue */
+TReturn tcore_hal_send_datav(TcoreHal *hal, const struct iovec *iov, int iovcnt)
+{
+	unsigned char stack_buf[HAL_SENDV_STACK_SIZE];
+	unsigned char *buf;
+	unsigned int len = 0;
+	unsigned int pos = 0;
+	TReturn ret;
+	int i;
+
+	if (!hal || !hal->ops || !iov || iovcnt <= 0)
+		return TCORE_RETURN_EINVAL;
+
+	/* Send hooks expect contiguous data, use 'sendv' only without hooks */
+	if (hal->sendv && !hal->hook_list_send)
+		return hal->sendv(hal, iov, iovcnt);
+
+	for (i = 0; i < iovcnt; i++)
+		len += iov[i].iov_len;
+
+	if (len <= sizeof(stack_buf)) {
+		buf = stack_buf;
+	}
+	else if (hal->gather_busy) {
+		/* A send hook sending again on this HAL, gather separately */
+		buf = malloc(len);
+		if (!buf)
+			return TCORE_RETURN_ENOMEM;
+	}
+	else {
+		if (len > hal->gather_size) {
+			buf = realloc(hal->gather_buf, len);
+			if (!buf)
+				return TCORE_RETURN_ENOMEM;
+
+			hal->gather_buf = buf;
+			hal->gather_size = len;
+		}
+
+		buf = hal->gather_buf;
+		hal->gather_busy = TRUE;
+	}
+
+	for (i = 0; i < iovcnt; i++) {
+		memcpy(buf + pos, iov[i].iov_base, iov[i].iov_len);
+		pos += iov[i].iov_len;
+	}
+
+	ret = tcore_hal_send_data(hal, len, buf);
+
+	if (buf == hal->gather_buf)
+		hal->gather_busy = FALSE;
+	else if (buf != stack_buf)
+		free(buf);
+
+	return ret;
+}
+
 /* Send data by Queue */
 TReturn tcore_hal_send_request(TcoreHal *hal, TcorePending *pending)
 {
@@ -291,7 +418,7 @@ TReturn tcore_hal_send_request(TcoreHal *hal, TcorePending *pending)
 	}
 	else {
 		if (tcore_queue_get_length(hal->queue) == 1) {
-			g_idle_add_full(IDLE_SEND_PRIORITY, _hal_idle_send, hal, NULL);
+			tcore_plugin_add_idle(hal->parent_plugin, IDLE_SEND_PRIORITY, _hal_idle_send, hal);
 		}
 	}
 
@@ -319,12 +446,14 @@ TReturn tcore_hal_dispatch_response_data(TcoreHal *hal, int id,
 	if (data_len > 0 && data == NULL)
 		return TCORE_RETURN_EINVAL;
 
+	_hal_trace_first_byte(hal, data_len);
+
 	if (hal->mode == TCORE_HAL_MODE_AT) {
 		gboolean ret;
 		ret = tcore_at_process(hal->at, data_len, data);
 		if (ret) {
 			/* Send next request in queue */
-			g_idle_add_full(IDLE_SEND_PRIORITY, _hal_idle_send, hal, NULL );
+			tcore_plugin_add_idle(hal->parent_plugin, IDLE_SEND_PRIORITY, _hal_idle_send, hal);
 		}
 	}
 	else {
@@ -344,10 +473,10 @@ TReturn tcore_hal_dispatch_response_data(TcoreHal *hal, int id,
 			dbg("TCORE_HAL_MODE_TRANSPARENT");
 			
 			/* Invoke CMUX receive API for decoding */
-			tcore_cmux_rcv_from_hal((unsigned char *)data, data_len);
+			tcore_cmux_rcv_hal(hal, (unsigned char *)data, data_len);
 		}
 		/* Send next request in queue */
-		g_idle_add_full(IDLE_SEND_PRIORITY, _hal_idle_send, hal, NULL );
+		tcore_plugin_add_idle(hal->parent_plugin, IDLE_SEND_PRIORITY, _hal_idle_send, hal);
 	}
 
 	return TCORE_RETURN_SUCCESS;
@@ -406,6 +535,8 @@ TReturn tcore_hal_emit_recv_callback(TcoreHal *hal, unsigned int data_len,
 	if (!hal)
 		return TCORE_RETURN_EINVAL;
 
+	_hal_trace_first_byte(hal, data_len);
+
 	for (list = hal->callbacks; list; list = list->next) {
 		item = list->data;
 
@@ -469,6 +600,14 @@ TcoreQueue *tcore_hal_ref_queue(TcoreHal *hal)
 	return hal->queue;
 }
 
+guint64 tcore_hal_get_trace_id(TcoreHal *hal)
+{
+	if (!hal)
+		return 0;
+
+	return hal->tx_trace_id;
+}
+
 TcorePlugin *tcore_hal_ref_plugin(TcoreHal *hal)
 {
 	if (!hal)
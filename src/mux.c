@@ -21,6 +21,13 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <sys/uio.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
 
 #include <glib.h>
 
@@ -33,14 +40,44 @@
 #include "mux.h"
 #include "core_object.h"
 
-/* Maximum Core objects per Logical HAL (indirectly per Channel) */
-#define MAX_CMUX_CORE_OBJECTS		3
+#include "mux_fcs.h"
 
 /* Max CMUX Buffer size */
 #define MAX_CMUX_BUFFER_SIZE		4096
 
-/* Max muber of CMUX Channels */
-#define MAX_CMUX_CHANNELS_SUPPORTED	8
+/* N1: maximum Information field size of a frame.
+  * Default is the CMUX buffer size, the Length Indicator (2 octets)
+  * can carry at most 32767 octets.
+  */
+#define CMUX_DEFAULT_FRAME_SIZE		MAX_CMUX_BUFFER_SIZE
+#define CMUX_MAX_FRAME_SIZE			32767
+
+/* 27.010 5.7.2 default N1, used on a DLC until its PN response arrives */
+#define CMUX_BASIC_DEFAULT_N1		31
+#define CMUX_ADVANCED_DEFAULT_N1	64
+
+/* Frame header
+  * Basic mode: Flag, Address, Control, Length (1 or 2 octets)
+  * Advanced mode: Flag, Address, Control (each possibly escaped)
+  */
+#define CMUX_FRAME_HEADER_MAX		5
+
+/* Frame trailer: FCS (possibly escaped in Advanced mode), Flag */
+#define CMUX_FRAME_TRAILER_MAX		3
+
+/* Basic mode decoder: frame did not start in the current read */
+#define CMUX_NO_FRAME_START			((size_t) -1)
+
+/* Flag octets */
+#define CMUX_BASIC_FLAG				0xF9
+#define CMUX_ADVANCED_FLAG			0x7E
+
+/* Advanced mode control octet transparency (27.010 5.2.7.1) */
+#define CMUX_ADVANCED_ESCAPE		0x7D
+#define CMUX_ADVANCED_ESCAPE_MASK	0x20
+
+/* Max muber of CMUX Channels - DLCI is 6 bits */
+#define MAX_CMUX_CHANNELS_SUPPORTED	64
 
 /* CMUX Commands */
 #define CMUX_COMMAND_SABM			0x2F
@@ -55,8 +92,44 @@
   */
 #define  CMUX_COMMAND_MSC			0xE3    // Modem Status Command
 #define  CMUX_COMMAND_CLD			0xC3    // Multiplexer close down
+#define  CMUX_COMMAND_PN			0x83    // DLC parameter negotiation
+#define  CMUX_COMMAND_NSC			0x13    // Non Supported Command (response only)
+#define  CMUX_COMMAND_FCON			0xA3    // Flow Control On (aggregate)
+#define  CMUX_COMMAND_FCOFF			0x63    // Flow Control Off (aggregate)
+
+/* 5.4.6.3.7 MSC - V.24 control signals octet */
+#define CMUX_MSC_FC					0x02    // Flow Control - unable to accept frames
+#define CMUX_MSC_RTC				0x04    // Ready To Communicate
+#define CMUX_MSC_RTR				0x08    // Ready To Receive
+
+/* C/R bit of a control message type octet, set for commands */
+#define CMUX_CONTROL_CR_BIT			0x02
+
+/* Control message: Type, Length (1 octet) and up to 127 value octets */
+#define CMUX_CONTROL_MESSAGE_MAX	(2 + 127)
+
+/* 5.4.6.3.1 DLC parameter negotiation (PN) */
+#define CMUX_PN_LENGTH				8
+#define CMUX_PN_DEFAULT_T1			10      // Acknowledgement timer - 100ms
+#define CMUX_PN_DEFAULT_N2			3       // Maximum number of retransmissions
+#define CMUX_PN_DEFAULT_K			2       // Window size (Error recovery mode)
+
+/* Credit based flow control, proposed/accepted in the CL field of PN.
+  * The k field then carries the initial credits (3 bits), further credits
+  * are granted in the first Information octet of UIH frames with P/F set.
+  */
+#define CMUX_PN_CL_CREDIT_COMMAND	0xF0
+#define CMUX_PN_CL_CREDIT_RESPONSE	0xE0
+#define CMUX_PN_CREDIT_MAX			0x07
+#define CMUX_CREDIT_MAX				0xFF
 
-/* CMUX Channels [0-7] -
+/* Transmit scheduler - one Deficit Round Robin round per idle iteration,
+  * below the HAL send priority so new writes get in between rounds.
+  */
+#define CMUX_TX_SCHEDULER_PRIORITY	G_PRIORITY_DEFAULT_IDLE
+#define CMUX_DEFAULT_WEIGHT			1
+
+/* Default CMUX Channels [0-7] -
   * Channel 0 - Control Channel for CMUX
   * Channel 1 - CALL
   * Channel 2 - SIM
@@ -90,6 +163,7 @@ typedef enum MuxChannelState {
 	MUX_CHANNEL_UA_SEND_CLOSING,
 	MUX_CHANNEL_UA_RECEIVED,
 	MUX_CHANNEL_UA_SENDING,
+	MUX_CHANNEL_PN_SEND_WAITING_FOR_RESPONSE,
 } MuxChannelState;
 
 /* MUX State */
@@ -111,29 +185,15 @@ typedef enum MuxState {
 		} \
 } while (0)
 
-/*================= CRC TABLE=========================*/
-const unsigned char crc_table[256] = { // reversed, 8-bit, poly=0x07
-	0x00, 0x91, 0xE3, 0x72, 0x07, 0x96, 0xE4, 0x75, 0x0E, 0x9F, 0xED, 0x7C, 0x09, 0x98, 0xEA, 0x7B,
-	0x1C, 0x8D, 0xFF, 0x6E, 0x1B, 0x8A, 0xF8, 0x69, 0x12, 0x83, 0xF1, 0x60, 0x15, 0x84, 0xF6, 0x67,
-	0x38, 0xA9, 0xDB, 0x4A, 0x3F, 0xAE, 0xDC, 0x4D, 0x36, 0xA7, 0xD5, 0x44, 0x31, 0xA0, 0xD2, 0x43,
-	0x24, 0xB5, 0xC7, 0x56, 0x23, 0xB2, 0xC0, 0x51, 0x2A, 0xBB, 0xC9, 0x58, 0x2D, 0xBC, 0xCE, 0x5F,
-	0x70, 0xE1, 0x93, 0x02, 0x77, 0xE6, 0x94, 0x05, 0x7E, 0xEF, 0x9D, 0x0C, 0x79, 0xE8, 0x9A, 0x0B,
-	0x6C, 0xFD, 0x8F, 0x1E, 0x6B, 0xFA, 0x88, 0x19, 0x62, 0xF3, 0x81, 0x10, 0x65, 0xF4, 0x86, 0x17,
-	0x48, 0xD9, 0xAB, 0x3A, 0x4F, 0xDE, 0xAC, 0x3D, 0x46, 0xD7, 0xA5, 0x34, 0x41, 0xD0, 0xA2, 0x33,
-	0x54, 0xC5, 0xB7, 0x26, 0x53, 0xC2, 0xB0, 0x21, 0x5A, 0xCB, 0xB9, 0x28, 0x5D, 0xCC, 0xBE, 0x2F,
-	0xE0, 0x71, 0x03, 0x92, 0xE7, 0x76, 0x04, 0x95, 0xEE, 0x7F, 0x0D, 0x9C, 0xE9, 0x78, 0x0A, 0x9B,
-	0xFC, 0x6D, 0x1F, 0x8E, 0xFB, 0x6A, 0x18, 0x89, 0xF2, 0x63, 0x11, 0x80, 0xF5, 0x64, 0x16, 0x87,
-	0xD8, 0x49, 0x3B, 0xAA, 0xDF, 0x4E, 0x3C, 0xAD, 0xD6, 0x47, 0x35, 0xA4, 0xD1, 0x40, 0x32, 0xA3,
-	0xC4, 0x55, 0x27, 0xB6, 0xC3, 0x52, 0x20, 0xB1, 0xCA, 0x5B, 0x29, 0xB8, 0xCD, 0x5C, 0x2E, 0xBF,
-	0x90, 0x01, 0x73, 0xE2, 0x97, 0x06, 0x74, 0xE5, 0x9E, 0x0F, 0x7D, 0xEC, 0x99, 0x08, 0x7A, 0xEB,
-	0x8C, 0x1D, 0x6F, 0xFE, 0x8B, 0x1A, 0x68, 0xF9, 0x82, 0x13, 0x61, 0xF0, 0x85, 0x14, 0x66, 0xF7,
-	0xA8, 0x39, 0x4B, 0xDA, 0xAF, 0x3E, 0x4C, 0xDD, 0xA6, 0x37, 0x45, 0xD4, 0xA1, 0x30, 0x42, 0xD3,
-	0xB4, 0x25, 0x57, 0xC6, 0xB3, 0x22, 0x50, 0xC1, 0xBA, 0x2B, 0x59, 0xC8, 0xBD, 0x2C, 0x5E, 0xCF
-};
-/*================= CRC TABLE=========================*/
-
 /* CMUX Channel */
 typedef struct cmux_channel {
+	/* MUX object owning the Channel */
+	struct tcore_cmux_type *mux;
+
+	/* Logical HAL name and Core Objects served by the Channel */
+	char *channel_id_name;
+	char *core_object_name[MAX_CMUX_CORE_OBJECTS];
+
 	GSList *co;
 	TcoreHal *hal;
 	MuxChannelState state;
@@ -142,41 +202,153 @@ typedef struct cmux_channel {
 	unsigned char ext_bit;
 	unsigned char cr_bit;
 	unsigned char poll_final_bit;
+
+	/* Negotiated N1 of the DLC */
+	int frame_size;
+
+	/* Transmit queue (CMUX_TX_DATA) - Information held while flow controlled */
+	GQueue *tx_queue;
+	unsigned int queued_bytes;
+
+	/* Stopped by MSC (FC set or RTR cleared) */
+	gboolean msc_stopped;
+
+	/* Credit based flow control */
+	gboolean credit_fc;
+	unsigned int credits;
+	unsigned int tx_credits;
+	unsigned int rx_credits;
+
+	/* Flow controlled time accounting (usec) */
+	gboolean flow_controlled;
+	gint64 fc_start;
+	gint64 fc_time;
+	unsigned int fc_count;
+
+	/* Transmit scheduling - priority Channels bypass the DRR round */
+	gboolean priority;
+	unsigned int weight;
+	gboolean scheduled;
+	int deficit;
+
+	/* Transmit statistics, latency (usec) from write to last frame sent */
+	unsigned long long tx_bytes;
+	unsigned int tx_frames;
+	unsigned int tx_writes;
+	gint64 latency_total;
+	gint64 latency_max;
 } CHANNEL;
 
-/* CMUX callback prototype */
-typedef gboolean (*mux_cb_func)(CHANNEL *channel_ptr);
+/* Information queued on a Channel, 'data' follows the structure */
+typedef struct cmux_tx_data {
+	unsigned char *data;
+	int length;
+	int offset;
+	gint64 queued_at;
+} CMUX_TX_DATA;
 
-/* CMUX structure */
-typedef struct cmux {
+/* CMUX Frame - Header and Trailer are encoded in place, the Information
+  * field is referenced from the caller's buffer and never copied.
+  */
+typedef struct cmux_frame {
+	unsigned char header[CMUX_FRAME_HEADER_MAX];
+	int header_len;
+	unsigned char *info;
+	int info_len;
+	unsigned char trailer[CMUX_FRAME_TRAILER_MAX];
+	int trailer_len;
+} CMUX_FRAME;
+
+/* CMUX Decoder states */
+typedef enum MuxDecodeState {
+	MUX_DECODE_FLAG_HUNT,
+	MUX_DECODE_ADDR_HUNT,
+	MUX_DECODE_CONTROL_HUNT,
+	MUX_DECODE_LENGTH1_HUNT,
+	MUX_DECODE_LENGTH2_HUNT,
+	MUX_DECODE_DATA_HUNT,
+	MUX_DECODE_FCS_HUNT,
+
+	/* Advanced mode: collecting octets up to the closing Flag */
+	MUX_DECODE_ADVANCED_FRAME,
+	MUX_DECODE_ADVANCED_ESCAPE
+} MuxDecodeState;
+
+/* CMUX structure - one instance per Physical HAL */
+typedef struct tcore_cmux_type {
 	MuxState state;
-	CHANNEL *channel_info[MAX_CMUX_CHANNELS_SUPPORTED];
+	CHANNEL **channel_info;
+	int channel_count;
 	int is_waiting;
 	int msg_len;
 	int cur_main_buf_len;
 	TcorePlugin *plugin;
 	TcoreHal *phy_hal;
 	CoreObject *modem_co;
-	mux_cb_func cb_func;
+
+	/* Information field of the frame being processed - not owned, points
+	  * into the received data or the decoder buffer.
+	  */
 	int info_field_len;
 	unsigned char *info_field;
-} MUX;
 
-/* Global pointer MUX Object pointer */
-MUX *g_mux_obj_ptr = NULL;
+	/* CMUX mode of operation */
+	enum tcore_cmux_mode mode;
 
-/* CMUX mode of operation */
-int g_mux_mode = 0; /* BASIC mode */
+	/* Advanced mode: Information field after byte stuffing */
+	unsigned char *tx_buf;
 
-struct cmux_channel_object {
-	char *channel_id_name;
-	char *core_object_name[MAX_CMUX_CORE_OBJECTS];
-};
+	/* N1 proposed for all DLCs, upper limit of received frames */
+	int frame_size;
 
-/* Core Object names need to be verified, define a MACRO globally */
-struct cmux_channel_object cmux_channel_core_object[] = {
+	/* N1 is negotiated (PN) on every DLC before its SABM */
+	gboolean negotiate_n1;
+
+	/* Control channel message reassembly */
+	unsigned char *ctrl_buf;
+	int ctrl_buf_len;
+
+	/* Number of Channels established (UA received) */
+	int established_count;
+
+	/* Aggregate flow control - FCoff received */
+	gboolean fc_off;
+
+	/* Backlogged Channels in DRR order and the scheduler idle source */
+	GQueue *tx_active;
+	guint tx_source;
+
+	/* Receive (decoder) state */
+	MuxDecodeState decode_state;
+	unsigned char dec_fcs;
+	unsigned char dec_address;
+	unsigned char dec_control;
+	unsigned short dec_length;
+
+	/* Header octets (Address to Length) of the frame being decoded, kept
+	  * for a rescan when the frame is dropped in a later read.
+	  */
+	unsigned char dec_header[CMUX_FRAME_HEADER_MAX];
+	int dec_header_len;
+
+	/* Information field: in place in the received data, or staged in
+	  * 'dec_buffer' when the frame spans several reads.
+	  */
+	unsigned char *dec_buffer;
+	unsigned char *dec_info;
+	int dec_info_len;
+	int dec_staged;
+
+	/* Advanced mode: unescaped octets of the frame staged so far */
+	size_t full_frame_len;
+} MUX;
+
+/* Default Channel map, used when the modem plugin provides none.
+  * Core Object names need to be verified, define a MACRO globally
+  */
+static const struct tcore_cmux_channel_object cmux_channel_core_object[] = {
 	{"channel_0", {"control", NULL, NULL}},
-	{"channel_1", {"call", NULL, NULL}},
+	{"channel_1", {"call", NULL, NULL}, 0, CMUX_DEFAULT_WEIGHT, TRUE},
 	{"channel_2", {"sim", NULL, NULL}},
 	{"channel_3", {"sat", NULL, NULL}},
 	{"channel_4", {"umts_sms", NULL, NULL}},
@@ -186,25 +358,32 @@ struct cmux_channel_object cmux_channel_core_object[] = {
 };
 
 /* All the local functions declared below */
-static unsigned char calc_crc(unsigned char *header, int length);
-static int rcv_crc_check(unsigned char *data, unsigned char len, unsigned char rcv_FCS);
-MUX* tcore_cmux_new(void);
-static void tcore_cmux_free(void);
-void tcore_cmux_link_core_object_hal(CMUX_Channels channel_id, TcorePlugin *plugin);
-static gboolean tcore_cmux_recv_mux_data(CHANNEL *channel_ptr);
-static void tcore_cmux_process_rcv_frame(unsigned char *data, int len);
-static void tcore_cmux_process_channel_data(CHANNEL *channel_info_ptr);
-static void tcore_cmux_control_channel_handle(void);
-static void tcore_cmux_flush_channel_data(void);
-static void tcore_cmux_channel_init(CMUX_Channels channel_id);
-static void tcore_cmux_close_channel(int channel_id);
-static unsigned char* tcore_encode_cmux_frame(unsigned char *data, int length, int channel_id, int frame_type, unsigned char EA_bit, unsigned char CR_bit, unsigned char PF_bit, int *out_data_len);
-static TReturn tcore_cmux_send_data(int data_len, unsigned char *data);
+static MUX* tcore_cmux_new(enum tcore_cmux_mode mode, int frame_size, int channel_count);
+static void tcore_cmux_free(MUX *mux);
+static void tcore_cmux_link_core_object_hal(MUX *mux, CMUX_Channels channel_id, TcorePlugin *plugin);
+static gboolean tcore_cmux_recv_mux_data(MUX *mux, CHANNEL *channel_ptr, unsigned char *data, int length);
+static void tcore_cmux_process_frame(MUX *mux, unsigned char address, unsigned char control, unsigned char *info, int info_len);
+static int tcore_cmux_rcv_advanced(TcoreHal *hal, MUX *mux, unsigned char *data, size_t length);
+static void tcore_cmux_process_channel_data(MUX *mux, CHANNEL *channel_info_ptr);
+static void tcore_cmux_control_channel_handle(MUX *mux);
+static gboolean tcore_cmux_process_control_message(MUX *mux, unsigned char cmd_type, unsigned char *values, int value_len);
+static TReturn tcore_cmux_send_control_message(MUX *mux, unsigned char cmd_type, unsigned char *values, int value_len);
+static TReturn tcore_cmux_send_parameter_negotiation(MUX *mux, int channel_id);
+static TReturn tcore_cmux_open_channel(MUX *mux, CHANNEL *ch);
+static void tcore_cmux_open_channels(MUX *mux);
+static void tcore_cmux_flush_channel_data(MUX *mux);
+static TReturn tcore_cmux_channel_init(MUX *mux, CMUX_Channels channel_id, const struct tcore_cmux_channel_object *channel_map);
+static void tcore_cmux_close_channel(MUX *mux, int channel_id);
+static TReturn tcore_encode_cmux_frame(MUX *mux, CMUX_FRAME *frame, unsigned char *data, int length, int channel_id, int frame_type, unsigned char EA_bit, unsigned char CR_bit, unsigned char PF_bit);
+static TReturn tcore_cmux_send_data(MUX *mux, CMUX_FRAME *frame);
+static TReturn tcore_cmux_send_frame(MUX *mux, unsigned char *data, int length, int channel_id, int frame_type, unsigned char EA_bit, unsigned char CR_bit, unsigned char PF_bit);
+static TReturn tcore_cmux_send_information(MUX *mux, int channel_id, unsigned char *data, int length);
+static void tcore_cmux_channel_resume(MUX *mux, CHANNEL *ch);
 
 static TReturn tcore_cmux_hal_power(TcoreHal *h, gboolean flag)
 {
 	TcorePlugin *p = NULL;
-	struct custom_data *user_data = NULL;
+	CHANNEL *ch = NULL;
 
 	dbg("Entry");
 
@@ -214,9 +393,9 @@ static TReturn tcore_cmux_hal_power(TcoreHal *h, gboolean flag)
 		return TCORE_RETURN_FAILURE;
 	}
 
-	user_data = tcore_hal_ref_user_data(h);
-	if (!user_data) {
-		err("User data is undefined");
+	ch = tcore_hal_ref_user_data(h);
+	if (!ch) {
+		err("Channel is undefined");
 		return TCORE_RETURN_FAILURE;
 	}
 
@@ -228,12 +407,8 @@ static TReturn tcore_cmux_hal_power(TcoreHal *h, gboolean flag)
 
 static TReturn tcore_cmux_hal_send(TcoreHal *h, unsigned int data_len, void *data)
 {
-	unsigned char *send_data = NULL;
-	char *channel_name = NULL;
-	int channel_id = MAX_CMUX_CHANNELS_SUPPORTED;
-	int len = 0;
-	int i = 0;
-	int ret;
+	CHANNEL *ch = NULL;
+	TReturn ret;
 
 	dbg("Entry");
 
@@ -243,43 +418,18 @@ static TReturn tcore_cmux_hal_send(TcoreHal *h, unsigned int data_len, void *dat
 		return TCORE_RETURN_FAILURE;
 	}
 
-	channel_name = tcore_hal_get_name(h);
-	dbg("HAL name: %s", channel_name)
-	if (channel_name) {
-		while (i < MAX_CMUX_CHANNELS_SUPPORTED) {
-			if (0 == strcmp((char *) cmux_channel_core_object[i].channel_id_name, (char *) channel_name)) {
-				channel_id = i;
-				dbg("Found Channel ID: %d", channel_id);
-
-				/* Free memory */
-				free(channel_name);
-				break;
-			}
-			i++;
-		}
-	} else {
-		err("No name defined for HAL");
-		return TCORE_RETURN_FAILURE;
-	}
-
-	if (channel_id > MAX_CMUX_CHANNELS_SUPPORTED) {
-		err("Failed to find Channel ID");
+	/* Channel (DLCI) bound to this Logical HAL at creation */
+	ch = tcore_hal_ref_user_data(h);
+	if (!ch) {
+		err("Channel is undefined");
 		return TCORE_RETURN_FAILURE;
 	}
 
 	/* Muxing operation and Frame creation */
-	/* Encoding frame */
-	send_data = tcore_encode_cmux_frame(data, data_len, channel_id, CMUX_COMMAND_UIH, 1, 1, 0, &len);
-	if (0 == len) {
-		err("Failed to encode");
-		return TCORE_RETURN_FAILURE;
-	}
-
-	/* Send CMUX data */
-	ret = tcore_cmux_send_data(len, send_data);
+	ret = tcore_cmux_send_information(ch->mux, ch->channel_id, data, data_len);
 
 	dbg("Exit");
-	return TCORE_RETURN_SUCCESS;
+	return ret;
 }
 
 /* CMUX supported HAL (Logical HAL) operations */
@@ -288,14 +438,30 @@ static struct tcore_hal_operations mux_hops = {
 	.send = tcore_cmux_hal_send,
 };
 
-static TReturn tcore_cmux_send_data(int data_len, unsigned char *data)
+/* Physical HAL of the session opened through the single-MUX entry points */
+static TcoreHal *legacy_phy_hal = NULL;
+
+static TReturn tcore_cmux_send_data(MUX *mux, CMUX_FRAME *frame)
 {
+	struct iovec iov[3];
+	int iovcnt = 0;
 	TReturn ret = TCORE_RETURN_SUCCESS;
 
 	dbg("Entry");
 
+	iov[iovcnt].iov_base = frame->header;
+	iov[iovcnt++].iov_len = frame->header_len;
+
+	if (frame->info_len > 0) {
+		iov[iovcnt].iov_base = frame->info;
+		iov[iovcnt++].iov_len = frame->info_len;
+	}
+
+	iov[iovcnt].iov_base = frame->trailer;
+	iov[iovcnt++].iov_len = frame->trailer_len;
+
 	/* Directly send to Physical HAL */
-	ret = tcore_hal_send_data(g_mux_obj_ptr->phy_hal, data_len, (void *) data);
+	ret = tcore_hal_send_datav(mux->phy_hal, iov, iovcnt);
 	if (TCORE_RETURN_SUCCESS != ret) {
 		err("Failed to send CMUX data");
 	} else {
@@ -305,7 +471,313 @@ static TReturn tcore_cmux_send_data(int data_len, unsigned char *data)
 	dbg("Exit");
 	return ret;
 }
-static gboolean tcore_cmux_recv_mux_data(CHANNEL *channel_ptr)
+
+static TReturn tcore_cmux_send_frame(MUX *mux, unsigned char *data, int length,
+									int channel_id, int frame_type,
+									unsigned char EA_bit, unsigned char CR_bit, unsigned char PF_bit)
+{
+	CMUX_FRAME frame;
+	TReturn ret;
+
+	/* Encoding frame */
+	ret = tcore_encode_cmux_frame(mux, &frame, data, length, channel_id, frame_type, EA_bit, CR_bit, PF_bit);
+	if (TCORE_RETURN_SUCCESS != ret) {
+		err("Failed to encode");
+		return ret;
+	}
+
+	/* Send CMUX data */
+	return tcore_cmux_send_data(mux, &frame);
+}
+
+static gboolean tcore_cmux_channel_is_stopped(MUX *mux, CHANNEL *ch)
+{
+	/* Control Channel is never flow controlled */
+	if (CMUX_CHANNEL_0 == ch->channel_id) {
+		return FALSE;
+	}
+
+	if (mux->fc_off || ch->msc_stopped) {
+		return TRUE;
+	}
+
+	return (ch->credit_fc && (0 == ch->tx_credits));
+}
+
+static void tcore_cmux_channel_account_flow(MUX *mux, CHANNEL *ch)
+{
+	gboolean stopped = tcore_cmux_channel_is_stopped(mux, ch);
+
+	if (stopped == ch->flow_controlled) {
+		return;
+	}
+
+	if (stopped) {
+		ch->fc_start = g_get_monotonic_time();
+		ch->fc_count++;
+		dbg("Channel: %d flow controlled", ch->channel_id);
+	} else {
+		ch->fc_time += g_get_monotonic_time() - ch->fc_start;
+		dbg("Channel: %d resumed, %lld usec flow controlled in total", ch->channel_id, (long long) ch->fc_time);
+	}
+
+	ch->flow_controlled = stopped;
+}
+
+/* N1 of a DLC until negotiated, never above what was proposed */
+static int tcore_cmux_default_frame_size(MUX *mux)
+{
+	int frame_size = (CMUX_MODE_ADVANCED == mux->mode) ? CMUX_ADVANCED_DEFAULT_N1 : CMUX_BASIC_DEFAULT_N1;
+
+	return MIN(frame_size, mux->frame_size);
+}
+
+static int tcore_cmux_channel_quantum(MUX *mux, CHANNEL *ch)
+{
+	int frame_size = (ch->frame_size > 0) ? ch->frame_size : tcore_cmux_default_frame_size(mux);
+
+	/* At least one full frame per round */
+	return ch->weight * frame_size;
+}
+
+static void tcore_cmux_channel_account_write(CHANNEL *ch, gint64 queued_at)
+{
+	gint64 latency = 0;
+
+	if (queued_at) {
+		latency = g_get_monotonic_time() - queued_at;
+	}
+
+	ch->tx_writes++;
+	ch->latency_total += latency;
+	if (latency > ch->latency_max) {
+		ch->latency_max = latency;
+	}
+}
+
+/* Sends 'data' from '*offset' on as UIH frames of at most N1 octets, as long
+  * as the Channel is allowed to transmit and the 'budget' (octets, NULL for
+  * unlimited) lasts. '*offset' is advanced past the data sent.
+  */
+static TReturn tcore_cmux_channel_transmit(MUX *mux, CHANNEL *ch, unsigned char *data, int length,
+											int *offset, int *budget)
+{
+	int frame_size;
+	int len;
+	TReturn ret = TCORE_RETURN_SUCCESS;
+
+	/* Information larger than N1 of the DLC is sent as consecutive UIH frames,
+	  * the receiving side sees one continuous byte stream.
+	  */
+	frame_size = ch->frame_size;
+	if (frame_size <= 0) {
+		frame_size = tcore_cmux_default_frame_size(mux);
+	}
+
+	while (*offset < length) {
+		if (tcore_cmux_channel_is_stopped(mux, ch)) {
+			break;
+		}
+
+		len = length - *offset;
+		if (len > frame_size) {
+			len = frame_size;
+		}
+
+		if (budget && (*budget < len)) {
+			break;
+		}
+
+		ret = tcore_cmux_send_frame(mux, data + *offset, len, ch->channel_id, CMUX_COMMAND_UIH, 1, 1, 0);
+		if (TCORE_RETURN_SUCCESS != ret) {
+			err("Failed to send frame - offset: %d length: %d", *offset, length);
+			break;
+		}
+
+		*offset += len;
+		if (budget) {
+			*budget -= len;
+		}
+
+		ch->tx_bytes += len;
+		ch->tx_frames++;
+
+		/* Every frame carrying data takes one credit */
+		if (ch->credit_fc) {
+			ch->tx_credits--;
+		}
+	}
+
+	tcore_cmux_channel_account_flow(mux, ch);
+
+	return ret;
+}
+
+/* Sends queued data of the Channel within 'budget' (NULL for unlimited) */
+static void tcore_cmux_channel_send_queued(MUX *mux, CHANNEL *ch, int *budget)
+{
+	CMUX_TX_DATA *tx_data = NULL;
+	TReturn ret;
+	int offset;
+
+	while ((tx_data = g_queue_peek_head(ch->tx_queue)) != NULL) {
+		offset = tx_data->offset;
+		ret = tcore_cmux_channel_transmit(mux, ch, tx_data->data, tx_data->length, &offset, budget);
+		ch->queued_bytes -= offset - tx_data->offset;
+		tx_data->offset = offset;
+
+		if (TCORE_RETURN_SUCCESS != ret) {
+			/* Physical HAL failure, retrying would stall the round */
+			err("Channel: %d drop %d queued bytes", ch->channel_id, tx_data->length - tx_data->offset);
+			ch->queued_bytes -= tx_data->length - tx_data->offset;
+		} else if (tx_data->offset < tx_data->length) {
+			/* Flow controlled or out of budget */
+			break;
+		} else {
+			tcore_cmux_channel_account_write(ch, tx_data->queued_at);
+		}
+
+		g_queue_pop_head(ch->tx_queue);
+		free(tx_data);
+	}
+}
+
+/* Deficit Round Robin over the backlogged Channels, one round per call.
+  * Every Channel gets its quantum (weight * N1) added to its deficit and
+  * sends whole frames while the deficit covers them.
+  */
+static gboolean tcore_cmux_tx_scheduler(gpointer user_data)
+{
+	MUX *mux = user_data;
+	CHANNEL *ch = NULL;
+	guint count;
+
+	count = g_queue_get_length(mux->tx_active);
+	while (count-- > 0) {
+		ch = g_queue_pop_head(mux->tx_active);
+
+		ch->deficit += tcore_cmux_channel_quantum(mux, ch);
+		tcore_cmux_channel_send_queued(mux, ch, &ch->deficit);
+
+		if (g_queue_is_empty(ch->tx_queue) || ch->flow_controlled) {
+			/* Leaves the round, joins again on write or resume */
+			ch->scheduled = FALSE;
+			ch->deficit = 0;
+		} else {
+			g_queue_push_tail(mux->tx_active, ch);
+		}
+	}
+
+	if (g_queue_is_empty(mux->tx_active)) {
+		mux->tx_source = 0;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Channel has data queued or its flow control state changed: priority
+  * Channels are drained right away, the others join the DRR round.
+  */
+static void tcore_cmux_channel_resume(MUX *mux, CHANNEL *ch)
+{
+	tcore_cmux_channel_account_flow(mux, ch);
+
+	if (ch->flow_controlled || g_queue_is_empty(ch->tx_queue)) {
+		return;
+	}
+
+	if (ch->priority) {
+		tcore_cmux_channel_send_queued(mux, ch, NULL);
+		return;
+	}
+
+	if (!ch->scheduled) {
+		ch->scheduled = TRUE;
+		ch->deficit = 0;
+		g_queue_push_tail(mux->tx_active, ch);
+	}
+
+	if (0 == mux->tx_source) {
+		mux->tx_source = tcore_plugin_add_idle(mux->plugin, CMUX_TX_SCHEDULER_PRIORITY, tcore_cmux_tx_scheduler, mux);
+	}
+}
+
+static TReturn tcore_cmux_send_information(MUX *mux, int channel_id, unsigned char *data, int length)
+{
+	CHANNEL *ch = mux->channel_info[channel_id];
+	CMUX_TX_DATA *tx_data = NULL;
+	int offset = 0;
+	int budget;
+	TReturn ret;
+
+	if (0 == length) {
+		if (tcore_cmux_channel_is_stopped(mux, ch)) {
+			dbg("Channel: %d flow controlled, drop empty frame", channel_id);
+			return TCORE_RETURN_SUCCESS;
+		}
+
+		return tcore_cmux_send_frame(mux, data, 0, channel_id, CMUX_COMMAND_UIH, 1, 1, 0);
+	}
+
+	/* Sent from the caller's buffer unless data is already waiting on the
+	  * Channel or other Channels are backlogged; then it waits for its turn.
+	  * Priority Channels send everything, the others one quantum.
+	  */
+	if (g_queue_is_empty(ch->tx_queue) && (ch->priority || g_queue_is_empty(mux->tx_active))) {
+		budget = tcore_cmux_channel_quantum(mux, ch);
+		ret = tcore_cmux_channel_transmit(mux, ch, data, length, &offset, ch->priority ? NULL : &budget);
+		if (TCORE_RETURN_SUCCESS != ret) {
+			return ret;
+		}
+
+		if (offset == length) {
+			tcore_cmux_channel_account_write(ch, 0);
+			return TCORE_RETURN_SUCCESS;
+		}
+	}
+
+	/* Keep the rest on the Channel, the other Channels are not held up */
+	tx_data = (CMUX_TX_DATA *) malloc(sizeof(CMUX_TX_DATA) + (length - offset));
+	if (!tx_data) {
+		err("Failed to allocate memory for queued data");
+		return TCORE_RETURN_ENOMEM;
+	}
+
+	tx_data->data = (unsigned char *) (tx_data + 1);
+	tx_data->length = length - offset;
+	tx_data->offset = 0;
+	tx_data->queued_at = g_get_monotonic_time();
+	memcpy(tx_data->data, data + offset, tx_data->length);
+
+	g_queue_push_tail(ch->tx_queue, tx_data);
+	ch->queued_bytes += tx_data->length;
+	dbg("Channel: %d queued %d bytes, total: %d", channel_id, tx_data->length, ch->queued_bytes);
+
+	tcore_cmux_channel_resume(mux, ch);
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+/* Returns credits to the modem once half of those granted are used */
+static void tcore_cmux_channel_grant_credits(MUX *mux, CHANNEL *ch)
+{
+	unsigned char credits;
+
+	if (ch->rx_credits > (ch->credits / 2)) {
+		return;
+	}
+
+	credits = (unsigned char) (ch->credits - ch->rx_credits);
+
+	/* UIH with P/F set, the only Information octet is the credit count */
+	if (TCORE_RETURN_SUCCESS == tcore_cmux_send_frame(mux, &credits, 1, ch->channel_id, CMUX_COMMAND_UIH, 1, 1, 1)) {
+		ch->rx_credits += credits;
+		dbg("Channel: %d granted %d credits", ch->channel_id, credits);
+	}
+}
+
+static gboolean tcore_cmux_recv_mux_data(MUX *mux, CHANNEL *channel_ptr, unsigned char *data, int length)
 {
 	TcoreHal *hal = NULL;
 
@@ -315,39 +787,44 @@ static gboolean tcore_cmux_recv_mux_data(CHANNEL *channel_ptr)
 	hal = channel_ptr->hal;
 
 	dbg("Dispatching to logical HAL - hal: %x", hal);
-	tcore_hal_dispatch_response_data(hal, 0, g_mux_obj_ptr->info_field_len, g_mux_obj_ptr->info_field);
+	tcore_hal_dispatch_response_data(hal, 0, length, data);
 
 	dbg("Exit");
 	return TRUE;
 }
 
-void tcore_cmux_link_core_object_hal(CMUX_Channels channel_id, TcorePlugin *plugin)
+static void tcore_cmux_link_core_object_hal(MUX *mux, CMUX_Channels channel_id, TcorePlugin *plugin)
 {
+	CHANNEL *ch = mux->channel_info[channel_id];
 	TcoreHal *hal = NULL;
 	CoreObject *co = NULL;
 	int index;
 
 	dbg("Entry");
 
-	if (CMUX_CHANNEL_0 != channel_id) {
-		dbg("Normal channel [%d]", channel_id);
+	/* Creating Logical HAL for Core Object - Mode - 'AT mode' */
+	hal = tcore_hal_new(plugin, ch->channel_id_name, &mux_hops, TCORE_HAL_MODE_AT);
+	dbg("hal: %p", hal);
+	if (!hal) {
+		err("Failed to create Logical HAL for Channel: %d", channel_id);
+		return;
+	}
 
-		/* Creating Logical HAL for Core Object - Mode - 'AT mode' */
-		hal = tcore_hal_new(plugin, cmux_channel_core_object[channel_id].channel_id_name, &mux_hops, TCORE_HAL_MODE_AT);
-		dbg("hal: %p", hal);
+	/* Update Logical HAL of CMUX Channel */
+	ch->hal = hal;
 
-		/* Update Logical HAL of CMUX Channel */
-		g_mux_obj_ptr->channel_info[channel_id]->hal = hal;
+	if (CMUX_CHANNEL_0 != channel_id) {
+		dbg("Normal channel [%d]", channel_id);
 
 		index = 0;
-		while (NULL != cmux_channel_core_object[channel_id].core_object_name[index]) {
+		while ((index < MAX_CMUX_CORE_OBJECTS) && (NULL != ch->core_object_name[index])) {
 			/* Retrieving Core Object */
-			dbg("Core Object: '%s'", cmux_channel_core_object[channel_id].core_object_name[index]);
-			co = tcore_plugin_ref_core_object(plugin, cmux_channel_core_object[channel_id].core_object_name[index]);
+			dbg("Core Object: '%s'", ch->core_object_name[index]);
+			co = tcore_plugin_ref_core_object(plugin, ch->core_object_name[index]);
 			dbg("co: %p", co);
 
-			if (0 == strcmp((const char *) cmux_channel_core_object[channel_id].core_object_name[index], "modem")) {
-				g_mux_obj_ptr->modem_co = co;
+			if (0 == strcmp((const char *) ch->core_object_name[index], "modem")) {
+				mux->modem_co = co;
 				dbg("'modem' Core object reference is stored");
 			}
 
@@ -355,7 +832,7 @@ void tcore_cmux_link_core_object_hal(CMUX_Channels channel_id, TcorePlugin *plug
 			tcore_object_set_hal(co, hal);
 
 			/* Update Core Object list of CMUX Channel */
-			g_mux_obj_ptr->channel_info[channel_id]->co = g_slist_append(g_mux_obj_ptr->channel_info[channel_id]->co, co);
+			ch->co = g_slist_append(ch->co, co);
 
 			/* Next Core Object of the channel */
 			index++;
@@ -363,15 +840,11 @@ void tcore_cmux_link_core_object_hal(CMUX_Channels channel_id, TcorePlugin *plug
 	} else {
 		/* Control Channel */
 		dbg("Control channel");
-
-		/* Creating Logical HAL for Core Object - Mode - 'AT mode' */
-		hal = tcore_hal_new(plugin, cmux_channel_core_object[channel_id].channel_id_name, &mux_hops, TCORE_HAL_MODE_AT);
-		dbg("hal: %p", hal);
-
-		/* Update Logical HAL of CMUX Channel */
-		g_mux_obj_ptr->channel_info[channel_id]->hal = hal;
 	}
 
+	/* Bind the Channel to the Logical HAL, sending needs no lookup */
+	tcore_hal_link_user_data(hal, ch);
+
 	/* Set Logical HAL Power State to TRUE */
 	tcore_hal_set_power_state(hal, TRUE);
 	dbg("HAL Power is SET");
@@ -380,7 +853,7 @@ void tcore_cmux_link_core_object_hal(CMUX_Channels channel_id, TcorePlugin *plug
 	return;
 }
 
-MUX* tcore_cmux_new(void)
+static MUX* tcore_cmux_new(enum tcore_cmux_mode mode, int frame_size, int channel_count)
 {
 	MUX *mux = NULL;
 	int i = 0;
@@ -392,18 +865,58 @@ MUX* tcore_cmux_new(void)
 		return NULL;
 	}
 
-	/* Allocating memory for info_field */
-	mux->info_field = (unsigned char *) calloc(MAX_CMUX_BUFFER_SIZE, 1);
-	if (!mux->info_field) {
-		err("Failed to allocate memory for info field");
+	mux->mode = mode;
+	mux->frame_size = frame_size;
+
+	/* FCS tables shared by all MUX objects */
+	tcore_cmux_fcs_init();
+
+	/* Allocating memory for decoder buffer - largest accepted frame */
+	mux->dec_buffer = (unsigned char *) calloc(CMUX_FRAME_HEADER_MAX + frame_size + CMUX_FRAME_TRAILER_MAX, 1);
+	if (!mux->dec_buffer) {
+		err("Failed to allocate memory for decoder buffer");
 		goto ERROR;
 	}
 
+	/* Allocating memory for control message reassembly */
+	mux->ctrl_buf = (unsigned char *) calloc(frame_size, 1);
+	if (!mux->ctrl_buf) {
+		err("Failed to allocate memory for control buffer");
+		goto ERROR;
+	}
+
+	/* Allocating memory for byte stuffing - every octet may be escaped */
+	if (CMUX_MODE_ADVANCED == mode) {
+		mux->tx_buf = (unsigned char *) calloc(2 * frame_size, 1);
+		if (!mux->tx_buf) {
+			err("Failed to allocate memory for transmit buffer");
+			goto ERROR;
+		}
+	}
+
 	/* MUX State initialize to MUX_NOT_INITIALIZED */
 	mux->state = MUX_NOT_INITIALIZED;
 
+	/* Decoder starts with Flag hunt */
+	mux->decode_state = MUX_DECODE_FLAG_HUNT;
+	mux->dec_fcs = 0xFF;
+
+	/* Transmit scheduler round */
+	mux->tx_active = g_queue_new();
+	if (!mux->tx_active) {
+		err("Failed to allocate transmit scheduler");
+		goto ERROR;
+	}
+
 	/* Allocating memory for channel_info */
-	for (i = 0; i < MAX_CMUX_CHANNELS_SUPPORTED; i++) {
+	mux->channel_info = (CHANNEL **) calloc(sizeof(CHANNEL *), channel_count);
+	if (!mux->channel_info) {
+		err("Failed to allocate memory for channel_info");
+		goto ERROR;
+	}
+	mux->channel_count = channel_count;
+
+	for (i = 0; i < channel_count; i++) {
 		mux->channel_info[i] = (CHANNEL *) calloc(sizeof(CHANNEL), 1);
 		/* Check for Memory allocation failure */
 		if (!mux->channel_info[i]) {
@@ -416,241 +929,627 @@ MUX* tcore_cmux_new(void)
 
 ERROR:
 	/* Free allocated memory */
-	if (mux) {
-		if (mux->info_field) {
-			free(mux->info_field);
+	tcore_cmux_free(mux);
+
+	err("Exit");
+	return NULL;
+}
+
+/* Offset of the first Flag (0x7E) or Control Escape (0x7D) octet in 'data',
+  * 'length' if there is none. Run for every octet sent and received in
+  * Advanced mode, hence the vector paths; AT traffic rarely has either.
+  */
+static size_t cmux_scan_control_octet(const unsigned char *data, size_t length)
+{
+	size_t pos = 0;
+
+#if defined(__SSE2__)
+	const __m128i flag = _mm_set1_epi8((char) CMUX_ADVANCED_FLAG);
+	const __m128i escape = _mm_set1_epi8((char) CMUX_ADVANCED_ESCAPE);
+
+	for (; pos + 16 <= length; pos += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (data + pos));
+		int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, flag), _mm_cmpeq_epi8(v, escape)));
+
+		if (mask) {
+			return pos + __builtin_ctz(mask);
 		}
+	}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	const uint8x16_t flag = vdupq_n_u8(CMUX_ADVANCED_FLAG);
+	const uint8x16_t escape = vdupq_n_u8(CMUX_ADVANCED_ESCAPE);
 
-		for (i = 0; i < MAX_CMUX_CHANNELS_SUPPORTED; i++) {
-			if (mux->channel_info[i]) {
-				free(mux->channel_info[i]);
-			}
+	for (; pos + 16 <= length; pos += 16) {
+		uint8x16_t v = vld1q_u8(data + pos);
+		uint64x2_t m = vreinterpretq_u64_u8(vorrq_u8(vceqq_u8(v, flag), vceqq_u8(v, escape)));
+
+		/* Found in this block, the scalar loop locates it */
+		if (vgetq_lane_u64(m, 0) | vgetq_lane_u64(m, 1)) {
+			break;
 		}
+	}
+#endif
 
-		free(mux);
+	for (; pos < length; pos++) {
+		if ((CMUX_ADVANCED_FLAG == data[pos]) || (CMUX_ADVANCED_ESCAPE == data[pos])) {
+			break;
+		}
 	}
 
-	err("Exit");
-	return NULL;
+	return pos;
 }
 
-static unsigned char calc_crc(unsigned char *header, int length)
+/* Advanced mode byte stuffing of 'length' octets into 'out' (2 * length
+  * octets at most), returns the stuffed length.
+  */
+static int cmux_stuff(unsigned char *out, const unsigned char *data, int length)
 {
-	unsigned char FCS = 0xFF; /*Init*/
-	unsigned char crc = 0x00;
-
-	/* 'length' is the number of bytes in the message, 'header' points to message */
-	while (length--) {
-		FCS = crc_table[FCS ^ *header++];
+	int in = 0;
+	int len = 0;
+	size_t run;
+
+	while (in < length) {
+		/* Unescaped run copied as a block */
+		run = cmux_scan_control_octet(data + in, length - in);
+		memcpy(out + len, data + in, run);
+		len += run;
+		in += run;
+
+		if (in < length) {
+			out[len++] = CMUX_ADVANCED_ESCAPE;
+			out[len++] = data[in++] ^ CMUX_ADVANCED_ESCAPE_MASK;
+		}
 	}
 
-	/*Ones complement*/
-	crc = (0xFF - FCS);
-
-	dbg("Exit - crc: 0x%02x", crc)
-	return crc;
+	return len;
 }
 
-static unsigned char* tcore_encode_cmux_frame(unsigned char *data,
-											  int length,
-											  int channel_id,
-											  int frame_type,
-											  unsigned char EA_bit,
-											  unsigned char CR_bit,
-											  unsigned char PF_bit,
-											  int *out_data_len)
+static TReturn tcore_encode_cmux_frame(MUX *mux,
+									   CMUX_FRAME *frame,
+									   unsigned char *data,
+									   int length,
+									   int channel_id,
+									   int frame_type,
+									   unsigned char EA_bit,
+									   unsigned char CR_bit,
+									   unsigned char PF_bit)
 {
+	unsigned char FCS;
+	unsigned char address;
+	unsigned char control;
 	int frame_length = 0;
-	int total_frame_length = 0;
-	int crc_len = 0;
 
 	dbg("Entry");
 
-	/* Flush channel data */
-	tcore_cmux_flush_channel_data();
-
-	if (length > MAX_CMUX_BUFFER_SIZE) {
+	if (length > CMUX_MAX_FRAME_SIZE) {
 		err("Length - %d  exceeds the limit", length);
-		return NULL;
+		return TCORE_RETURN_EMSGSIZE;
 	}
 
-	/* Flag Octet */
-	g_mux_obj_ptr->info_field[frame_length++] = (char) 0xF9;
+	if ((length > 0) && (NULL == data)) {
+		err("No information field data");
+		return TCORE_RETURN_EINVAL;
+	}
+
+	/* DLCI: Data Link Connection Identifier */
+	/* Check if the channel is within range */
+	if (channel_id >= mux->channel_count || channel_id < 0) {
+		err("Channel is out of range[0-%d]", mux->channel_count - 1);
+		return TCORE_RETURN_EINVAL;
+	}
+	dbg("Channel ID: %d", channel_id);
+
+	/* EA: Extension Bit
+	* C/R: Command Response
+	*/
+	address = (EA_bit & 0x01) | ((CR_bit << 1) & 0x02) | ((unsigned char) channel_id << 2);
+
+	/* Control Field
+	  * The content of the control field defines the type of frame.
+	  * ****************************************************************
+	  * Frame Type										0 1 2 3  4   5 6 7
+	  * SABM (Set Asynchronous Balanced Mode)				1 1 1 1 P/F 1 0 0
+	  * UA (Unnumbered Acknowledgement)					1 1 0 0 P/F 1 1 0
+	  * DM (Disconnected Mode)								1 1 1 1 P/F 0 0 0
+	  * DISC (Disconnect)									1 1 0 0 P/F 0 1 0
+	  * UIH (Unnumbered Information with Header check)			1 1 1 1 P/F 1 1 1
+	  *****************************************************************/
+	if (PF_bit) {
+		control = frame_type | 0x10;
+	} else {
+		control = frame_type;
+	}
 
 	/* Mode of Operation */
-	if (0x00 == g_mux_mode) {                /* BASIC */
-		/* EA: Extension Bit
-		* C/R: Command Response
-		*/
-		g_mux_obj_ptr->info_field[frame_length] = g_mux_obj_ptr->info_field[frame_length] | ((EA_bit & 0x01) | ((CR_bit << 1) & 0x02));
-
-		/* DLCI: Data Link Connection Identifier */
-		/* Check if the channel is within range */
-		if (channel_id < MAX_CMUX_CHANNELS_SUPPORTED && channel_id >= 0) {
-			dbg("Channel ID: %d", channel_id);
-			g_mux_obj_ptr->info_field[frame_length] = g_mux_obj_ptr->info_field[frame_length] | ((unsigned char) channel_id << 2);
-		} else {
-			err("Channel is out of range[0-8]");
-			return NULL;
-		}
-		frame_length++;
-
-		/* Control Field
-		  * The content of the control field defines the type of frame.
-		  * ****************************************************************
-		  * Frame Type										0 1 2 3  4   5 6 7
-		  * SABM (Set Asynchronous Balanced Mode)				1 1 1 1 P/F 1 0 0
-		  * UA (Unnumbered Acknowledgement)					1 1 0 0 P/F 1 1 0
-		  * DM (Disconnected Mode)								1 1 1 1 P/F 0 0 0
-		  * DISC (Disconnect)									1 1 0 0 P/F 0 1 0
-		  * UIH (Unnumbered Information with Header check)			1 1 1 1 P/F 1 1 1
-		  *****************************************************************/
-		if (PF_bit) {
-			g_mux_obj_ptr->info_field[frame_length++] = frame_type | 0x10;
-		} else {
-			g_mux_obj_ptr->info_field[frame_length++] = frame_type;
+	if (CMUX_MODE_ADVANCED == mux->mode) {
+		/* 5.2.6 Advanced option frame: no Length Indicator, the frame is
+		  * delimited by Flags and control octets are escaped.
+		  */
+		if (length > mux->frame_size) {
+			err("Length - %d  exceeds N1: %d", length, mux->frame_size);
+			return TCORE_RETURN_EMSGSIZE;
 		}
 
-		/* 5.2.1.5 Length Indicator */
-		if (length < 128) {
-			g_mux_obj_ptr->info_field[frame_length++] = (char) length << 1 | 0x01;
+		frame->header[frame_length++] = CMUX_ADVANCED_FLAG;
+		frame_length += cmux_stuff(frame->header + frame_length, &address, 1);
+		frame_length += cmux_stuff(frame->header + frame_length, &control, 1);
+		frame->header_len = frame_length;
 
-			/* CRC calculatable length */
-			crc_len = 3;
+		/* Information field is referenced unless it needs byte stuffing */
+		if ((length > 0) && ((size_t) length != cmux_scan_control_octet(data, length))) {
+			frame->info = mux->tx_buf;
+			frame->info_len = cmux_stuff(mux->tx_buf, data, length);
 		} else {
-			g_mux_obj_ptr->info_field[frame_length++] = (char) (length << 1);  // Need to change
-			g_mux_obj_ptr->info_field[frame_length++] = (char) (length >> 7);  // Need to change
+			frame->info = data;
+			frame->info_len = length;
+		}
 
-			/* CRC calculatable length */
-			crc_len = 4;
+		/* FCS over the unstuffed Address and Control (and Information for UI) */
+		FCS = tcore_cmux_fcs_fold(0xFF, &address, 1);
+		FCS = tcore_cmux_fcs_fold(FCS, &control, 1);
+		if (CMUX_COMMAND_UI == frame_type) {
+			FCS = tcore_cmux_fcs_fold(FCS, data, length);
 		}
 
-		/* We need to divide the frames into maximum frame length supported by IMC.
-		* If IMC supports length according to 27.010 , we can send max of 16,384 bytes.
-		* Need to discuss with IMC.
-		*/
+		/* Ones complement */
+		FCS = 0xFF - FCS;
+		frame->trailer_len = cmux_stuff(frame->trailer, &FCS, 1);
+		frame->trailer[frame->trailer_len++] = CMUX_ADVANCED_FLAG;
 
-		/* 5.2.1.4 Information Field*/
-		if (length > 0) {
-			memcpy((g_mux_obj_ptr->info_field + frame_length), data, length);
-			frame_length += length;
-		} else {
-			dbg("info field length is zero");
-		}
+		dbg("Exit total_frame_length: %d", frame->header_len + frame->info_len + frame->trailer_len);
+		return TCORE_RETURN_SUCCESS;
+	}
 
-		/*5.2.1.6 Frame Checking Sequence Field (FCS)*/
-		g_mux_obj_ptr->info_field[frame_length++] = calc_crc(g_mux_obj_ptr->info_field + 1, crc_len);
+	/* BASIC */
+	/* Flag Octet */
+	frame->header[frame_length++] = CMUX_BASIC_FLAG;
+	frame->header[frame_length++] = address;
+	frame->header[frame_length++] = control;
 
-		/*Flag Octet*/
-		g_mux_obj_ptr->info_field[frame_length++] = 0xF9;
+	/* 5.2.1.5 Length Indicator */
+	if (length < 128) {
+		frame->header[frame_length++] = (unsigned char) (length << 1) | 0x01;
+	} else {
+		frame->header[frame_length++] = (unsigned char) (length << 1);
+		frame->header[frame_length++] = (unsigned char) (length >> 7);
+	}
+	frame->header_len = frame_length;
+
+	/* 5.2.1.4 Information Field - referenced, not copied */
+	frame->info = data;
+	frame->info_len = length;
 
-		total_frame_length = frame_length;
-	} else if (0x01 == g_mux_mode) {        /* TBD MUX_MODE_ADVANCE */
-		dbg("Advanced MUX mode : TBD");
+	/* 5.2.1.6 Frame Checking Sequence Field (FCS)
+	  * Calculated over Address, Control and Length fields; for UI frames
+	  * the Information field is included as well.
+	  */
+	FCS = tcore_cmux_fcs_fold(0xFF, frame->header + 1, frame_length - 1);
+	if (CMUX_COMMAND_UI == frame_type) {
+		FCS = tcore_cmux_fcs_fold(FCS, data, length);
 	}
 
-	*out_data_len = total_frame_length;
-	dbg("*out_data_len: %d", *out_data_len);
+	/*Ones complement*/
+	frame->trailer[0] = (0xFF - FCS);
+
+	/*Flag Octet*/
+	frame->trailer[1] = CMUX_BASIC_FLAG;
+	frame->trailer_len = 2;
 
-	dbg("Exit total_frame_length: %d", total_frame_length);
-	return g_mux_obj_ptr->info_field;
+	dbg("Exit total_frame_length: %d", frame->header_len + frame->info_len + frame->trailer_len);
+	return TCORE_RETURN_SUCCESS;
 }
 
-static int rcv_crc_check(unsigned char *data, unsigned char len, unsigned char rcv_FCS)
+static void tcore_cmux_flush_channel_data(MUX *mux)
 {
-	unsigned char FCS = 0xFF;
+	dbg("Entry");
+
+	mux->info_field_len = 0x0;
+	mux->info_field = NULL;
+
+	dbg("Exit");
+	return;
+}
+
+static TReturn tcore_cmux_send_control_message(MUX *mux, unsigned char cmd_type, unsigned char *values, int value_len)
+{
+	unsigned char msg[CMUX_CONTROL_MESSAGE_MAX];
 
-	/* 'len' is the number of bytes in the message, 'data' points to message */
-	while (len--) {
-		FCS = crc_table[FCS ^ *data++];
+	if ((value_len < 0) || (value_len > (CMUX_CONTROL_MESSAGE_MAX - 2))) {
+		err("Invalid control message length: %d", value_len);
+		return TCORE_RETURN_EMSGSIZE;
 	}
 
-	/*Ones complement*/
-	FCS = crc_table[FCS ^ rcv_FCS];
+	/* Type, Length, Value 1, Value 2 ... */
+	msg[0] = cmd_type;
+	msg[1] = (unsigned char) (value_len << 1) | 0x01;
+	if (value_len > 0) {
+		memcpy(msg + 2, values, value_len);
+	}
 
-	/* 0xCF is the reversed order of 11110011 */
-	if (0xCF == FCS) {      /* FCS is OK */
-		return 1;
-	} else {            /* FCS is NOT OK */
-		return 0;
+	return tcore_cmux_send_information(mux, CMUX_CHANNEL_0, msg, value_len + 2);
+}
+
+static TReturn tcore_cmux_send_parameter_negotiation(MUX *mux, int channel_id)
+{
+	CHANNEL *ch = mux->channel_info[channel_id];
+	unsigned char values[CMUX_PN_LENGTH];
+
+	dbg("Proposing N1: %d for Channel: %d", mux->frame_size, channel_id);
+
+	/* DLCI */
+	values[0] = channel_id & 0x3F;
+
+	/* I: UIH frames, CL: Convergence layer type 1 or credit based flow control */
+	values[1] = (ch->credits > 0) ? CMUX_PN_CL_CREDIT_COMMAND : 0x00;
+
+	/* P: default priority of the DLCI (7, 15, ... 63) */
+	values[2] = (channel_id | 0x07) & 0x3F;
+
+	/* T1 */
+	values[3] = CMUX_PN_DEFAULT_T1;
+
+	/* N1 - least significant octet first */
+	values[4] = mux->frame_size & 0xFF;
+	values[5] = (mux->frame_size >> 8) & 0xFF;
+
+	/* N2 */
+	values[6] = CMUX_PN_DEFAULT_N2;
+
+	/* k - initial credits granted to the modem with credit based flow control */
+	values[7] = (ch->credits > 0) ? MIN(ch->credits, CMUX_PN_CREDIT_MAX) : CMUX_PN_DEFAULT_K;
+
+	return tcore_cmux_send_control_message(mux, CMUX_COMMAND_PN, values, CMUX_PN_LENGTH);
+}
+
+/* SABM for the DLC, with N1 as negotiated so far */
+static TReturn tcore_cmux_open_channel(MUX *mux, CHANNEL *ch)
+{
+	TReturn ret;
+
+	dbg("Opening Channel %d N1: %d", ch->channel_id, ch->frame_size);
+
+	ch->state = MUX_CHANNEL_SABM_SEND_WAITING_FOR_UA;
+
+	ret = tcore_cmux_send_frame(mux, NULL, 0, ch->channel_id, CMUX_COMMAND_SABM, 0x01, 0x01, 0x01);
+	if (TCORE_RETURN_SUCCESS != ret) {
+		err("Failed to send SABM");
 	}
+
+	return ret;
 }
 
-static void tcore_cmux_flush_channel_data(void)
+/* Control Channel is up (UA on DLCI 0): negotiate N1 of every DLC, its SABM
+  * follows the PN response. Without negotiation the DLCs are opened directly.
+  */
+static void tcore_cmux_open_channels(MUX *mux)
 {
-	dbg("Entry");
+	CHANNEL *ch;
+	int channel;
 
-	g_mux_obj_ptr->info_field_len = 0x0;
-	memset(g_mux_obj_ptr->info_field, 0x0, MAX_CMUX_BUFFER_SIZE);
+	for (channel = 1; channel < mux->channel_count; channel++) {
+		ch = mux->channel_info[channel];
+		if (MUX_CHANNEL_CLOSED != ch->state) {
+			continue;
+		}
+
+		if (mux->negotiate_n1) {
+			ch->state = MUX_CHANNEL_PN_SEND_WAITING_FOR_RESPONSE;
+			if (TCORE_RETURN_SUCCESS == tcore_cmux_send_parameter_negotiation(mux, channel)) {
+				continue;
+			}
+
+			err("Failed to send PN, opening Channel %d with default N1", channel);
+		}
+
+		tcore_cmux_open_channel(mux, ch);
+	}
+}
+
+static void tcore_cmux_process_parameter_negotiation(MUX *mux, gboolean is_command, unsigned char *values, int value_len)
+{
+	CHANNEL *ch = NULL;
+	int channel_id;
+	int frame_size;
+
+	if (value_len < CMUX_PN_LENGTH) {
+		err("Invalid PN length: %d", value_len);
+		return;
+	}
+
+	channel_id = values[0] & 0x3F;
+	if (channel_id >= mux->channel_count) {
+		err("PN for unsupported Channel: %d", channel_id);
+		return;
+	}
+	ch = mux->channel_info[channel_id];
+
+	/* Never exceed what our buffers were sized for */
+	frame_size = values[4] | (values[5] << 8);
+	if (frame_size <= 0) {
+		frame_size = tcore_cmux_default_frame_size(mux);
+	} else if (frame_size > mux->frame_size) {
+		frame_size = mux->frame_size;
+	}
+	ch->frame_size = frame_size;
+	dbg("Channel: %d N1: %d", channel_id, ch->frame_size);
+
+	/* Credit based flow control: proposed in a command, accepted in a response,
+	  * only if configured for the Channel.
+	  */
+	ch->credit_fc = FALSE;
+	if ((ch->credits > 0) && ((values[1] & 0xF0)
+			== (is_command ? CMUX_PN_CL_CREDIT_COMMAND : CMUX_PN_CL_CREDIT_RESPONSE))) {
+		ch->credit_fc = TRUE;
+		ch->tx_credits = values[7] & CMUX_PN_CREDIT_MAX;
+		ch->rx_credits = MIN(ch->credits, CMUX_PN_CREDIT_MAX);
+		dbg("Channel: %d credit based flow control - credits: %d", channel_id, ch->tx_credits);
+	}
+
+	if (is_command) {
+		unsigned char resp[CMUX_PN_LENGTH];
+
+		/* Peer initiated negotiation - accept with our N1 limit */
+		memcpy(resp, values, CMUX_PN_LENGTH);
+		resp[4] = ch->frame_size & 0xFF;
+		resp[5] = (ch->frame_size >> 8) & 0xFF;
+
+		if (ch->credit_fc) {
+			resp[1] = CMUX_PN_CL_CREDIT_RESPONSE | (values[1] & 0x0F);
+			resp[7] = ch->rx_credits;
+		} else {
+			resp[1] = values[1] & 0x0F;
+		}
+
+		tcore_cmux_send_control_message(mux, CMUX_COMMAND_PN & ~CMUX_CONTROL_CR_BIT, resp, CMUX_PN_LENGTH);
+	} else if (MUX_CHANNEL_PN_SEND_WAITING_FOR_RESPONSE == ch->state) {
+		/* N1 agreed, establish the DLC */
+		tcore_cmux_open_channel(mux, ch);
+	}
+
+	tcore_cmux_channel_resume(mux, ch);
 
-	dbg("Exit");
 	return;
 }
 
-static void tcore_cmux_control_channel_handle(void)
+static void tcore_cmux_process_modem_status(MUX *mux, gboolean is_command, unsigned char *values, int value_len)
+{
+	CHANNEL *ch = NULL;
+	int channel_id;
+
+	/* DLCI (address octet) and V.24 signals, optional Break signals */
+	if (value_len < 2) {
+		err("Invalid MSC length: %d", value_len);
+		return;
+	}
+
+	channel_id = (values[0] >> 2) & 0x3F;
+	dbg("Channel: %d V.24 signals: 0x%02x", channel_id, values[1]);
+
+	if (!is_command) {
+		return;
+	}
+
+	if ((channel_id > 0) && (channel_id < mux->channel_count)) {
+		ch = mux->channel_info[channel_id];
+
+		/* Modem cannot accept frames on this DLC */
+		ch->msc_stopped = ((values[1] & CMUX_MSC_FC) || !(values[1] & CMUX_MSC_RTR));
+	}
+
+	/* Acknowledge with the same values */
+	tcore_cmux_send_control_message(mux, CMUX_COMMAND_MSC & ~CMUX_CONTROL_CR_BIT, values, value_len);
+
+	if (ch) {
+		tcore_cmux_channel_resume(mux, ch);
+	}
+}
+
+static void tcore_cmux_process_aggregate_flow_control(MUX *mux, unsigned char cmd_type)
+{
+	int channel;
+
+	/* FCoff: no frames on any DLC but the Control Channel, FCon: resume */
+	mux->fc_off = ((cmd_type | CMUX_CONTROL_CR_BIT) == CMUX_COMMAND_FCOFF);
+	dbg("Aggregate flow control - off: %d", mux->fc_off);
+
+	tcore_cmux_send_control_message(mux, cmd_type & ~CMUX_CONTROL_CR_BIT, NULL, 0);
+
+	for (channel = 1; channel < mux->channel_count; channel++) {
+		tcore_cmux_channel_resume(mux, mux->channel_info[channel]);
+	}
+}
+
+static gboolean tcore_cmux_process_control_message(MUX *mux, unsigned char cmd_type, unsigned char *values, int value_len)
+{
+	gboolean is_command;
+
+	is_command = ((cmd_type & CMUX_CONTROL_CR_BIT) == CMUX_CONTROL_CR_BIT);
+	dbg("Control message - type: 0x%02x is_command: %d length: %d", cmd_type, is_command, value_len);
+
+	switch (cmd_type | CMUX_CONTROL_CR_BIT) {
+	case CMUX_COMMAND_MSC:
+	{
+		dbg("Modem Status Command");
+		tcore_cmux_process_modem_status(mux, is_command, values, value_len);
+		break;
+	}
+
+	case CMUX_COMMAND_FCON:
+	case CMUX_COMMAND_FCOFF:
+	{
+		if (is_command) {
+			tcore_cmux_process_aggregate_flow_control(mux, cmd_type);
+		}
+		break;
+	}
+
+	case CMUX_COMMAND_CLD:
+	{
+		if (is_command) {
+			dbg("Multiplexer close down");
+
+			/* MUX object is freed, stop processing */
+			tcore_cmux_close_hal(mux->phy_hal);
+			return FALSE;
+		}
+		break;
+	}
+
+	case CMUX_COMMAND_PN:
+	{
+		dbg("DLC parameter negotiation");
+		tcore_cmux_process_parameter_negotiation(mux, is_command, values, value_len);
+		break;
+	}
+
+	case CMUX_COMMAND_NSC:
+	{
+		dbg("Non Supported Command response - type: 0x%02x", (value_len > 0) ? values[0] : 0);
+
+		/* No PN support, the DLCs keep the default N1 */
+		if ((value_len > 0) && ((values[0] | CMUX_CONTROL_CR_BIT) == CMUX_COMMAND_PN)) {
+			int channel;
+
+			for (channel = 1; channel < mux->channel_count; channel++) {
+				if (MUX_CHANNEL_PN_SEND_WAITING_FOR_RESPONSE == mux->channel_info[channel]->state) {
+					tcore_cmux_open_channel(mux, mux->channel_info[channel]);
+				}
+			}
+		}
+		break;
+	}
+
+	default:
+	{
+		/* We will be supporting these commands in Phase 2 */
+		dbg("Default");
+		break;
+	}
+	}
+
+	return TRUE;
+}
+
+static void tcore_cmux_control_channel_handle(MUX *mux)
 {
+	unsigned char *msg;
 	unsigned char cmd_type;
-	int msg_len = 0;
-	unsigned char *msg_start_ptr = NULL;
+	int value_len;
+	int header_len;
+	int msg_len;
 
 	dbg("Entry");
 
+	if (mux->info_field_len <= 0) {
+		err("Frame length is less than ZERO");
+		return;
+	}
+
+	/* Control messages may span several frames, reassemble them */
+	if ((mux->ctrl_buf_len + mux->info_field_len) > mux->frame_size) {
+		err("Control message too long, discard %d bytes", mux->ctrl_buf_len);
+		mux->ctrl_buf_len = 0;
+	}
+	memcpy(mux->ctrl_buf + mux->ctrl_buf_len, mux->info_field, mux->info_field_len);
+	mux->ctrl_buf_len += mux->info_field_len;
+
 	/* 5.4.6.1 Message format
 	  * All messages sent between the multiplexers conform to the following type, length, value format:
 	  * Type Length Value 1 Value2  \85
 	  */
-	if (g_mux_obj_ptr->info_field_len > 0) {
-		msg_start_ptr = g_mux_obj_ptr->info_field;
-		cmd_type = g_mux_obj_ptr->info_field[0];
+	while (mux->ctrl_buf_len > 0) {
+		msg = mux->ctrl_buf;
+		cmd_type = msg[0];
 
 		/* The EA bit is an extension bit. The EA bit is set to 1 in the last octet of the sequence;
-		  * in other octets EA is set to 0.
-		  *
-		  * Search for the last octet
+		  * in other octets EA is set to 0. Only single octet types are defined.
 		  */
-		while ((*msg_start_ptr++ & 0x01)) { // TBD
-			msg_len++;
+		if (!(cmd_type & 0x01)) {
+			err("Unsupported multi-octet type, discard control data");
+			mux->ctrl_buf_len = 0;
+			break;
 		}
 
-		if ((cmd_type & 0x02) == 0x02) { // This is a command Request
-			switch (cmd_type) {
-			case CMUX_COMMAND_MSC:
-			{
-				dbg("Modem Status Command");
-				break;
-			}
+		/* Length - 1 or 2 octets */
+		if (mux->ctrl_buf_len < 2) {
+			break;
+		}
 
-			case CMUX_COMMAND_CLD:
-			{
-				dbg("Multiplexer close down");
-				tcore_cmux_close();
+		if (msg[1] & 0x01) {
+			value_len = msg[1] >> 1;
+			header_len = 2;
+		} else {
+			if (mux->ctrl_buf_len < 3) {
 				break;
 			}
+			value_len = (msg[1] >> 1) | (msg[2] << 7);
+			header_len = 3;
+		}
+
+		msg_len = header_len + value_len;
+		if (msg_len > mux->frame_size) {
+			err("Control message too long: %d", msg_len);
+			mux->ctrl_buf_len = 0;
+			break;
+		}
+
+		if (msg_len > mux->ctrl_buf_len) {
+			/* Incomplete - wait for the following frame(s) */
+			dbg("Partial control message: %d/%d", mux->ctrl_buf_len, msg_len);
+			break;
+		}
+
+		if (FALSE == tcore_cmux_process_control_message(mux, cmd_type, msg + header_len, value_len)) {
+			/* MUX closed */
+			return;
+		}
+
+		/* Next message */
+		mux->ctrl_buf_len -= msg_len;
+		memmove(mux->ctrl_buf, mux->ctrl_buf + msg_len, mux->ctrl_buf_len);
+	}
+
+	dbg("Exit");
+	return;
+}
+
+static void tcore_cmux_process_information(MUX *mux, CHANNEL *ch)
+{
+	unsigned char *data = mux->info_field;
+	int length = mux->info_field_len;
+
+	if (ch->credit_fc) {
+		/* P/F set: first octet holds the credits granted by the modem */
+		if (ch->poll_final_bit && (length > 0)) {
+			ch->tx_credits += data[0];
+			data++;
+			length--;
+
+			tcore_cmux_channel_resume(mux, ch);
+		}
+
+		/* Credit only frame */
+		if (0 == length) {
+			return;
+		}
 
-			default:
-			{
-				/* We will be supporting these commands in Phase 2 */
-				dbg("Default");
-				break;
-			}
-			}
+		if (ch->rx_credits > 0) {
+			ch->rx_credits--;
+		} else {
+			err("Channel: %d data received without credit", ch->channel_id);
 		}
-	} else {
-		err("Frame length is less than ZERO");
+
+		tcore_cmux_channel_grant_credits(mux, ch);
 	}
 
-	dbg("Exit");
-	return;
+	// put in the logical HAL queue, this goes to the Cobject
+	tcore_cmux_recv_mux_data(mux, ch, data, length);
 }
 
-static void tcore_cmux_process_channel_data(CHANNEL *channel_info_ptr)
+static void tcore_cmux_process_channel_data(MUX *mux, CHANNEL *channel_info_ptr)
 {
 	int frame_type;
 	int channel_id;
-	int len;
-	unsigned char *send_data = NULL;
-	static int count = 0;
-	int ret;
 
 	dbg("Entry");
 
@@ -667,11 +1566,10 @@ static void tcore_cmux_process_channel_data(CHANNEL *channel_info_ptr)
 		dbg("Received UI/UIH Frame");
 		if (0 == channel_id) {              /* This is control info */
 			dbg("Control information");
-			tcore_cmux_control_channel_handle();
+			tcore_cmux_control_channel_handle(mux);
 		} else {
 			dbg("Normal information");
-			// put in the logical HAL queue, this goes to the Cobject
-			tcore_cmux_recv_mux_data(channel_info_ptr);
+			tcore_cmux_process_information(mux, channel_info_ptr);
 		}
 		break;
 	}
@@ -683,14 +1581,19 @@ static void tcore_cmux_process_channel_data(CHANNEL *channel_info_ptr)
 		if (MUX_CHANNEL_SABM_SEND_WAITING_FOR_UA == channel_info_ptr->state) {
 			channel_info_ptr->state = MUX_CHANNEL_ESTABLISHED;
 
-			count++;
-			dbg("Count: %d", count);
-			if (MAX_CMUX_CHANNELS_SUPPORTED == count) {
+			/* Control Channel up, the DLCs follow */
+			if (0 == channel_id) {
+				tcore_cmux_open_channels(mux);
+			}
+
+			mux->established_count++;
+			dbg("Count: %d", mux->established_count);
+			if (mux->channel_count == mux->established_count) {
 				/* Indicate to CoreObject */
 				CoreObject *co = NULL;
 
 				/* 'modem' Core Object */
-				co = g_mux_obj_ptr->modem_co;
+				co = mux->modem_co;
 				if (NULL == co) {
 					err("'modem' Core object is not present");
 					return;
@@ -702,14 +1605,14 @@ static void tcore_cmux_process_channel_data(CHANNEL *channel_info_ptr)
 				dbg("Emitted Core object callback");
 
 				/* Reset 'count' */
-				count = 0;
+				mux->established_count = 0;
 			}
 		} else if (MUX_CHANNEL_DISC_SEND_WAITING_FOR_UA == channel_info_ptr->state) {
 			channel_info_ptr->state = MUX_CHANNEL_CLOSED;
 
 			if (0 == channel_id) {
-				g_mux_obj_ptr->state = MUX_CLOSED;
-				tcore_cmux_close();
+				mux->state = MUX_CLOSED;
+				tcore_cmux_close_hal(mux->phy_hal);
 			}
 		} else {
 			err("Received UA in wrong state!!!");
@@ -725,13 +1628,14 @@ static void tcore_cmux_process_channel_data(CHANNEL *channel_info_ptr)
 		  */
 		dbg("Received DM Frame");
 		if ((MUX_CHANNEL_ESTABLISHED == channel_info_ptr->state)
-			|| (MUX_CHANNEL_SABM_SEND_WAITING_FOR_UA == channel_info_ptr->state)) {
+			|| (MUX_CHANNEL_SABM_SEND_WAITING_FOR_UA == channel_info_ptr->state)
+			|| (MUX_CHANNEL_PN_SEND_WAITING_FOR_RESPONSE == channel_info_ptr->state)) {
 			/* Channel State set to Close */
 			channel_info_ptr->state = MUX_CHANNEL_CLOSED;
 		}
 
 		/* Flush the Channel data */
-		tcore_cmux_flush_channel_data();
+		tcore_cmux_flush_channel_data(mux);
 
 		break;
 	}
@@ -745,38 +1649,29 @@ static void tcore_cmux_process_channel_data(CHANNEL *channel_info_ptr)
 			  */
 
 			/* Flush the Channel data */
-			tcore_cmux_flush_channel_data();
+			tcore_cmux_flush_channel_data(mux);
 		} else {
 			if (MUX_CHANNEL_CLOSED == channel_info_ptr->state) {
 				/* If a CMUX_COMMAND_DISC command is received while in disconnected mode
 				  * a CMUX_COMMAND_DM response should be sent
 				  */
 
-				/* Encoding frame */
-				send_data = tcore_encode_cmux_frame(NULL, 0, channel_id, CMUX_COMMAND_DM, 1, 1, 1, &len);
+				tcore_cmux_send_frame(mux, NULL, 0, channel_id, CMUX_COMMAND_DM, 1, 1, 1);
 			} else {         // send Unnumbered Acknowledgement
-				send_data = tcore_encode_cmux_frame(NULL, 0, channel_id, CMUX_COMMAND_UA, 1, 1, 1, &len);
-			}
-
-			if (0 == len) {
-				err("Failed to encode");
-				return;
+				tcore_cmux_send_frame(mux, NULL, 0, channel_id, CMUX_COMMAND_UA, 1, 1, 1);
 			}
 
-			/* Send CMUX data */
-			ret = tcore_cmux_send_data(len, send_data);
-
 			/* Flush the Channel data */
-			tcore_cmux_flush_channel_data();
+			tcore_cmux_flush_channel_data(mux);
 
 			/* 5.3.4 Disconnect (DISC) command: CMUX_COMMAND_DISC command sent at DLCI 0
 			  * have the same meaning as the Multiplexer Close Down command
 			  */
 			if (0 == channel_id) {
-				g_mux_obj_ptr->state = MUX_CLOSED;
+				mux->state = MUX_CLOSED;
 
 				/* Close CMUX */
-				tcore_cmux_close();
+				tcore_cmux_close_hal(mux->phy_hal);
 			}
 		}
 		break;
@@ -791,16 +1686,10 @@ static void tcore_cmux_process_channel_data(CHANNEL *channel_info_ptr)
 			  */
 
 			/* Flush the Channel data */
-			tcore_cmux_flush_channel_data();
+			tcore_cmux_flush_channel_data(mux);
 		} else {
-			/* Encoding frame */
-			send_data = tcore_encode_cmux_frame(NULL, 0, channel_id, CMUX_COMMAND_UA, 1, 1, 1, &len);
-			if (0 != len) {
-				/* Send CMUX data */
-				ret = tcore_cmux_send_data(len, send_data);
-			} else {
-				err("Failed to encode");
-			}
+			/* Send Unnumbered Acknowledgement */
+			tcore_cmux_send_frame(mux, NULL, 0, channel_id, CMUX_COMMAND_UA, 1, 1, 1);
 
 			if (channel_info_ptr->state != MUX_CHANNEL_ESTABLISHED) {
 				/* Channel State set to Established */
@@ -815,216 +1704,509 @@ static void tcore_cmux_process_channel_data(CHANNEL *channel_info_ptr)
 	return;
 }
 
-static void tcore_cmux_process_rcv_frame(unsigned char *data, int len)
+static void tcore_cmux_process_frame(MUX *mux, unsigned char address, unsigned char control,
+										unsigned char *info, int info_len)
 {
-	unsigned char *frame_process_ptr = data;
-	unsigned char *buf_start_ptr = data;
-
 	CHANNEL *ch = NULL;
 	unsigned char channel_id;
-	int header_length;
 
-	dbg("Entry");
+	/* Get the Channel ID */
+	channel_id = (address >> 2) & 0x3F;
+	if (channel_id >= mux->channel_count) {
+		err("Incorrect channel... Drop the packet !!");
+		return;
+	}
+
+	ch = mux->channel_info[channel_id];
+
+	ch->channel_id = channel_id;
+
+	// get the EA bit
+	ch->ext_bit = address & 0x01;
 
-	tcore_cmux_flush_channel_data();
+	// get the CR bit
+	ch->cr_bit = (address >> 1) & 0x01;
 
-	/* Get the Channel ID : 1st byte will be flag (F9)..Flag checking is already done.*/
-	channel_id = (*++frame_process_ptr >> 2) & 0x3F;
+	// get the Frame Type
+	ch->frame_type = control;
 
-	if (channel_id < MAX_CMUX_CHANNELS_SUPPORTED) {          // max channel is 8
-		ch = g_mux_obj_ptr->channel_info[channel_id];
+	// get the poll/Final bit
+	ch->poll_final_bit = (ch->frame_type & 0x10) >> 4;
 
-		ch->channel_id = channel_id;
+	/* Received information field, handed on without copy */
+	mux->info_field = info;
+	mux->info_field_len = info_len;
+	dbg("info_field_len: %d", mux->info_field_len);
 
-		// get the EA bit
-		ch->ext_bit = *frame_process_ptr & 0x01;
+	dbg("Calling tcore_cmux_process_channel_data");
+	tcore_cmux_process_channel_data(mux, ch);
+}
 
-		// get the CR bit
-		ch->cr_bit = (*frame_process_ptr++ >> 1) & 0x01;
+/* Checks and dispatches an unescaped Advanced mode frame:
+  * Address, Control, Information, FCS
+  */
+static void tcore_cmux_process_advanced_frame(MUX *mux, unsigned char *frame, int len)
+{
+	unsigned char FCS;
+	int header_len;
 
-		// get the Frame Type
-		ch->frame_type = *frame_process_ptr++;
+	if (len < 3) {
+		err("Frame too short: %d, drop", len);
+		return;
+	}
 
-		// get the poll/Final bit
-		ch->poll_final_bit = (ch->frame_type & 0x10) >> 4;
+	/* FCS over Address and Control, over the whole frame for UI */
+	header_len = 2;
+	if (CMUX_COMMAND_UI == (frame[1] & 0xEF)) {
+		header_len = len - 1;
+	}
 
-		// get the length . TBD
-		if (*frame_process_ptr & 0x01) {                        // if, len < 127
-			g_mux_obj_ptr->info_field_len = *frame_process_ptr++ >> 1;
-			header_length = 3;
-		} else {
-			g_mux_obj_ptr->info_field_len = *(frame_process_ptr + 1) << 7;
-			g_mux_obj_ptr->info_field_len = g_mux_obj_ptr->info_field_len | ((*frame_process_ptr++ & 0xFE) >> 1);
-			header_length = 4;
-			frame_process_ptr++;
+	FCS = tcore_cmux_fcs_fold(0xFF, frame, header_len);
+	if (0xCF != crc_table[FCS ^ frame[len - 1]]) {
+		err("FCS check FAILED.. Drop the packet !!");
+		return;
+	}
+
+	tcore_cmux_flush_channel_data(mux);
+	tcore_cmux_process_frame(mux, frame[0], frame[1], frame + 2, len - 3);
+}
+
+/* Advanced mode decoder: a frame within one read and without escaped
+  * octets is processed in place, others are unescaped into the decoder
+  * buffer and processed once the closing Flag arrives.
+  */
+static int tcore_cmux_rcv_advanced(TcoreHal *hal, MUX *mux, unsigned char *data, size_t length)
+{
+	/* Address, Control, N1 octets of Information and FCS */
+	const size_t max_len = (size_t) mux->frame_size + 3;
+	size_t pos = 0;
+	size_t run;
+	unsigned char octet;
+	unsigned char *frame;
+	size_t frame_len;
+
+	while (pos < length) {
+		if (MUX_DECODE_FLAG_HUNT == mux->decode_state) {
+			while ((pos < length) && (CMUX_ADVANCED_FLAG != data[pos])) {
+				pos++;
+			}
+			if (pos == length) {
+				break;
+			}
+
+			pos++;
+			mux->full_frame_len = 0;
+			mux->decode_state = MUX_DECODE_ADVANCED_FRAME;
+			continue;
 		}
-		dbg("info_field_len: %d", g_mux_obj_ptr->info_field_len);
 
-		/* Copy received information field */
-		memcpy(g_mux_obj_ptr->info_field, frame_process_ptr, g_mux_obj_ptr->info_field_len);
+		if (MUX_DECODE_ADVANCED_ESCAPE == mux->decode_state) {
+			octet = data[pos++];
+			if (CMUX_ADVANCED_FLAG == octet) {
+				/* Aborted frame, the Flag opens the next one */
+				err("Escaped Flag, drop the frame");
+				mux->full_frame_len = 0;
+				mux->decode_state = MUX_DECODE_ADVANCED_FRAME;
+				continue;
+			}
+
+			if (mux->full_frame_len >= max_len) {
+				err("Frame exceeds N1: %d, drop", mux->frame_size);
+				mux->decode_state = MUX_DECODE_FLAG_HUNT;
+				continue;
+			}
 
-		frame_process_ptr = frame_process_ptr + g_mux_obj_ptr->info_field_len;
+			mux->dec_buffer[mux->full_frame_len++] = octet ^ CMUX_ADVANCED_ESCAPE_MASK;
+			mux->decode_state = MUX_DECODE_ADVANCED_FRAME;
+			continue;
+		}
 
-		// CRC check of the header
-		if (rcv_crc_check(buf_start_ptr + 1, header_length, *frame_process_ptr)) {
-			dbg("Calling tcore_cmux_process_channel_data");
-			tcore_cmux_process_channel_data(ch);
+		/* MUX_DECODE_ADVANCED_FRAME - run up to the next control octet */
+		run = cmux_scan_control_octet(data + pos, length - pos);
+		if ((0 == mux->full_frame_len) && (pos + run < length) && (CMUX_ADVANCED_FLAG == data[pos + run])) {
+			/* Whole frame in this read, nothing escaped */
+			frame = data + pos;
+			frame_len = run;
+			pos += run + 1;
 		} else {
-			err("CRC check of the header FAILED.. Drop the packet !!");
+			if (mux->full_frame_len + run > max_len) {
+				err("Frame exceeds N1: %d, drop", mux->frame_size);
+				pos += run;
+				mux->decode_state = MUX_DECODE_FLAG_HUNT;
+				continue;
+			}
+
+			memcpy(mux->dec_buffer + mux->full_frame_len, data + pos, run);
+			mux->full_frame_len += run;
+			pos += run;
+			if (pos == length) {
+				break;
+			}
+
+			if (CMUX_ADVANCED_ESCAPE == data[pos++]) {
+				mux->decode_state = MUX_DECODE_ADVANCED_ESCAPE;
+				continue;
+			}
+
+			/* Closing Flag */
+			frame = mux->dec_buffer;
+			frame_len = mux->full_frame_len;
+			mux->full_frame_len = 0;
+		}
+
+		/* Consecutive Flags (empty frames) are skipped, the closing
+		  * Flag also opens the next frame.
+		  */
+		if (0 == frame_len) {
+			continue;
+		}
+
+		if (frame_len > max_len) {
+			err("Frame exceeds N1: %d, drop", mux->frame_size);
+			continue;
+		}
+
+		tcore_cmux_process_advanced_frame(mux, frame, frame_len);
+
+		/* MUX may have been closed while processing the frame */
+		if (tcore_hal_ref_mux(hal) != mux) {
+			dbg("MUX closed, stop decoding");
+			return 1;
 		}
-	} else {
-		err("Incorrect channel... Drop the packet !!");
 	}
 
-	dbg("Exit");
-	return;
+	return 1;
 }
 
-int tcore_cmux_rcv_from_hal(unsigned char *data, size_t length)
+int tcore_cmux_rcv_hal(TcoreHal *hal, unsigned char *data, size_t length)
 {
-	#define TCORE_MUX_DECODE_FLAG_HUNT 0
-	#define TCORE_MUX_DECODE_ADDR_HUNT 1
-	#define TCORE_MUX_DECODE_CONTROL_HUNT 2
-	#define TCORE_MUX_DECODE_LENGTH1_HUNT 3
-	#define TCORE_MUX_DECODE_LENGTH2_HUNT 4
-	#define TCORE_MUX_DECODE_DATA_HUNT 5
-	#define TCORE_MUX_DECODE_FCS_HUNT 6
-
-	static int decode_state = TCORE_MUX_DECODE_FLAG_HUNT;
-	static unsigned char dec_fcs = 0xff;
-	static unsigned char mux_buffer[4096];
-	static unsigned char* dec_data = mux_buffer;
-	static unsigned short dec_length = 0;
-	static size_t full_frame_len = 0;
-
+	MUX *mux = NULL;
 	size_t pos = -1;
+	size_t frame_start = CMUX_NO_FRAME_START;
 	int cp_len = 0;
+	unsigned char FCS;
+
+	/* Read being decoded while staged octets are rescanned in dec_buffer */
+	unsigned char *read_data = data;
+	size_t read_length = length;
+	size_t read_pos = 0;
+	gboolean rescan = FALSE;
+
+	/* MUX object owned by the Physical HAL */
+	mux = tcore_hal_ref_mux(hal);
+	if (!mux) {
+		err("No MUX object linked to HAL");
+		return 0;
+	}
+
+	if (CMUX_MODE_ADVANCED == mux->mode) {
+		return tcore_cmux_rcv_advanced(hal, mux, data, length);
+	}
 
 DECODE_STATE_CHANGE:
 	if (++pos >= length)
 	{
-		return 1;
+		goto END_OF_DATA;
 	}
 
-	switch(decode_state)
+	switch(mux->decode_state)
 	{
-	case TCORE_MUX_DECODE_FLAG_HUNT: full_frame_len = 0; dec_length = 0; dec_fcs = 0xff; dec_data = mux_buffer; goto FLAG_HUNT; break;
-	case TCORE_MUX_DECODE_ADDR_HUNT: goto ADDR_HUNT; break;
-	case TCORE_MUX_DECODE_CONTROL_HUNT: goto CONTROL_HUNT; break;
-	case TCORE_MUX_DECODE_LENGTH1_HUNT: goto LENGTH1_HUNT; break;
-	case TCORE_MUX_DECODE_LENGTH2_HUNT: goto LENGTH2_HUNT; break;
-	case TCORE_MUX_DECODE_DATA_HUNT: goto DATA_HUNT; break;
-	case TCORE_MUX_DECODE_FCS_HUNT: goto FCS_HUNT; break;
+	case MUX_DECODE_FLAG_HUNT: mux->dec_length = 0; mux->dec_fcs = 0xff; mux->dec_info = NULL; mux->dec_info_len = 0; mux->dec_staged = 0; mux->dec_header_len = 0; goto FLAG_HUNT; break;
+	case MUX_DECODE_ADDR_HUNT: goto ADDR_HUNT; break;
+	case MUX_DECODE_CONTROL_HUNT: goto CONTROL_HUNT; break;
+	case MUX_DECODE_LENGTH1_HUNT: goto LENGTH1_HUNT; break;
+	case MUX_DECODE_LENGTH2_HUNT: goto LENGTH2_HUNT; break;
+	case MUX_DECODE_DATA_HUNT: goto DATA_HUNT; break;
+	case MUX_DECODE_FCS_HUNT: goto FCS_HUNT; break;
+	default: mux->decode_state = MUX_DECODE_FLAG_HUNT; goto DECODE_STATE_CHANGE; break;
 	}
 
 FLAG_HUNT:
-	while (data[pos] != 0xF9) {
+	while (data[pos] != CMUX_BASIC_FLAG) {
 		if (++pos >= length) {
-			return 1;
+			goto END_OF_DATA;
 		}
 	}
-	decode_state = TCORE_MUX_DECODE_ADDR_HUNT;
+	mux->decode_state = MUX_DECODE_ADDR_HUNT;
 	goto DECODE_STATE_CHANGE;
 
 ADDR_HUNT:
-	while (data[pos] == 0xF9) {
+	while (data[pos] == CMUX_BASIC_FLAG) {
 		if (++pos >= length) {
-			return 1;
+			goto END_OF_DATA;
 		}
 	}
 
-	dec_fcs = crc_table[dec_fcs^data[pos]];
-	decode_state = TCORE_MUX_DECODE_CONTROL_HUNT;
-	*dec_data++ = 0xF9;
-	*dec_data++ = data[pos];
-	full_frame_len += 2;
+	/* Address of the frame, where hunting resumes if the frame is dropped */
+	frame_start = pos;
+
+	if (!(data[pos] & 0x01))
+	{
+		err("Invalid Address: 0x%02x, drop", data[pos]);
+		goto RESYNC;
+	}
+
+	mux->dec_fcs = crc_table[mux->dec_fcs^data[pos]];
+	mux->decode_state = MUX_DECODE_CONTROL_HUNT;
+	mux->dec_address = data[pos];
+	mux->dec_header[0] = data[pos];
+	mux->dec_header_len = 1;
 	goto DECODE_STATE_CHANGE;
 
 CONTROL_HUNT:
-	dec_fcs = crc_table[dec_fcs^data[pos]];
-	decode_state = TCORE_MUX_DECODE_LENGTH1_HUNT;
-	*dec_data++ = data[pos];
-	full_frame_len++;
+	/* Frame types of 27.010, anything else is a corrupted header */
+	switch (data[pos] & 0xEF)
+	{
+	case CMUX_COMMAND_SABM:
+	case CMUX_COMMAND_UA:
+	case CMUX_COMMAND_DM:
+	case CMUX_COMMAND_DISC:
+	case CMUX_COMMAND_UIH:
+	case CMUX_COMMAND_UI:
+		break;
+
+	default:
+		err("Invalid Control: 0x%02x, drop", data[pos]);
+		goto RESYNC;
+	}
+
+	mux->dec_fcs = crc_table[mux->dec_fcs^data[pos]];
+	mux->decode_state = MUX_DECODE_LENGTH1_HUNT;
+	mux->dec_control = data[pos];
+	mux->dec_header[mux->dec_header_len++] = data[pos];
 	goto DECODE_STATE_CHANGE;
 
 LENGTH1_HUNT:
-	dec_length = data[pos] >> 1;
-	dec_fcs = crc_table[dec_fcs^data[pos]];
+	mux->dec_length = data[pos] >> 1;
+	mux->dec_fcs = crc_table[mux->dec_fcs^data[pos]];
 	if (data[pos] & 0x1)
 	{ // ea
-		if (dec_length > 0)
+		if (mux->dec_length > mux->frame_size)
+		{
+			err("Frame length: %d exceeds N1: %d, drop", mux->dec_length, mux->frame_size);
+			goto RESYNC;
+		}
+		else if (mux->dec_length > 0)
 		{
-			decode_state = TCORE_MUX_DECODE_DATA_HUNT;
+			mux->decode_state = MUX_DECODE_DATA_HUNT;
 		}
 		else
 		{
-			decode_state = TCORE_MUX_DECODE_FCS_HUNT;
+			mux->decode_state = MUX_DECODE_FCS_HUNT;
 		}
 	}
 	else
 	{
-		decode_state = TCORE_MUX_DECODE_LENGTH2_HUNT;
+		mux->decode_state = MUX_DECODE_LENGTH2_HUNT;
 	}
 
-	*dec_data++ = data[pos];
-	full_frame_len++;
+	/* Rejected octets are not kept, hunting resumes on them */
+	mux->dec_header[mux->dec_header_len++] = data[pos];
+	mux->dec_info_len = mux->dec_length;
 	goto DECODE_STATE_CHANGE;
 
 LENGTH2_HUNT:
-	dec_length |= ((unsigned short)data[pos] << 7);
-	dec_fcs = crc_table[dec_fcs^data[pos]];
-	decode_state = TCORE_MUX_DECODE_DATA_HUNT;
-	*dec_data++ = data[pos];
-	full_frame_len++;
+	mux->dec_length |= ((unsigned short)data[pos] << 7);
+	mux->dec_fcs = crc_table[mux->dec_fcs^data[pos]];
+	if (mux->dec_length > mux->frame_size)
+	{
+		err("Frame length: %d exceeds N1: %d, drop", mux->dec_length, mux->frame_size);
+		goto RESYNC;
+	}
+	mux->dec_header[mux->dec_header_len++] = data[pos];
+	mux->decode_state = (mux->dec_length > 0) ? MUX_DECODE_DATA_HUNT : MUX_DECODE_FCS_HUNT;
+	mux->dec_info_len = mux->dec_length;
 	goto DECODE_STATE_CHANGE;
 
 DATA_HUNT:
-	if (dec_length < (length - pos)) // frame data fully available in the buffer
+	if ((0 == mux->dec_staged) && (mux->dec_length < (length - pos))) // frame data and FCS fully available in the buffer
+	{
+		/* Information field is used in place */
+		mux->dec_info = data + pos;
+		pos += (mux->dec_length - 1);
+		mux->dec_length = 0;
+		mux->decode_state = MUX_DECODE_FCS_HUNT;
+		goto DECODE_STATE_CHANGE;
+	}
+
+	/* Frame spans reads, stage the Information field */
+	if (mux->dec_length < (length - pos))
 	{
-		cp_len = dec_length;
-		decode_state = TCORE_MUX_DECODE_FCS_HUNT;
+		cp_len = mux->dec_length;
+		mux->decode_state = MUX_DECODE_FCS_HUNT;
 	}
 	else	// frame data partially available in the buffer
 	{
 		cp_len = (length - pos);
-		decode_state = TCORE_MUX_DECODE_DATA_HUNT;
+		mux->decode_state = MUX_DECODE_DATA_HUNT;
 	}
 
-	memcpy(dec_data, data + pos, cp_len);
-	dec_data += cp_len;
+	/* Source is dec_buffer itself during a rescan, never behind the target */
+	memmove(mux->dec_buffer + mux->dec_staged, data + pos, cp_len);
+	mux->dec_staged += cp_len;
+	mux->dec_info = mux->dec_buffer;
 	pos += (cp_len - 1);
-	dec_length -= cp_len;
-	full_frame_len += cp_len;
+	mux->dec_length -= cp_len;
 
 	goto DECODE_STATE_CHANGE;
 
 FCS_HUNT:
-	//if (crc_table[dec_fcs^data[pos]] == 0xCF) // valid FCS, store frame.
+	// enter flag hunt mode
+	mux->decode_state = MUX_DECODE_FLAG_HUNT;
+
+	/* Header FCS is folded while decoding, UI frames cover the Information field too */
+	FCS = mux->dec_fcs;
+	if (CMUX_COMMAND_UI == (mux->dec_control & 0xEF)) {
+		FCS = tcore_cmux_fcs_fold(FCS, mux->dec_info, mux->dec_info_len);
+	}
+
+	if (crc_table[FCS^data[pos]] != 0xCF)
 	{
-		*dec_data++ = data[pos];
-		*dec_data++ = 0xF9;
-		full_frame_len += 2;
-		tcore_cmux_process_rcv_frame(mux_buffer, full_frame_len);
+		err("FCS check FAILED.. Drop the packet !!");
+		goto RESYNC;
 	}
 
-	// enter flag hunt mode
-	decode_state = TCORE_MUX_DECODE_FLAG_HUNT;
+	frame_start = CMUX_NO_FRAME_START;
+
+	tcore_cmux_flush_channel_data(mux);
+	tcore_cmux_process_frame(mux, mux->dec_address, mux->dec_control, mux->dec_info, mux->dec_info_len);
+
+	/* MUX may have been closed while processing the frame */
+	if (tcore_hal_ref_mux(hal) != mux) {
+		dbg("MUX closed, stop decoding");
+		return 1;
+	}
+
+	goto DECODE_STATE_CHANGE;
+
+RESYNC:
+	/* A corrupted header or length may have swallowed the start of the
+	  * following frames: hunt again right after the dropped frame's Address
+	  * when it is still in this buffer. Otherwise the header octets after
+	  * the Address and the Information octets staged from earlier reads are
+	  * decoded again in place, then the rest of this buffer from where the
+	  * frame's octets in it begin.
+	  */
+	mux->decode_state = MUX_DECODE_FLAG_HUNT;
+	if (CMUX_NO_FRAME_START != frame_start)
+	{
+		pos = frame_start;
+		frame_start = CMUX_NO_FRAME_START;
+	}
+	else if ((mux->dec_header_len > 1) || (mux->dec_staged > 0))
+	{
+		size_t header_len = (mux->dec_header_len > 1) ? (size_t) (mux->dec_header_len - 1) : 0;
+		size_t staged_len = header_len + mux->dec_staged;
+
+		/* An Information field used in place is decoded again from this buffer */
+		if ((0 == mux->dec_staged) && (NULL != mux->dec_info))
+		{
+			pos = mux->dec_info - data;
+		}
+
+		if (rescan)
+		{
+			/* Dropped during a rescan: the rest of the rescan follows */
+			memmove(mux->dec_buffer + staged_len, mux->dec_buffer + pos, length - pos);
+			length = staged_len + (length - pos);
+		}
+		else
+		{
+			read_pos = pos;
+			rescan = TRUE;
+			data = mux->dec_buffer;
+			length = staged_len;
+		}
+
+		/* Header octets go in front of the staged Information field */
+		memmove(mux->dec_buffer + header_len, mux->dec_buffer, mux->dec_staged);
+		memcpy(mux->dec_buffer, mux->dec_header + 1, header_len);
+
+		mux->dec_staged = 0;
+		mux->dec_header_len = 0;
+		pos = -1;
+	}
+	else
+	{
+		/* Only the Address came from an earlier read, hunt on from this octet */
+		pos--;
+	}
+
+	goto DECODE_STATE_CHANGE;
+
+END_OF_DATA:
+	if (!rescan)
+	{
+		return 1;
+	}
+
+	/* Rescan done, the current octet of the read belongs to whatever it left open */
+	rescan = FALSE;
+	data = read_data;
+	length = read_length;
+	pos = read_pos - 1;
+	frame_start = CMUX_NO_FRAME_START;
+
 	goto DECODE_STATE_CHANGE;
 }
 
-static void tcore_cmux_channel_init(CMUX_Channels channel_id)
+static TReturn tcore_cmux_channel_init(MUX *mux, CMUX_Channels channel_id, const struct tcore_cmux_channel_object *channel_map)
 {
 	CHANNEL *ch = NULL;
+	int index;
 
-	ch = g_mux_obj_ptr->channel_info[channel_id];
+	ch = mux->channel_info[channel_id];
 	memset(ch, 0x0, sizeof(CHANNEL));
 
+	ch->mux = mux;
 	ch->channel_id = channel_id;
-	ch->state = MUX_CHANNEL_SABM_SEND_WAITING_FOR_UA;
+	ch->state = MUX_CHANNEL_CLOSED;
+
+	/* Until negotiated (PN), the default N1 applies to the DLCs. N1 of the
+	  * Control Channel, or of all Channels without negotiation, is the one
+	  * agreed when CMUX was started.
+	  */
+	if (mux->negotiate_n1 && (CMUX_CHANNEL_0 != channel_id)) {
+		ch->frame_size = tcore_cmux_default_frame_size(mux);
+	} else {
+		ch->frame_size = mux->frame_size;
+	}
 
 	ch->co = NULL;
 	ch->hal = NULL;
 
+	ch->tx_queue = g_queue_new();
+	if (!ch->tx_queue) {
+		err("Failed to allocate transmit queue");
+		return TCORE_RETURN_ENOMEM;
+	}
+
+	/* Credit based flow control, one octet per grant */
+	ch->credits = MIN(channel_map->credits, CMUX_CREDIT_MAX);
+
+	/* Scheduling class, the Control Channel always has priority */
+	ch->priority = channel_map->priority || (CMUX_CHANNEL_0 == channel_id);
+	ch->weight = (channel_map->weight > 0) ? channel_map->weight : CMUX_DEFAULT_WEIGHT;
+
+	/* Copy the Channel map entry, plugin's table need not outlive the MUX */
+	ch->channel_id_name = strdup(channel_map->channel_id_name);
+	if (!ch->channel_id_name) {
+		err("Failed to allocate memory for Channel name");
+		return TCORE_RETURN_ENOMEM;
+	}
+
+	for (index = 0; index < MAX_CMUX_CORE_OBJECTS; index++) {
+		if (NULL == channel_map->core_object_name[index]) {
+			break;
+		}
+
+		ch->core_object_name[index] = strdup(channel_map->core_object_name[index]);
+		if (!ch->core_object_name[index]) {
+			err("Failed to allocate memory for Core Object name");
+			return TCORE_RETURN_ENOMEM;
+		}
+	}
+
 	/* TODO - Check if required */
 	ch->frame_type = CMUX_COMMAND_SABM;
 	ch->ext_bit = 0x01;
@@ -1033,18 +2215,16 @@ static void tcore_cmux_channel_init(CMUX_Channels channel_id)
 
 	dbg("Channel ID %d initialized", channel_id);
 
-	return;
+	return TCORE_RETURN_SUCCESS;
 }
 
-static void tcore_cmux_close_channel(int channel_id)
+static void tcore_cmux_close_channel(MUX *mux, int channel_id)
 {
 	CHANNEL *ch = NULL;
-	unsigned char *send_data = NULL;
-	int ret, len = 0;
 
 	dbg("Entry");
 
-	ch = g_mux_obj_ptr->channel_info[channel_id];
+	ch = mux->channel_info[channel_id];
 
 	if (ch->state != MUX_CHANNEL_CLOSED) {
 		ch->frame_type = CMUX_COMMAND_DISC;
@@ -1053,14 +2233,7 @@ static void tcore_cmux_close_channel(int channel_id)
 		ch->state = MUX_CHANNEL_DISC_SEND_WAITING_FOR_UA;
 
 		/* Send DSC command */
-		/* Encoding frame */
-		send_data = tcore_encode_cmux_frame(NULL, 0, channel_id, CMUX_COMMAND_DISC, 0x01, 0x01, 0x01, &len);
-		if (0 != len) {
-			/* Send CMUX data */
-			ret = tcore_cmux_send_data(len, send_data);
-		} else {
-			err("Failed to encode");
-		}
+		tcore_cmux_send_frame(mux, NULL, 0, channel_id, CMUX_COMMAND_DISC, 0x01, 0x01, 0x01);
 	} else {
 		/* Channel is already closed */
 		err("Channel is already closed");
@@ -1070,30 +2243,71 @@ static void tcore_cmux_close_channel(int channel_id)
 	return;
 }
 
-static void tcore_cmux_free(void)
+static void tcore_cmux_free(MUX *mux)
 {
 	int channel;
 
 	dbg("Entry");
 
-	if (g_mux_obj_ptr) {
-		/* Free Information Field */
-		if (g_mux_obj_ptr->info_field) {
-			free(g_mux_obj_ptr->info_field);
-			g_mux_obj_ptr->info_field = NULL;
+	if (mux) {
+		/* Free decoder buffer */
+		if (mux->dec_buffer) {
+			free(mux->dec_buffer);
+			mux->dec_buffer = NULL;
+		}
+
+		/* Free control message buffer */
+		if (mux->ctrl_buf) {
+			free(mux->ctrl_buf);
+			mux->ctrl_buf = NULL;
+		}
+
+		/* Free transmit buffer */
+		if (mux->tx_buf) {
+			free(mux->tx_buf);
+			mux->tx_buf = NULL;
+		}
+
+		/* Stop the transmit scheduler */
+		if (mux->tx_source) {
+			tcore_plugin_remove_source(mux->plugin, mux->tx_source);
+			mux->tx_source = 0;
 		}
 
-		for (channel = 0; channel < MAX_CMUX_CHANNELS_SUPPORTED; channel++) {
+		if (mux->tx_active) {
+			g_queue_free(mux->tx_active);
+			mux->tx_active = NULL;
+		}
+
+		for (channel = 0; (NULL != mux->channel_info) && (channel < mux->channel_count); channel++) {
 			/* Free Channel Information */
-			if (g_mux_obj_ptr->channel_info[channel]) {
-				free(g_mux_obj_ptr->channel_info[channel]);
-				g_mux_obj_ptr->channel_info[channel] = NULL;
+			if (mux->channel_info[channel]) {
+				CHANNEL *ch = mux->channel_info[channel];
+				int index;
+
+				for (index = 0; index < MAX_CMUX_CORE_OBJECTS; index++) {
+					free(ch->core_object_name[index]);
+				}
+				free(ch->channel_id_name);
+				g_slist_free(ch->co);
+
+				/* Data still held by flow control is discarded */
+				if (ch->tx_queue) {
+					while (!g_queue_is_empty(ch->tx_queue)) {
+						free(g_queue_pop_head(ch->tx_queue));
+					}
+					g_queue_free(ch->tx_queue);
+				}
+				free(ch);
+				mux->channel_info[channel] = NULL;
 			}
 		}
 
+		free(mux->channel_info);
+		mux->channel_info = NULL;
+
 		/* Free MUX Object */
-		free(g_mux_obj_ptr);
-		g_mux_obj_ptr = NULL;
+		free(mux);
 	} else {
 		err("MUX Object doesn't exist");
 	}
@@ -1102,11 +2316,10 @@ static void tcore_cmux_free(void)
 	return;
 }
 
-TReturn tcore_cmux_init(TcorePlugin *plugin, TcoreHal *hal)
+TReturn tcore_cmux_init_hal(TcorePlugin *plugin, TcoreHal *hal, enum tcore_cmux_mode mode, unsigned int frame_size,
+						const struct tcore_cmux_channel_object *channel_map, unsigned int channel_count)
 {
-	unsigned char *data = NULL;
-	int data_len = 0;
-
+	MUX *mux = NULL;
 	int index;
 
 	TReturn ret = TCORE_RETURN_SUCCESS;
@@ -1115,68 +2328,104 @@ TReturn tcore_cmux_init(TcorePlugin *plugin, TcoreHal *hal)
 
 	dbg("Physical HAL: %x", hal);
 
+	if (!hal) {
+		err("Physical HAL is NULL");
+		return TCORE_RETURN_EINVAL;
+	}
+
+	/* Only one MUX object per Physical HAL */
+	if (tcore_hal_ref_mux(hal)) {
+		err("MUX already initialized on Physical HAL");
+		return TCORE_RETURN_EALREADY;
+	}
+
+	if ((CMUX_MODE_BASIC != mode) && (CMUX_MODE_ADVANCED != mode)) {
+		err("Unsupported CMUX mode: %d", mode);
+		return TCORE_RETURN_EINVAL;
+	}
+
+	if (frame_size > CMUX_MAX_FRAME_SIZE) {
+		err("Frame size: %d exceeds the limit", frame_size);
+		return TCORE_RETURN_EINVAL;
+	}
+
+	/* Channel map of the modem plugin, otherwise the default one */
+	if (NULL == channel_map) {
+		channel_map = cmux_channel_core_object;
+		channel_count = sizeof(cmux_channel_core_object) / sizeof(cmux_channel_core_object[0]);
+	}
+
+	if ((channel_count < 1) || (channel_count > MAX_CMUX_CHANNELS_SUPPORTED)) {
+		err("Invalid number of Channels: %d", channel_count);
+		return TCORE_RETURN_EINVAL;
+	}
+
+	for (index = 0; index < (int) channel_count; index++) {
+		if (NULL == channel_map[index].channel_id_name) {
+			err("No name for Channel: %d", index);
+			return TCORE_RETURN_EINVAL;
+		}
+	}
+
 	/* Creat new CMUX Object */
-	g_mux_obj_ptr = tcore_cmux_new();
-	if (NULL == g_mux_obj_ptr) {
+	mux = tcore_cmux_new(mode, (0 == frame_size) ? CMUX_DEFAULT_FRAME_SIZE : (int) frame_size, channel_count);
+	if (NULL == mux) {
 		err("Failed to create MUX object");
-
-		ret = TCORE_RETURN_FAILURE;
-		goto ERROR;
+		return TCORE_RETURN_ENOMEM;
 	}
 
 	/* Save Plugin */
-	g_mux_obj_ptr->plugin = plugin;
+	mux->plugin = plugin;
 
 	/* Save Physical HAL */
-	g_mux_obj_ptr->phy_hal = hal;
+	mux->phy_hal = hal;
+
+	/* N1 given by the modem plugin is negotiated (PN) per DLC */
+	mux->negotiate_n1 = (0 != frame_size);
 
-	/* Setting Receive callback function for data received from Physical HAL */
-	g_mux_obj_ptr->cb_func = tcore_cmux_recv_mux_data;
+	/* Link MUX object to Physical HAL */
+	tcore_hal_link_mux(hal, mux);
 
 	/* After MUX setup, AT parse functionality of PHY HAL should be disabled,
 	  * here we change the mode of PHYSICAL HAL to Transparent.
 	  */
-	tcore_hal_set_mode(g_mux_obj_ptr->phy_hal, TCORE_HAL_MODE_TRANSPARENT);
+	tcore_hal_set_mode(mux->phy_hal, TCORE_HAL_MODE_TRANSPARENT);
 	dbg("Physical HAL mode changed to Transparent");
 
 	/* Initialize all the Channels */
 	/* Open all Channels */
-	for (index = 0; index < MAX_CMUX_CHANNELS_SUPPORTED; index++) {
+	for (index = 0; index < mux->channel_count; index++) {
 		dbg("Initialize the Channel %d", index);
-		tcore_cmux_channel_init((CMUX_Channels) index);
-
-		dbg("Opening Channel %d", index);
-		/* Encode CMUX Frame */
-		data = tcore_encode_cmux_frame(NULL, 0, index, CMUX_COMMAND_SABM, 0x01, 0x01, 0x01, &data_len);
-		if (0 == data_len) {
-			err("Failed to encode");
-
-			ret = TCORE_RETURN_FAILURE;
+		ret = tcore_cmux_channel_init(mux, (CMUX_Channels) index, &channel_map[index]);
+		if (TCORE_RETURN_SUCCESS != ret) {
 			goto ERROR;
 		}
-		dbg("data_len: %d data: %s", data_len, data);
-
-		/* Send CMUX data */
-		tcore_cmux_send_data(data_len, data);
-		dbg("CMUX Control Request sent to CP");
 
 		/* Set Core object and HAL */
-		tcore_cmux_link_core_object_hal((CMUX_Channels) index, plugin);
+		tcore_cmux_link_core_object_hal(mux, (CMUX_Channels) index, plugin);
+	}
+
+	/* Establish the Control Channel, the DLCs are opened on its UA */
+	ret = tcore_cmux_open_channel(mux, mux->channel_info[CMUX_CHANNEL_0]);
+	if (TCORE_RETURN_SUCCESS != ret) {
+		goto ERROR;
 	}
+	dbg("CMUX Control Request sent to CP");
 
 	dbg("Exit");
 	return ret;
 
 ERROR:
-	/* Free the allocated CMUX memory */
-	tcore_cmux_free();
+	/* Revert Physical HAL and free the allocated CMUX memory */
+	tcore_cmux_close_hal(hal);
 
 	err("Exit");
 	return ret;
 }
 
-void tcore_cmux_close(void)
+void tcore_cmux_close_hal(TcoreHal *hal)
 {
+	MUX *mux = NULL;
 	int channel = 0;
 	int index = 0;
 	CoreObject *co = NULL;
@@ -1184,19 +2433,32 @@ void tcore_cmux_close(void)
 
 	dbg("Entry");
 
-	for (channel = 0; channel < MAX_CMUX_CHANNELS_SUPPORTED; channel++) {
+	mux = tcore_hal_ref_mux(hal);
+	if (!mux) {
+		err("No MUX object linked to HAL");
+		return;
+	}
+
+	/* Unlink first, so a close down received while closing is ignored */
+	tcore_hal_link_mux(hal, NULL);
+
+	if (hal == legacy_phy_hal) {
+		legacy_phy_hal = NULL;
+	}
+
+	for (channel = 0; channel < mux->channel_count; channel++) {
 		dbg("Channel ID: %d", channel);
 		index = 0;
 
 		/* Close Channel - Send DSC command */
-		tcore_cmux_close_channel(channel);
+		tcore_cmux_close_channel(mux, channel);
 
 		/* Revert Physical HAL as HAL of each Core Object associated to this Channel */
-		while (NULL != cmux_channel_core_object[channel].core_object_name[index]) {
+		while ((index < MAX_CMUX_CORE_OBJECTS) && (NULL != mux->channel_info[channel]->core_object_name[index])) {
 			co = NULL;
 
 			/* Core Objects list */
-			co_list = g_mux_obj_ptr->channel_info[channel]->co;
+			co_list = mux->channel_info[channel]->co;
 			dbg("Core Objects list : %p", co_list);
 
 			/* Core Object list may contain multiple Core Objects.
@@ -1205,7 +2467,7 @@ void tcore_cmux_close(void)
 			  */
 			while (NULL != co_list) {
 				if (NULL != co_list->data) {
-					if (!strcmp((const char *) cmux_channel_core_object[channel].core_object_name[index], (const char *) tcore_object_ref_name((CoreObject *) co_list->data))) {
+					if (!strcmp((const char *) mux->channel_info[channel]->core_object_name[index], (const char *) tcore_object_ref_name((CoreObject *) co_list->data))) {
 						co = (CoreObject *) co_list->data;
 						dbg("Core Object found ");
 						break;
@@ -1218,7 +2480,7 @@ void tcore_cmux_close(void)
 
 			/* Set the previous Physical HAL as HAL for Core Object */
 			if (NULL != co) {
-				tcore_object_set_hal(co, g_mux_obj_ptr->phy_hal);
+				tcore_object_set_hal(co, mux->phy_hal);
 			} else {
 				/* Proceed to next Channel */
 				err("No more Core Objects present in this Channel");
@@ -1230,16 +2492,99 @@ void tcore_cmux_close(void)
 		}
 
 		/* Free Logical HAL for Channel */
-		tcore_hal_free(g_mux_obj_ptr->channel_info[channel]->hal);
-		g_mux_obj_ptr->channel_info[channel]->hal = NULL;
+		tcore_hal_free(mux->channel_info[channel]->hal);
+		mux->channel_info[channel]->hal = NULL;
 	}
 
 	/* Change the mode of PHYSICAL HAL to Custom */
-	tcore_hal_set_mode(g_mux_obj_ptr->phy_hal, TCORE_HAL_MODE_AT);
+	tcore_hal_set_mode(mux->phy_hal, TCORE_HAL_MODE_AT);
 
 	/* Free all the allocated memory */
-	tcore_cmux_free();
+	tcore_cmux_free(mux);
 
 	dbg("Exit");
 	return;
 }
+
+TReturn tcore_cmux_init(TcorePlugin *plugin, TcoreHal *hal)
+{
+	TReturn ret;
+
+	if (legacy_phy_hal) {
+		err("CMUX already running on another HAL, use tcore_cmux_init_hal()");
+		return TCORE_RETURN_EALREADY;
+	}
+
+	ret = tcore_cmux_init_hal(plugin, hal, CMUX_MODE_BASIC, 0, NULL, 0);
+	if (TCORE_RETURN_SUCCESS == ret) {
+		legacy_phy_hal = hal;
+	}
+
+	return ret;
+}
+
+void tcore_cmux_close(void)
+{
+	if (!legacy_phy_hal) {
+		err("No MUX object");
+		return;
+	}
+
+	tcore_cmux_close_hal(legacy_phy_hal);
+}
+
+int tcore_cmux_rcv_from_hal(unsigned char *data, size_t length)
+{
+	if (!legacy_phy_hal) {
+		err("No MUX object");
+		return 0;
+	}
+
+	return tcore_cmux_rcv_hal(legacy_phy_hal, data, length);
+}
+
+TReturn tcore_cmux_get_channel_stats(TcoreHal *hal, unsigned int channel_id, struct tcore_cmux_channel_stats *stats)
+{
+	MUX *mux = NULL;
+	CHANNEL *ch = NULL;
+
+	if (!hal || !stats) {
+		return TCORE_RETURN_EINVAL;
+	}
+
+	mux = tcore_hal_ref_mux(hal);
+	if (!mux) {
+		err("No MUX object linked to HAL");
+		return TCORE_RETURN_EINVAL;
+	}
+
+	if (channel_id >= (unsigned int) mux->channel_count) {
+		err("Channel is out of range[0-%d]", mux->channel_count - 1);
+		return TCORE_RETURN_EINVAL;
+	}
+	ch = mux->channel_info[channel_id];
+
+	memset(stats, 0x0, sizeof(struct tcore_cmux_channel_stats));
+
+	stats->flow_controlled = ch->flow_controlled;
+	stats->flow_control_count = ch->fc_count;
+	stats->flow_control_time = ch->fc_time;
+	if (ch->flow_controlled) {
+		stats->flow_control_time += g_get_monotonic_time() - ch->fc_start;
+	}
+
+	stats->queued_bytes = ch->queued_bytes;
+	stats->credit_flow_control = ch->credit_fc;
+	stats->tx_credits = ch->tx_credits;
+	stats->rx_credits = ch->rx_credits;
+
+	stats->tx_bytes = ch->tx_bytes;
+	stats->tx_frames = ch->tx_frames;
+	stats->tx_writes = ch->tx_writes;
+	if (ch->tx_writes > 0) {
+		stats->latency_avg = ch->latency_total / ch->tx_writes;
+	}
+	stats->latency_max = ch->latency_max;
+
+	return TCORE_RETURN_SUCCESS;
+}
@@ -0,0 +1,46 @@
+/*
+ * libtcore
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ * Contact: Arijit Sen <arijit.sen@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MUX_FCS_H__
+#define __MUX_FCS_H__
+
+/* 27.010 FCS kernels, internal to libtcore (not installed).
+ * Built from their own translation unit so the self-test can link them
+ * without the rest of the multiplexer.
+ */
+
+/* Reversed, 8-bit, poly=0x07; folding a whole frame with its FCS
+ * gives 0xCF
+ */
+extern const unsigned char crc_table[256];
+
+/* Builds and checks the slicing-by-8 tables, once per process and safe
+ * to call from any thread. Returns FALSE if the check failed, octet at a
+ * time folding is used then.
+ */
+gboolean tcore_cmux_fcs_init(void);
+
+/* Folds 'length' octets into FCS; tcore_cmux_fcs_init() must have run */
+unsigned char tcore_cmux_fcs_fold(unsigned char FCS, const unsigned char *data, int length);
+
+/* The two kernels behind tcore_cmux_fcs_fold(), for the self-test */
+unsigned char tcore_cmux_fcs_fold_octets(unsigned char FCS, const unsigned char *data, int length);
+unsigned char tcore_cmux_fcs_fold_slice8(unsigned char FCS, const unsigned char *data, int length);
+
+#endif
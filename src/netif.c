@@ -0,0 +1,677 @@
+/*
+ * libtcore
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Ja-young Gu <jygu@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include <glib.h>
+
+#include "tcore.h"
+#include "util.h"
+#include "netif.h"
+
+/* a full context (link, 2 addresses, 2 routes) needs about 300 bytes */
+#define NETIF_BATCH_SIZE 1024
+#define NETIF_RECV_SIZE 8192
+
+/*
+ * Metric of PDN default routes. 0.0.0.0/0 and ::/0 are keyed on
+ * dst/tos/priority, not on the interface, so a route of its own metric
+ * keeps the default route of wlan/eth (metric 0 to a few hundred) in
+ * place and preferred.
+ */
+#define NETIF_ROUTE_METRIC 1024
+
+#ifndef IFA_F_NODAD
+#define IFA_F_NODAD 0x02
+#endif
+
+union netif_buffer {
+	struct nlmsghdr hdr;
+	unsigned char raw[NETIF_BATCH_SIZE];
+};
+
+struct netif_batch_type {
+	union netif_buffer buf;
+	unsigned int len;
+	unsigned int count;
+	guint32 seq;
+	struct nlmsghdr *last;
+	unsigned int exist_ok; /* bit per message, EEXIST is not an error */
+};
+
+struct netif_request_type {
+	guint32 seq_first;
+	unsigned int count;
+	unsigned int acks;
+	unsigned int exist_ok;
+	TReturn result;
+	char name[IFNAMSIZ];
+
+	TcoreNetifCallback cb;
+	void *user_data;
+};
+
+struct netif_socket_type {
+	int fd;
+	guint32 seq;
+	guint watch;
+	GSList *requests;
+};
+
+struct netif_address_type {
+	gboolean valid;
+	int family;
+	unsigned int prefix_len;
+	unsigned char addr[16];
+	unsigned int addr_len;
+	gboolean has_gateway;
+	unsigned char gateway[16];
+};
+
+static struct netif_socket_type *netif_socket = NULL;
+
+static struct nlmsghdr *_netif_batch_msg(struct netif_batch_type *b,
+		unsigned short type, unsigned short flags,
+		const void *payload, unsigned int payload_len)
+{
+	struct nlmsghdr *nlh;
+	unsigned int len = NLMSG_LENGTH(payload_len);
+
+	if (b->last)
+		b->len += NLMSG_ALIGN(b->last->nlmsg_len);
+
+	if (b->len + NLMSG_ALIGN(len) > sizeof(b->buf))
+		return NULL;
+
+	nlh = (void *) (b->buf.raw + b->len);
+	memset(nlh, 0, NLMSG_ALIGN(len));
+	nlh->nlmsg_len = len;
+	nlh->nlmsg_type = type;
+	nlh->nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK | flags;
+	nlh->nlmsg_seq = b->seq + b->count;
+	memcpy(NLMSG_DATA(nlh), payload, payload_len);
+
+	b->last = nlh;
+	b->count++;
+
+	return nlh;
+}
+
+static gboolean _netif_batch_attr(struct netif_batch_type *b,
+		unsigned short type, const void *data, unsigned int data_len)
+{
+	struct nlmsghdr *nlh = b->last;
+	struct rtattr *rta;
+	unsigned int offset;
+
+	offset = b->len + NLMSG_ALIGN(nlh->nlmsg_len);
+	if (offset + RTA_SPACE(data_len) > sizeof(b->buf))
+		return FALSE;
+
+	rta = (void *) (b->buf.raw + offset);
+	rta->rta_type = type;
+	rta->rta_len = RTA_LENGTH(data_len);
+	memcpy(RTA_DATA(rta), data, data_len);
+
+	nlh->nlmsg_len = NLMSG_ALIGN(nlh->nlmsg_len) + RTA_ALIGN(rta->rta_len);
+
+	return TRUE;
+}
+
+static gboolean _netif_batch_link(struct netif_batch_type *b,
+		unsigned int ifindex, gboolean up, unsigned int mtu)
+{
+	struct ifinfomsg ifi;
+
+	memset(&ifi, 0, sizeof(struct ifinfomsg));
+	ifi.ifi_family = AF_UNSPEC;
+	ifi.ifi_index = ifindex;
+	ifi.ifi_flags = up ? IFF_UP : 0;
+	ifi.ifi_change = IFF_UP;
+
+	if (!_netif_batch_msg(b, RTM_NEWLINK, 0, &ifi, sizeof(struct ifinfomsg)))
+		return FALSE;
+
+	if (mtu && !_netif_batch_attr(b, IFLA_MTU, &mtu, sizeof(mtu)))
+		return FALSE;
+
+	return TRUE;
+}
+
+static gboolean _netif_batch_addr(struct netif_batch_type *b,
+		unsigned short cmd, unsigned int ifindex,
+		const struct netif_address_type *addr)
+{
+	struct ifaddrmsg ifa;
+	unsigned short flags = 0;
+
+	memset(&ifa, 0, sizeof(struct ifaddrmsg));
+	ifa.ifa_family = addr->family;
+	ifa.ifa_prefixlen = addr->prefix_len;
+	ifa.ifa_scope = RT_SCOPE_UNIVERSE;
+	ifa.ifa_index = ifindex;
+
+	/* no point in duplicate address detection on a PDP link */
+	if (addr->family == AF_INET6)
+		ifa.ifa_flags = IFA_F_NODAD;
+
+	if (cmd == RTM_NEWADDR)
+		flags = NLM_F_CREATE | NLM_F_REPLACE;
+
+	if (!_netif_batch_msg(b, cmd, flags, &ifa, sizeof(struct ifaddrmsg)))
+		return FALSE;
+
+	if (!_netif_batch_attr(b, IFA_LOCAL, addr->addr, addr->addr_len))
+		return FALSE;
+
+	return _netif_batch_attr(b, IFA_ADDRESS, addr->addr, addr->addr_len);
+}
+
+static gboolean _netif_batch_default_route(struct netif_batch_type *b,
+		unsigned int ifindex, const struct netif_address_type *addr)
+{
+	struct rtmsg rtm;
+	guint32 metric = NETIF_ROUTE_METRIC;
+
+	memset(&rtm, 0, sizeof(struct rtmsg));
+	rtm.rtm_family = addr->family;
+	rtm.rtm_table = RT_TABLE_MAIN;
+	rtm.rtm_protocol = RTPROT_BOOT;
+	rtm.rtm_type = RTN_UNICAST;
+
+	/*
+	 * An IPv4 gateway is rarely inside the /32 handed out by the network,
+	 * IPv6 gateways are link-local and need no help.
+	 */
+	if (addr->has_gateway) {
+		rtm.rtm_scope = RT_SCOPE_UNIVERSE;
+		if (addr->family == AF_INET)
+			rtm.rtm_flags = RTNH_F_ONLINK;
+	}
+	else {
+		rtm.rtm_scope = RT_SCOPE_LINK;
+	}
+
+	/* an identical route left over from an earlier setup is fine */
+	if (!_netif_batch_msg(b, RTM_NEWROUTE, NLM_F_CREATE | NLM_F_EXCL,
+			&rtm, sizeof(struct rtmsg)))
+		return FALSE;
+
+	b->exist_ok |= 1 << (b->count - 1);
+
+	if (!_netif_batch_attr(b, RTA_OIF, &ifindex, sizeof(ifindex)))
+		return FALSE;
+
+	if (!_netif_batch_attr(b, RTA_PRIORITY, &metric, sizeof(metric)))
+		return FALSE;
+
+	if (addr->has_gateway)
+		return _netif_batch_attr(b, RTA_GATEWAY, addr->gateway, addr->addr_len);
+
+	return TRUE;
+}
+
+static unsigned int _netif_netmask_to_prefix(struct in_addr mask)
+{
+	guint32 m = ntohl(mask.s_addr);
+	unsigned int prefix = 0;
+
+	while (m & 0x80000000) {
+		prefix++;
+		m <<= 1;
+	}
+
+	/* non-contiguous masks are rejected */
+	if (m)
+		return 33;
+
+	return prefix;
+}
+
+static TReturn _netif_parse_address(struct netif_address_type *out, int family,
+		const char *addr, const char *gateway, unsigned int prefix_len)
+{
+	memset(out, 0, sizeof(struct netif_address_type));
+
+	if (!addr)
+		return TCORE_RETURN_SUCCESS;
+
+	out->family = family;
+	out->addr_len = (family == AF_INET) ? 4 : 16;
+	out->prefix_len = prefix_len;
+
+	if (inet_pton(family, addr, out->addr) != 1) {
+		dbg("invalid address [%s]", addr);
+		return TCORE_RETURN_EINVAL;
+	}
+
+	if (gateway) {
+		if (inet_pton(family, gateway, out->gateway) != 1) {
+			dbg("invalid gateway [%s]", gateway);
+			return TCORE_RETURN_EINVAL;
+		}
+		out->has_gateway = TRUE;
+	}
+
+	out->valid = TRUE;
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+static void _netif_request_finish(struct netif_request_type *req)
+{
+	dbg("[%s] configured (%d)", req->name, req->result);
+
+	if (req->cb)
+		req->cb(req->name, req->result, req->user_data);
+
+	free(req);
+}
+
+/* The list is detached first: callbacks may start or close requests */
+static void _netif_fail_requests(GSList *requests)
+{
+	GSList *l;
+
+	for (l = requests; l; l = l->next) {
+		struct netif_request_type *req = l->data;
+
+		req->result = TCORE_RETURN_FAILURE;
+		_netif_request_finish(req);
+	}
+
+	g_slist_free(requests);
+}
+
+static void _netif_handle_ack(guint32 seq, int error)
+{
+	struct netif_request_type *req;
+	GSList *l;
+
+	for (l = netif_socket->requests; l; l = l->next) {
+		req = l->data;
+
+		if ((guint32) (seq - req->seq_first) >= req->count)
+			continue;
+
+		if (error == -EEXIST && (req->exist_ok & (1 << (seq - req->seq_first))))
+			error = 0;
+
+		if (error && req->result == TCORE_RETURN_SUCCESS) {
+			err("[%s] rtnetlink message %u failed: %s", req->name,
+					seq - req->seq_first, strerror(-error));
+			req->result = TCORE_RETURN_FAILURE;
+		}
+
+		req->acks++;
+		if (req->acks == req->count) {
+			netif_socket->requests = g_slist_delete_link(netif_socket->requests, l);
+			_netif_request_finish(req);
+		}
+
+		return;
+	}
+
+	dbg("ack for unknown sequence %u", seq);
+}
+
+static gboolean _netif_on_readable(GIOChannel *channel, GIOCondition cond,
+		gpointer user_data)
+{
+	union {
+		struct nlmsghdr hdr;
+		unsigned char raw[NETIF_RECV_SIZE];
+	} buf;
+	struct nlmsghdr *nlh;
+	ssize_t len;
+
+	if (cond & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) {
+		err("rtnetlink socket error, closing");
+		netif_socket->watch = 0;
+		tcore_netif_close();
+		return FALSE;
+	}
+
+	while ((len = recv(netif_socket->fd, buf.raw, sizeof(buf), MSG_DONTWAIT)) > 0) {
+		unsigned char *p = buf.raw;
+		unsigned int remain = len;
+
+		while (remain >= NLMSG_HDRLEN) {
+			unsigned int step;
+
+			nlh = (void *) p;
+			if (nlh->nlmsg_len < NLMSG_HDRLEN || nlh->nlmsg_len > remain)
+				break;
+
+			if (nlh->nlmsg_type == NLMSG_ERROR
+					&& nlh->nlmsg_len >= NLMSG_LENGTH(sizeof(struct nlmsgerr))) {
+				struct nlmsgerr *e = NLMSG_DATA(nlh);
+
+				_netif_handle_ack(nlh->nlmsg_seq, e->error);
+
+				/* a callback may have closed the socket */
+				if (!netif_socket)
+					return FALSE;
+			}
+
+			step = NLMSG_ALIGN(nlh->nlmsg_len);
+			if (step >= remain)
+				break;
+
+			p += step;
+			remain -= step;
+		}
+	}
+
+	if (len < 0) {
+		if (errno == ENOBUFS) {
+			GSList *requests = netif_socket->requests;
+
+			/* the kernel dropped messages, acks may be among them */
+			err("rtnetlink receive buffer overrun, failing %u requests",
+					g_slist_length(requests));
+			netif_socket->requests = NULL;
+			_netif_fail_requests(requests);
+
+			if (!netif_socket)
+				return FALSE;
+		}
+		else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+			err("rtnetlink recv: %s", strerror(errno));
+		}
+	}
+
+	return TRUE;
+}
+
+static struct netif_socket_type *_netif_socket_get(void)
+{
+	struct sockaddr_nl addr;
+	GIOChannel *channel;
+	int fd;
+#ifdef NETLINK_CAP_ACK
+	int one = 1;
+#endif
+
+	if (netif_socket)
+		return netif_socket;
+
+	fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_ROUTE);
+	if (fd < 0) {
+		err("rtnetlink socket: %s", strerror(errno));
+		return NULL;
+	}
+
+	memset(&addr, 0, sizeof(struct sockaddr_nl));
+	addr.nl_family = AF_NETLINK;
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(struct sockaddr_nl)) < 0) {
+		err("rtnetlink bind: %s", strerror(errno));
+		close(fd);
+		return NULL;
+	}
+
+#ifdef NETLINK_CAP_ACK
+	/* acks without a copy of the request keep the receive buffer small */
+	setsockopt(fd, SOL_NETLINK, NETLINK_CAP_ACK, &one, sizeof(one));
+#endif
+
+	netif_socket = calloc(1, sizeof(struct netif_socket_type));
+	if (!netif_socket) {
+		close(fd);
+		return NULL;
+	}
+
+	netif_socket->fd = fd;
+	netif_socket->seq = (guint32) g_get_monotonic_time();
+
+	channel = g_io_channel_unix_new(fd);
+	netif_socket->watch = g_io_add_watch(channel, G_IO_IN | G_IO_ERR | G_IO_HUP | G_IO_NVAL,
+			_netif_on_readable, NULL);
+	g_io_channel_unref(channel);
+
+	return netif_socket;
+}
+
+static TReturn _netif_set_mtu_ioctl(const char *name, unsigned int mtu)
+{
+	struct ifreq ifr;
+	int fd;
+	int ret;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+		return TCORE_RETURN_FAILURE;
+
+	memset(&ifr, 0, sizeof(struct ifreq));
+	strncpy(ifr.ifr_name, name, IFNAMSIZ);
+	ifr.ifr_name[IFNAMSIZ - 1] = '\0';
+	ifr.ifr_mtu = mtu;
+
+	ret = ioctl(fd, SIOCSIFMTU, &ifr);
+	close(fd);
+
+	return ret < 0 ? TCORE_RETURN_FAILURE : TCORE_RETURN_SUCCESS;
+}
+
+static gboolean _netif_on_fallback_done(gpointer user_data)
+{
+	_netif_request_finish(user_data);
+	return FALSE;
+}
+
+static TReturn _netif_configure_ioctl(const struct tcore_netif_config *config,
+		TcoreNetifCallback cb, void *user_data)
+{
+	struct netif_request_type *req;
+	TReturn ret = TCORE_RETURN_SUCCESS;
+
+	dbg("[%s] rtnetlink unavailable, using ioctl", config->name);
+
+	if (config->ipv6_addr || config->default_route)
+		dbg("[%s] IPv6 and routes are not configured by the ioctl path", config->name);
+
+	if (config->up) {
+		if (config->ipv4_addr)
+			ret = tcore_util_netif_set(config->name, config->ipv4_addr,
+					config->ipv4_gateway, config->ipv4_netmask);
+
+		if (ret == TCORE_RETURN_SUCCESS && config->mtu)
+			ret = _netif_set_mtu_ioctl(config->name, config->mtu);
+
+		if (ret == TCORE_RETURN_SUCCESS)
+			ret = tcore_util_netif_up(config->name);
+	}
+	else {
+		ret = tcore_util_netif_down(config->name);
+	}
+
+	req = calloc(1, sizeof(struct netif_request_type));
+	if (!req)
+		return TCORE_RETURN_ENOMEM;
+
+	g_strlcpy(req->name, config->name, IFNAMSIZ);
+	req->result = ret;
+	req->cb = cb;
+	req->user_data = user_data;
+
+	/* keep the callback asynchronous, as on the netlink path */
+	g_idle_add(_netif_on_fallback_done, req);
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+TReturn tcore_netif_configure(const struct tcore_netif_config *config,
+		TcoreNetifCallback cb, void *user_data)
+{
+	struct netif_socket_type *sock;
+	struct netif_batch_type *b;
+	struct netif_request_type *req;
+	struct netif_address_type v4, v6;
+	struct sockaddr_nl kernel;
+	unsigned int prefix = 32;
+	unsigned int ifindex;
+	gboolean ok = TRUE;
+	TReturn ret;
+
+	if (!config || !config->name)
+		return TCORE_RETURN_EINVAL;
+
+	if (strlen(config->name) >= IFNAMSIZ)
+		return TCORE_RETURN_EINVAL;
+
+	if (config->ipv4_netmask) {
+		struct in_addr mask;
+
+		if (inet_pton(AF_INET, config->ipv4_netmask, &mask) != 1)
+			return TCORE_RETURN_EINVAL;
+
+		prefix = _netif_netmask_to_prefix(mask);
+		if (prefix > 32)
+			return TCORE_RETURN_EINVAL;
+	}
+
+	ret = _netif_parse_address(&v4, AF_INET, config->ipv4_addr,
+			config->ipv4_gateway, prefix);
+	if (ret != TCORE_RETURN_SUCCESS)
+		return ret;
+
+	ret = _netif_parse_address(&v6, AF_INET6, config->ipv6_addr,
+			config->ipv6_gateway,
+			config->ipv6_prefix_len ? config->ipv6_prefix_len : 64);
+	if (ret != TCORE_RETURN_SUCCESS)
+		return ret;
+
+	if (v6.valid && v6.prefix_len > 128)
+		return TCORE_RETURN_EINVAL;
+
+	ifindex = if_nametoindex(config->name);
+	if (!ifindex) {
+		err("[%s] no such interface", config->name);
+		return TCORE_RETURN_ENOENT;
+	}
+
+	sock = _netif_socket_get();
+	if (!sock)
+		return _netif_configure_ioctl(config, cb, user_data);
+
+	b = calloc(1, sizeof(struct netif_batch_type));
+	if (!b)
+		return TCORE_RETURN_ENOMEM;
+
+	b->seq = sock->seq;
+
+	/* the kernel handles the messages in order: link first, routes last */
+	if (config->up) {
+		ok = _netif_batch_link(b, ifindex, TRUE, config->mtu);
+
+		if (ok && v4.valid)
+			ok = _netif_batch_addr(b, RTM_NEWADDR, ifindex, &v4);
+
+		if (ok && v6.valid)
+			ok = _netif_batch_addr(b, RTM_NEWADDR, ifindex, &v6);
+
+		if (ok && v4.valid && config->default_route)
+			ok = _netif_batch_default_route(b, ifindex, &v4);
+
+		if (ok && v6.valid && config->default_route)
+			ok = _netif_batch_default_route(b, ifindex, &v6);
+	}
+	else {
+		if (v4.valid)
+			ok = _netif_batch_addr(b, RTM_DELADDR, ifindex, &v4);
+
+		if (ok && v6.valid)
+			ok = _netif_batch_addr(b, RTM_DELADDR, ifindex, &v6);
+
+		/* routes through the link go away with it */
+		if (ok)
+			ok = _netif_batch_link(b, ifindex, FALSE, config->mtu);
+	}
+
+	if (!ok) {
+		err("[%s] rtnetlink batch overflow", config->name);
+		free(b);
+		return TCORE_RETURN_EMSGSIZE;
+	}
+
+	b->len += NLMSG_ALIGN(b->last->nlmsg_len);
+
+	memset(&kernel, 0, sizeof(struct sockaddr_nl));
+	kernel.nl_family = AF_NETLINK;
+
+	if (sendto(sock->fd, b->buf.raw, b->len, 0, (struct sockaddr *) &kernel,
+			sizeof(struct sockaddr_nl)) < 0) {
+		err("[%s] rtnetlink send: %s", config->name, strerror(errno));
+		free(b);
+		return _netif_configure_ioctl(config, cb, user_data);
+	}
+
+	req = calloc(1, sizeof(struct netif_request_type));
+	if (!req) {
+		free(b);
+		return TCORE_RETURN_ENOMEM;
+	}
+
+	g_strlcpy(req->name, config->name, IFNAMSIZ);
+	req->seq_first = b->seq;
+	req->count = b->count;
+	req->exist_ok = b->exist_ok;
+	req->result = TCORE_RETURN_SUCCESS;
+	req->cb = cb;
+	req->user_data = user_data;
+
+	sock->seq += b->count;
+	sock->requests = g_slist_append(sock->requests, req);
+
+	dbg("[%s] %u rtnetlink messages, %u bytes", config->name, b->count, b->len);
+	free(b);
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+void tcore_netif_close(void)
+{
+	struct netif_socket_type *sock = netif_socket;
+
+	if (!sock)
+		return;
+
+	netif_socket = NULL;
+
+	if (sock->watch)
+		g_source_remove(sock->watch);
+
+	close(sock->fd);
+
+	_netif_fail_requests(sock->requests);
+	free(sock);
+}
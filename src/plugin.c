@@ -33,6 +33,14 @@
 #include "plugin.h"
 #include "server.h"
 
+/*
+ * Core object types are CORE_OBJECT_TYPE_DEFAULT | TCORE_TYPE_xxx, so the
+ * TCORE_TYPE_xxx octet is used directly as an index into the routing table.
+ */
+#define PLUGIN_ROUTE_SHIFT 20
+#define PLUGIN_ROUTE_MASK 0x0FF00000
+#define PLUGIN_ROUTE_MAX ((PLUGIN_ROUTE_MASK >> PLUGIN_ROUTE_SHIFT) + 1)
+
 struct tcore_plugin_type {
 	char *filename;
 	const struct tcore_plugin_define_desc *desc;
@@ -43,9 +51,80 @@ struct tcore_plugin_type {
 	GSList *list_co;
 	GHashTable *property;
 
+	/* core objects by type, rebuilt on demand after list_co changes */
+	GSList *route_co[PLUGIN_ROUTE_MAX];
+	gboolean route_valid;
+
+	/* event quark -> core objects with a callback for it */
+	GHashTable *event_subscribers;
+
+	/* optional worker thread, NULL context means the server main loop */
+	GMainContext *context;
+	GMainLoop *worker_loop;
+	GThread *worker;
+
 	Server *parent_server;
 };
 
+static gboolean _route_index(unsigned int type, unsigned int *index)
+{
+	if ((type & ~PLUGIN_ROUTE_MASK) != CORE_OBJECT_TYPE_DEFAULT)
+		return FALSE;
+
+	*index = (type & PLUGIN_ROUTE_MASK) >> PLUGIN_ROUTE_SHIFT;
+
+	return TRUE;
+}
+
+static void _route_invalidate(TcorePlugin *plugin)
+{
+	unsigned int i;
+
+	if (!plugin->route_valid)
+		return;
+
+	for (i = 0; i < PLUGIN_ROUTE_MAX; i++) {
+		if (plugin->route_co[i]) {
+			g_slist_free(plugin->route_co[i]);
+			plugin->route_co[i] = NULL;
+		}
+	}
+
+	plugin->route_valid = FALSE;
+}
+
+static void _route_build(TcorePlugin *plugin)
+{
+	GSList *list;
+	CoreObject *co;
+	unsigned int i;
+
+	for (list = plugin->list_co; list; list = list->next) {
+		co = list->data;
+		if (!co)
+			continue;
+
+		if (_route_index(tcore_object_get_type(co), &i) == FALSE)
+			continue;
+
+		plugin->route_co[i] = g_slist_prepend(plugin->route_co[i], co);
+	}
+
+	/* keep list_co order, as tcore_plugin_get_core_objects_bytype() did */
+	for (i = 0; i < PLUGIN_ROUTE_MAX; i++) {
+		if (plugin->route_co[i])
+			plugin->route_co[i] = g_slist_reverse(plugin->route_co[i]);
+	}
+
+	plugin->route_valid = TRUE;
+}
+
+static void _free_subscriber_list(gpointer key, gpointer value,
+		gpointer user_data)
+{
+	g_slist_free(value);
+}
+
 TcorePlugin *tcore_plugin_new(Server *server,
 		const struct tcore_plugin_define_desc *desc,
 		const char *filename, void *handle)
@@ -61,6 +140,8 @@ TcorePlugin *tcore_plugin_new(Server *server,
 
 	p->desc = desc;
 	p->property = g_hash_table_new(g_str_hash, g_str_equal);
+	/* values are freed by hand, they get replaced while iterating */
+	p->event_subscribers = g_hash_table_new(g_direct_hash, g_direct_equal);
 	p->handle = handle;
 	p->parent_server = server;
 
@@ -69,7 +150,7 @@ TcorePlugin *tcore_plugin_new(Server *server,
 
 void tcore_plugin_free(TcorePlugin *plugin)
 {
-	GSList *list;
+	GSList *list, *list_co;
 	CoreObject *o;
 
 	if (!plugin)
@@ -77,8 +158,16 @@ void tcore_plugin_free(TcorePlugin *plugin)
 
 	dbg("");
 
+	tcore_plugin_stop_worker(plugin);
+
+	_route_invalidate(plugin);
+
 	if (plugin->list_co) {
-		for (list = plugin->list_co; list; list = list->next) {
+		/* detach first, tcore_object_free() removes itself from list_co */
+		list_co = plugin->list_co;
+		plugin->list_co = NULL;
+
+		for (list = list_co; list; list = list->next) {
 			if (!list)
 				continue;
 
@@ -90,8 +179,7 @@ void tcore_plugin_free(TcorePlugin *plugin)
 			list->data = NULL;
 		}
 
-		g_slist_free(plugin->list_co);
-		plugin->list_co = NULL;
+		g_slist_free(list_co);
 	}
 
 	if (plugin->filename) {
@@ -104,8 +192,26 @@ void tcore_plugin_free(TcorePlugin *plugin)
 		plugin->property = NULL;
 	}
 
+	if (plugin->event_subscribers) {
+		g_hash_table_foreach(plugin->event_subscribers,
+				_free_subscriber_list, NULL);
+		g_hash_table_destroy(plugin->event_subscribers);
+		plugin->event_subscribers = NULL;
+	}
+
 	plugin->desc = NULL;
 
+	/* kept until now, sources of the plugin may still be removed */
+	if (plugin->worker_loop) {
+		g_main_loop_unref(plugin->worker_loop);
+		plugin->worker_loop = NULL;
+	}
+
+	if (plugin->context) {
+		g_main_context_unref(plugin->context);
+		plugin->context = NULL;
+	}
+
 	if (plugin->handle) {
 		dlclose(plugin->handle);
 		plugin->handle = NULL;
@@ -178,10 +284,48 @@ TReturn tcore_plugin_add_core_object(TcorePlugin *plugin, CoreObject *co)
 	dbg("add core_object! (name=%s)", tcore_object_ref_name(co));
 
 	plugin->list_co = g_slist_insert(plugin->list_co, co, 0);
+	_route_invalidate(plugin);
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+TReturn tcore_plugin_remove_core_object(TcorePlugin *plugin, CoreObject *co)
+{
+	GHashTableIter iter;
+	gpointer value;
+	GSList *list;
+
+	if (!plugin || !co)
+		return TCORE_RETURN_EINVAL;
+
+	g_hash_table_iter_init(&iter, plugin->event_subscribers);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		list = g_slist_remove(value, co);
+		if (list)
+			g_hash_table_iter_replace(&iter, list);
+		else
+			g_hash_table_iter_remove(&iter);
+	}
+
+	if (!g_slist_find(plugin->list_co, co))
+		return TCORE_RETURN_EINVAL;
+
+	dbg("remove core_object! (name=%s)", tcore_object_ref_name(co));
+
+	plugin->list_co = g_slist_remove(plugin->list_co, co);
+	_route_invalidate(plugin);
 
 	return TCORE_RETURN_SUCCESS;
 }
 
+void tcore_plugin_update_core_object(TcorePlugin *plugin, CoreObject *co)
+{
+	if (!plugin || !co)
+		return;
+
+	_route_invalidate(plugin);
+}
+
 CoreObject *tcore_plugin_ref_core_object(TcorePlugin *plugin, const char *name)
 {
 	GSList *list;
@@ -207,54 +351,124 @@ CoreObject *tcore_plugin_ref_core_object(TcorePlugin *plugin, const char *name)
 }
 
 
+GSList *tcore_plugin_ref_core_objects_bytype(TcorePlugin *plugin, unsigned int type)
+{
+	unsigned int i;
+
+	if (!plugin)
+		return NULL;
+
+	if (_route_index(type, &i) == FALSE)
+		return NULL;
+
+	if (!plugin->route_valid)
+		_route_build(plugin);
+
+	return plugin->route_co[i];
+}
+
 GSList *tcore_plugin_get_core_objects_bytype(TcorePlugin *plugin, unsigned int type)
 {
 	GSList *list, *rlist = NULL;
 	CoreObject *co;
+	unsigned int i;
 
 	if (!plugin)
 		return NULL;
 
-	for (list = plugin->list_co; list; list = list->next) {
-		if (!list)
-			continue;
+	if (_route_index(type, &i) == TRUE)
+		return g_slist_copy(tcore_plugin_ref_core_objects_bytype(plugin, type));
 
+	for (list = plugin->list_co; list; list = list->next) {
 		co = list->data;
 		if (!co)
 			continue;
 
-		if (tcore_object_get_type(co) == type) {
-			rlist = g_slist_append(rlist, co);
-		}
+		if (tcore_object_get_type(co) == type)
+			rlist = g_slist_prepend(rlist, co);
 	}
 
-	return rlist;
+	return g_slist_reverse(rlist);
 }
 
 TReturn tcore_plugin_core_object_event_emit(TcorePlugin *plugin, const char *event, const void *event_info)
 {
-	GSList *list;
+	if (!plugin || !event)
+		return TCORE_RETURN_EINVAL;
+
+	dbg("event(%s) emit", event);
+
+	return tcore_plugin_core_object_event_emit_quark(plugin,
+			g_quark_try_string(event), event_info);
+}
+
+TReturn tcore_plugin_core_object_event_emit_quark(TcorePlugin *plugin,
+		GQuark event_id, const void *event_info)
+{
+	GSList *list, *next;
 	CoreObject *co;
 
 	if (!plugin)
 		return TCORE_RETURN_EINVAL;
 
-	dbg("event(%s) emit", event);
+	if (!event_id)
+		return TCORE_RETURN_SUCCESS;
 
-	for (list = plugin->list_co; list; list = list->next) {
-		if (!list)
-			continue;
+	list = g_hash_table_lookup(plugin->event_subscribers,
+			GUINT_TO_POINTER(event_id));
+	for (; list; list = next) {
+		/* a callback may unsubscribe its own core object */
+		next = list->next;
 
 		co = list->data;
 		if (!co)
 			continue;
 
-		tcore_object_emit_callback(co, event, event_info);
+		tcore_object_emit_callback_quark(co, event_id, event_info);
 	}
 
 	return TCORE_RETURN_SUCCESS;
 }
 
+TReturn tcore_plugin_add_event_subscriber(TcorePlugin *plugin,
+		GQuark event_id, CoreObject *co)
+{
+	gpointer key = GUINT_TO_POINTER(event_id);
+	GSList *list;
+
+	if (!plugin || !event_id || !co)
+		return TCORE_RETURN_EINVAL;
+
+	list = g_hash_table_lookup(plugin->event_subscribers, key);
+	if (g_slist_find(list, co))
+		return TCORE_RETURN_EALREADY;
+
+	/* newest first, as the list_co walk this replaces was */
+	g_hash_table_insert(plugin->event_subscribers, key,
+			g_slist_prepend(list, co));
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+TReturn tcore_plugin_remove_event_subscriber(TcorePlugin *plugin,
+		GQuark event_id, CoreObject *co)
+{
+	gpointer key = GUINT_TO_POINTER(event_id);
+	GSList *list;
+
+	if (!plugin || !event_id || !co)
+		return TCORE_RETURN_EINVAL;
+
+	list = g_hash_table_lookup(plugin->event_subscribers, key);
+	list = g_slist_remove(list, co);
+	if (list)
+		g_hash_table_insert(plugin->event_subscribers, key, list);
+	else
+		g_hash_table_remove(plugin->event_subscribers, key);
+
+	return TCORE_RETURN_SUCCESS;
+}
+
 TReturn tcore_plugin_link_property(TcorePlugin *plugin, const char *key, void *data)
 {
 	void *prev;
@@ -287,3 +501,154 @@ void *tcore_plugin_ref_property(TcorePlugin *plugin, const char *key)
 
 	return g_hash_table_lookup(plugin->property, key);
 }
+
+static gpointer _worker_main(gpointer data)
+{
+	TcorePlugin *plugin = data;
+
+	dbg("plugin(%s) worker running", plugin->desc->name);
+
+	g_main_context_push_thread_default(plugin->context);
+	g_main_loop_run(plugin->worker_loop);
+	g_main_context_pop_thread_default(plugin->context);
+
+	dbg("plugin(%s) worker stopped", plugin->desc->name);
+
+	return NULL;
+}
+
+TReturn tcore_plugin_start_worker(TcorePlugin *plugin)
+{
+	GError *error = NULL;
+
+	if (!plugin || !plugin->desc)
+		return TCORE_RETURN_EINVAL;
+
+	if (plugin->worker)
+		return TCORE_RETURN_EALREADY;
+
+	if (!plugin->context) {
+		plugin->context = g_main_context_new();
+		if (!plugin->context)
+			return TCORE_RETURN_ENOMEM;
+
+		plugin->worker_loop = g_main_loop_new(plugin->context, FALSE);
+		if (!plugin->worker_loop) {
+			g_main_context_unref(plugin->context);
+			plugin->context = NULL;
+			return TCORE_RETURN_ENOMEM;
+		}
+	}
+
+	plugin->worker = g_thread_try_new(plugin->desc->name, _worker_main,
+			plugin, &error);
+	if (!plugin->worker) {
+		err("plugin(%s) worker: %s", plugin->desc->name,
+				error ? error->message : "unknown");
+		if (error)
+			g_error_free(error);
+
+		return TCORE_RETURN_FAILURE;
+	}
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+void tcore_plugin_stop_worker(TcorePlugin *plugin)
+{
+	if (!plugin || !plugin->worker)
+		return;
+
+	/*
+	 * The context outlives the thread: source ids handed out for it stay
+	 * valid for tcore_plugin_remove_source() until tcore_plugin_free().
+	 */
+	g_main_loop_quit(plugin->worker_loop);
+	g_thread_join(plugin->worker);
+	plugin->worker = NULL;
+}
+
+GMainContext *tcore_plugin_ref_main_context(TcorePlugin *plugin)
+{
+	if (!plugin)
+		return NULL;
+
+	return plugin->context;
+}
+
+gboolean tcore_plugin_is_worker_thread(TcorePlugin *plugin)
+{
+	if (!plugin || !plugin->context)
+		return FALSE;
+
+	return g_main_context_is_owner(plugin->context);
+}
+
+static guint _attach_source(TcorePlugin *plugin, GSource *source,
+		GSourceFunc func, void *user_data)
+{
+	guint id;
+
+	if (!source)
+		return 0;
+
+	g_source_set_callback(source, func, user_data, NULL);
+	id = g_source_attach(source, plugin ? plugin->context : NULL);
+	g_source_unref(source);
+
+	return id;
+}
+
+guint tcore_plugin_add_idle(TcorePlugin *plugin, gint priority,
+		GSourceFunc func, void *user_data)
+{
+	GSource *source;
+
+	source = g_idle_source_new();
+	if (!source)
+		return 0;
+
+	g_source_set_priority(source, priority);
+
+	return _attach_source(plugin, source, func, user_data);
+}
+
+guint tcore_plugin_add_timeout(TcorePlugin *plugin, guint interval,
+		GSourceFunc func, void *user_data)
+{
+	return _attach_source(plugin, g_timeout_source_new(interval),
+			func, user_data);
+}
+
+guint tcore_plugin_add_timeout_seconds(TcorePlugin *plugin, guint interval,
+		GSourceFunc func, void *user_data)
+{
+	return _attach_source(plugin, g_timeout_source_new_seconds(interval),
+			func, user_data);
+}
+
+gboolean tcore_plugin_remove_source(TcorePlugin *plugin, guint id)
+{
+	GSource *source;
+
+	source = g_main_context_find_source_by_id(
+			plugin ? plugin->context : NULL, id);
+	if (!source)
+		return FALSE;
+
+	g_source_destroy(source);
+
+	return TRUE;
+}
+
+TReturn tcore_plugin_invoke(TcorePlugin *plugin, GSourceFunc func,
+		void *user_data, GDestroyNotify notify)
+{
+	if (!plugin || !func)
+		return TCORE_RETURN_EINVAL;
+
+	g_main_context_invoke_full(plugin->context, G_PRIORITY_DEFAULT,
+			func, user_data, notify);
+
+	return TCORE_RETURN_SUCCESS;
+}
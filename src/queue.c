@@ -33,6 +33,7 @@
 #include "hal.h"
 #include "user_request.h"
 #include "core_object.h"
+#include "trace.h"
 
 
 struct tcore_queue_type {
@@ -64,6 +65,7 @@ struct tcore_pending_type {
 
 	guint timer_src;
 
+	guint64 trace_id;
 	UserRequest *ur;
 	TcorePlugin *plugin;
 	CoreObject *co;
@@ -107,6 +109,9 @@ TcorePending *tcore_pending_new(CoreObject *co, unsigned int id)
 	p->id = id;
 	time(&p->timestamp);
 
+	/* replaced by the request's id once a UserRequest is linked */
+	p->trace_id = tcore_trace_new_id();
+
 	p->on_send = NULL;
 	p->on_send_user_data = NULL;
 	p->on_response = NULL;
@@ -139,7 +144,8 @@ void tcore_pending_free(TcorePending *pending)
 	}
 
 	if (pending->timer_src) {
-		g_source_remove(pending->timer_src);
+		tcore_plugin_remove_source(tcore_hal_ref_plugin(pending->queue->hal),
+				pending->timer_src);
 	}
 
 	free(pending);
@@ -304,7 +310,9 @@ TReturn tcore_pending_emit_send_callback(TcorePending *pending, gboolean result)
 		if (pending->flag_auto_free_after_sent == FALSE && pending->timeout > 0) {
 			/* timer */
 			dbg("start pending timer! (%d secs)", pending->timeout);
-			pending->timer_src = g_timeout_add_seconds(pending->timeout, _on_pending_timeout, pending);
+			pending->timer_src = tcore_plugin_add_timeout_seconds(
+					tcore_hal_ref_plugin(pending->queue->hal),
+					pending->timeout, _on_pending_timeout, pending);
 		}
 	}
 
@@ -328,6 +336,8 @@ TReturn tcore_pending_emit_response_callback(TcorePending *pending,
 	if (!pending)
 		return TCORE_RETURN_EINVAL;
 
+	tcore_trace_record(pending->trace_id, TCORE_TRACE_RESPONSE, data_len);
+
 	if (pending->on_response)
 		pending->on_response(pending, data_len, data,
 				pending->on_response_user_data);
@@ -357,10 +367,20 @@ TReturn tcore_pending_link_user_request(TcorePending *pending, UserRequest *ur)
 		return TCORE_RETURN_EINVAL;
 
 	pending->ur = ur;
+	if (ur)
+		pending->trace_id = tcore_user_request_get_trace_id(ur);
 
 	return TCORE_RETURN_SUCCESS;
 }
 
+guint64 tcore_pending_get_trace_id(TcorePending *pending)
+{
+	if (!pending)
+		return 0;
+
+	return pending->trace_id;
+}
+
 UserRequest *tcore_pending_ref_user_request(TcorePending *pending)
 {
 	if (!pending)
@@ -456,6 +476,9 @@ TReturn tcore_queue_push(TcoreQueue *queue, TcorePending *pending)
 	dbg("pending(0x%x) push to queue. queue length=%d",
 			(unsigned int)pending, g_queue_get_length(queue->gq));
 
+	tcore_trace_record(pending->trace_id, TCORE_TRACE_ENQUEUE,
+			g_queue_get_length(queue->gq));
+
 	return TCORE_RETURN_SUCCESS;
 }
 
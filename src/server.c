@@ -38,6 +38,7 @@
 #include "communicator.h"
 #include "storage.h"
 #include "udev.h"
+#include "trace.h"
 
 struct tcore_server_type {
 	GMainLoop *mainloop;
@@ -47,8 +48,14 @@ struct tcore_server_type {
 	GSList *hals;
 	GSList *hook_list_request;
 	GSList *hook_list_notification;
+	GHashTable *plugin_table;
+	GHashTable *hook_table_request;
+	GHashTable *hook_table_notification;
 	TcorePlugin *default_plugin;
 	TcoreUdev *udev;
+
+	/* thread that created the server, its main thread until tcore_server_run() */
+	GThread *owner;
 };
 
 struct hook_request_type {
@@ -79,7 +86,6 @@ static TcorePlugin *_find_default_plugin(Server *s)
 {
 	GSList *list;
 	TcorePlugin *p;
-	GSList *co_list;
 
 	if (s->default_plugin != NULL) {
 		return s->default_plugin;
@@ -90,11 +96,9 @@ static TcorePlugin *_find_default_plugin(Server *s)
 		if (!p)
 			continue;
 
-		co_list = tcore_plugin_get_core_objects_bytype(p, CORE_OBJECT_TYPE_MODEM);
-		if (!co_list)
+		if (!tcore_plugin_ref_core_objects_bytype(p, CORE_OBJECT_TYPE_MODEM))
 			continue;
 
-		g_slist_free(co_list);
 		s->default_plugin = p;
 		return p;
 	}
@@ -102,6 +106,98 @@ static TcorePlugin *_find_default_plugin(Server *s)
 	return NULL;
 }
 
+static void _free_hook_list(gpointer data)
+{
+	g_slist_free(data);
+}
+
+struct dispatch_type {
+	Server *s;
+	TcorePlugin *p;
+	UserRequest *ur;
+};
+
+struct notification_type {
+	Server *s;
+	CoreObject *source;
+	enum tcore_notification_command command;
+	unsigned int data_len;
+	void *data;
+};
+
+static TReturn _dispatch_core_objects(TcorePlugin *p, UserRequest *ur)
+{
+	GSList *list, *co_list;
+	CoreObject *o;
+	int category;
+	TReturn ret = TCORE_RETURN_ENOSYS;
+
+	category = CORE_OBJECT_TYPE_DEFAULT
+			| (tcore_user_request_get_command(ur) & 0x0FF00000);
+
+	/* owned by the plugin, must not be freed */
+	co_list = tcore_plugin_ref_core_objects_bytype(p, category);
+	if (!co_list) {
+		warn("can't find 0x%x core_object", category);
+		return TCORE_RETURN_ENOSYS;
+	}
+
+	for (list = co_list; list; list = list->next) {
+		o = (CoreObject *) list->data;
+		if (!o) {
+			warn("can't find 0x%x core_object", category);
+			continue;
+		}
+
+		if (tcore_object_dispatch_request(o, ur) == TCORE_RETURN_SUCCESS)
+			ret = TCORE_RETURN_SUCCESS;
+		else
+			dbg("failed...");
+	}
+
+	return ret;
+}
+
+static gboolean _on_worker_dispatch(gpointer user_data)
+{
+	struct dispatch_type *d = user_data;
+	unsigned int command;
+
+	/*
+	 * The caller already saw success and gave up the request, so a
+	 * request no core object took is answered with an empty response
+	 * (the client would wait forever otherwise) and released here.
+	 */
+	if (_dispatch_core_objects(d->p, d->ur) != TCORE_RETURN_SUCCESS) {
+		command = tcore_user_request_get_command(d->ur);
+		err("request(0x%x) dropped by worker", command);
+
+		tcore_user_request_send_response(d->ur,
+				TCORE_RESPONSE | (command & ~TCORE_REQUEST), 0, NULL);
+		tcore_user_request_unref(d->ur);
+	}
+
+	tcore_user_request_unref(d->ur);
+	free(d);
+
+	return FALSE;
+}
+
+static gboolean _on_main_notification(gpointer user_data)
+{
+	struct notification_type *n = user_data;
+
+	tcore_server_send_notification(n->s, n->source, n->command,
+			n->data_len, n->data);
+
+	if (n->data)
+		free(n->data);
+
+	free(n);
+
+	return FALSE;
+}
+
 Server *tcore_server_new()
 {
 	Server *s;
@@ -123,6 +219,14 @@ Server *tcore_server_new()
 	s->hook_list_request = NULL;
 	s->hook_list_notification = NULL;
 	s->default_plugin = NULL;
+	s->owner = g_thread_self();
+
+	/* routing tables: plugin name -> plugin, command -> hooks */
+	s->plugin_table = g_hash_table_new(g_str_hash, g_str_equal);
+	s->hook_table_request = g_hash_table_new_full(g_direct_hash,
+			g_direct_equal, NULL, _free_hook_list);
+	s->hook_table_notification = g_hash_table_new_full(g_direct_hash,
+			g_direct_equal, NULL, _free_hook_list);
 
 	return s;
 }
@@ -136,14 +240,14 @@ void tcore_server_free(Server *s)
 	if (!s)
 		return;
 
-	if (s->mainloop)
-		g_main_loop_unref(s->mainloop);
-
     for (list = s->plugins; list; list = list->next) {
         p = list->data;
         if (!p)
             continue;
 
+		/* nothing may run on the worker while unload() frees its objects */
+		tcore_plugin_stop_worker(p);
+
         desc = (struct tcore_plugin_define_desc *)tcore_plugin_get_description(p);
 		if (!desc || !desc->unload)
 			continue;
@@ -159,6 +263,29 @@ void tcore_server_free(Server *s)
         g_slist_free(s->plugins);
         s->plugins = NULL;
     }
+
+	/* unload() above still sends notifications through the main loop */
+	if (s->mainloop) {
+		g_main_loop_unref(s->mainloop);
+		s->mainloop = NULL;
+	}
+
+	if (s->plugin_table) {
+		g_hash_table_destroy(s->plugin_table);
+		s->plugin_table = NULL;
+	}
+
+	if (s->hook_table_request) {
+		g_hash_table_destroy(s->hook_table_request);
+		s->hook_table_request = NULL;
+	}
+
+	if (s->hook_table_notification) {
+		g_hash_table_destroy(s->hook_table_notification);
+		s->hook_table_notification = NULL;
+	}
+
+	s->default_plugin = NULL;
 }
 
 TReturn tcore_server_run(Server *s)
@@ -183,13 +310,45 @@ TReturn tcore_server_exit(Server *s)
 	return TCORE_RETURN_SUCCESS;
 }
 
+static void _update_plugin_table(Server *s, const char *name)
+{
+	GSList *list;
+	TcorePlugin *p;
+
+	for (list = s->plugins; list; list = list->next) {
+		p = list->data;
+		if (!p)
+			continue;
+
+		if (g_strcmp0(tcore_plugin_get_description(p)->name, name) == 0) {
+			g_hash_table_replace(s->plugin_table,
+					(gpointer)tcore_plugin_get_description(p)->name, p);
+			return;
+		}
+	}
+
+	g_hash_table_remove(s->plugin_table, name);
+}
+
 TReturn tcore_server_add_plugin(Server *s, TcorePlugin *plugin)
 {
+	const char *name;
+
 	if (!s || !plugin)
 		return TCORE_RETURN_EINVAL;
 
 	s->plugins = g_slist_insert_sorted(s->plugins, plugin, _compare_priority);
 
+	/*
+	 * The first plugin of a name in priority order wins, as with the
+	 * list walk this table replaces.
+	 */
+	name = tcore_plugin_get_description(plugin)->name;
+	if (name && g_hash_table_lookup(s->plugin_table, name) != plugin)
+		_update_plugin_table(s, name);
+
+	s->default_plugin = NULL;
+
 	tcore_server_send_notification(s, NULL, TNOTI_SERVER_ADDED_PLUGIN, 0, NULL);
 
 	return TCORE_RETURN_SUCCESS;
@@ -197,25 +356,14 @@ TReturn tcore_server_add_plugin(Server *s, TcorePlugin *plugin)
 
 TcorePlugin *tcore_server_find_plugin(Server *s, const char *name)
 {
-	GSList *list;
-	TcorePlugin *p;
+	if (!s || !name)
+		return NULL;
 
 	if (g_strcmp0(name, TCORE_PLUGIN_DEFAULT) == 0) {
 		return _find_default_plugin(s);
 	}
 
-	for (list = s->plugins; list; list = list->next) {
-		p = list->data;
-		if (!p) {
-			continue;
-		}
-
-		if (g_strcmp0(tcore_plugin_get_description(p)->name, name) == 0) {
-			return p;
-		}
-	}
-
-	return NULL;
+	return g_hash_table_lookup(s->plugin_table, name);
 }
 
 GSList *tcore_server_ref_plugins(Server *s)
@@ -238,6 +386,16 @@ TReturn tcore_server_add_communicator(Server *s, Communicator *comm)
 	return TCORE_RETURN_SUCCESS;
 }
 
+TReturn tcore_server_remove_communicator(Server *s, Communicator *comm)
+{
+	if (!s || !comm)
+		return TCORE_RETURN_EINVAL;
+
+	s->communicators = g_slist_remove(s->communicators, comm);
+
+	return TCORE_RETURN_SUCCESS;
+}
+
 GSList *tcore_server_ref_communicators(Server *s)
 {
 	if (!s)
@@ -382,69 +540,89 @@ TcoreUdev *tcore_server_ref_udev(Server *s)
 	return s->udev;
 }
 
+gboolean tcore_server_is_main_thread(Server *s)
+{
+	GMainContext *context;
+
+	if (!s || !s->mainloop)
+		return FALSE;
+
+	context = g_main_loop_get_context(s->mainloop);
+	if (g_main_context_is_owner(context))
+		return TRUE;
+
+	/* before tcore_server_run() nobody owns the context yet */
+	if (!g_main_loop_is_running(s->mainloop))
+		return g_thread_self() == s->owner;
+
+	return FALSE;
+}
+
+TReturn tcore_server_invoke(Server *s, GSourceFunc func, void *user_data,
+		GDestroyNotify notify)
+{
+	if (!s || !s->mainloop || !func)
+		return TCORE_RETURN_EINVAL;
+
+	g_main_context_invoke_full(g_main_loop_get_context(s->mainloop),
+			G_PRIORITY_DEFAULT, func, user_data, notify);
+
+	return TCORE_RETURN_SUCCESS;
+}
+
 TReturn tcore_server_dispatch_request(Server *s, UserRequest *ur)
 {
-	char *modem = NULL;
+	const char *modem = NULL;
 	TcorePlugin *p;
 	enum tcore_request_command command = 0;
-	GSList *list, *co_list=NULL;
+	GSList *list;
 	struct hook_request_type *hook;
-	int category;
-	CoreObject *o;
-	TReturn ret = TCORE_RETURN_ENOSYS;
+	struct dispatch_type *d;
 
 	if (!s || !ur)
 		return TCORE_RETURN_EINVAL;
 
-	for (list = s->hook_list_request; list; list = list->next) {
+	command = tcore_user_request_get_command(ur);
+
+	tcore_trace_record(tcore_user_request_get_trace_id(ur),
+			TCORE_TRACE_DISPATCH, command);
+
+	list = g_hash_table_lookup(s->hook_table_request, GUINT_TO_POINTER(command));
+	for (; list; list = list->next) {
 		hook = list->data;
 		if (!hook) {
 			continue;
 		}
 
-		if (hook->command == tcore_user_request_get_command(ur)) {
-			if (hook->func(s, ur, hook->user_data) == TCORE_HOOK_RETURN_STOP_PROPAGATION) {
-				return TCORE_RETURN_SUCCESS;
-			}
+		if (hook->func(s, ur, hook->user_data) == TCORE_HOOK_RETURN_STOP_PROPAGATION) {
+			return TCORE_RETURN_SUCCESS;
 		}
 	}
 
-	modem = tcore_user_request_get_modem_name(ur);
+	modem = tcore_user_request_ref_modem_name(ur);
 	if (!modem)
 		return TCORE_RETURN_EINVAL;
 
 	p = tcore_server_find_plugin(s, modem);
 	if (!p) {
-		free(modem);
 		return TCORE_RETURN_SERVER_WRONG_PLUGIN;
 	}
-	free(modem);
 
-	command = tcore_user_request_get_command(ur);
+	if (!tcore_plugin_ref_main_context(p) || tcore_plugin_is_worker_thread(p))
+		return _dispatch_core_objects(p, ur);
 
-	category = CORE_OBJECT_TYPE_DEFAULT | (command & 0x0FF00000);
+	/* core objects of a worker plugin are only touched on its thread */
+	d = calloc(sizeof(struct dispatch_type), 1);
+	if (!d)
+		return TCORE_RETURN_ENOMEM;
 
-	co_list = tcore_plugin_get_core_objects_bytype(p, category);
-	if (!co_list) {
-		warn("can't find 0x%x core_object", category);
-		return TCORE_RETURN_ENOSYS;
-	}
+	d->s = s;
+	d->p = p;
+	d->ur = tcore_user_request_ref(ur);
 
-	for (list = co_list; list; list = list->next) {
-		o = (CoreObject *) list->data;
-		if (!o) {
-			warn("can't find 0x%x core_object", category);
-			continue;
-		}
+	tcore_plugin_invoke(p, _on_worker_dispatch, d, NULL);
 
-		if (tcore_object_dispatch_request(o, ur) == TCORE_RETURN_SUCCESS)
-			ret = TCORE_RETURN_SUCCESS;
-		else
-			dbg("failed...");
-	}
-
-	g_slist_free(co_list);
-	return ret;
+	return TCORE_RETURN_SUCCESS;
 }
 
 TReturn tcore_server_send_notification(Server *s, CoreObject *source,
@@ -454,20 +632,44 @@ TReturn tcore_server_send_notification(Server *s, CoreObject *source,
 	GSList *list;
 	Communicator *comm;
 	struct hook_notification_type *hook;
+	struct notification_type *n;
 
 	if (!s)
 		return TCORE_RETURN_EINVAL;
 
-	for (list = s->hook_list_notification; list; list = list->next) {
+	/* hooks and communicators belong to the server thread */
+	if (!tcore_server_is_main_thread(s)) {
+		n = calloc(sizeof(struct notification_type), 1);
+		if (!n)
+			return TCORE_RETURN_ENOMEM;
+
+		if (data && data_len) {
+			n->data = malloc(data_len);
+			if (!n->data) {
+				free(n);
+				return TCORE_RETURN_ENOMEM;
+			}
+
+			memcpy(n->data, data, data_len);
+			n->data_len = data_len;
+		}
+
+		n->s = s;
+		n->source = source;
+		n->command = command;
+
+		return tcore_server_invoke(s, _on_main_notification, n, NULL);
+	}
+
+	list = g_hash_table_lookup(s->hook_table_notification, GUINT_TO_POINTER(command));
+	for (; list; list = list->next) {
 		hook = list->data;
 		if (!hook) {
 			continue;
 		}
 
-		if (hook->command == command) {
-			if (hook->func(s, source, command, data_len, data, hook->user_data) == TCORE_HOOK_RETURN_STOP_PROPAGATION) {
-				return TCORE_RETURN_SUCCESS;
-			}
+		if (hook->func(s, source, command, data_len, data, hook->user_data) == TCORE_HOOK_RETURN_STOP_PROPAGATION) {
+			return TCORE_RETURN_SUCCESS;
 		}
 	}
 
@@ -488,6 +690,7 @@ TReturn tcore_server_add_request_hook(Server *s,
 		TcoreServerRequestHook func, void *user_data)
 {
 	struct hook_request_type *hook;
+	GSList *list;
 
 	if (!s || !func)
 		return TCORE_RETURN_EINVAL;
@@ -502,27 +705,41 @@ TReturn tcore_server_add_request_hook(Server *s,
 
 	s->hook_list_request = g_slist_append(s->hook_list_request, hook);
 
+	list = g_hash_table_lookup(s->hook_table_request, GUINT_TO_POINTER(command));
+	list = g_slist_append(list, hook);
+	g_hash_table_steal(s->hook_table_request, GUINT_TO_POINTER(command));
+	g_hash_table_insert(s->hook_table_request, GUINT_TO_POINTER(command), list);
+
 	return TCORE_RETURN_SUCCESS;
 }
 
 TReturn tcore_server_remove_request_hook(Server *s, TcoreServerRequestHook func)
 {
 	struct hook_request_type *hook;
-	GSList *list;
+	GSList *list, *next, *cmd_list;
+	gpointer key;
 
 	if (!s)
 		return TCORE_RETURN_EINVAL;
 
-	for (list = s->hook_list_request; list; list = list->next) {
+	for (list = s->hook_list_request; list; list = next) {
+		next = list->next;
+
 		hook = list->data;
 		if (!hook) {
 			continue;
 		}
 
 		if (hook->func == func) {
-			s->hook_list_request = g_slist_remove(s->hook_list_request, hook);
+			key = GUINT_TO_POINTER(hook->command);
+			cmd_list = g_hash_table_lookup(s->hook_table_request, key);
+			cmd_list = g_slist_remove(cmd_list, hook);
+			g_hash_table_steal(s->hook_table_request, key);
+			if (cmd_list)
+				g_hash_table_insert(s->hook_table_request, key, cmd_list);
+
+			s->hook_list_request = g_slist_delete_link(s->hook_list_request, list);
 			free(hook);
-			list = s->hook_list_request;
 		}
 	}
 
@@ -534,6 +751,7 @@ TReturn tcore_server_add_notification_hook(Server *s,
 		TcoreServerNotificationHook func, void *user_data)
 {
 	struct hook_notification_type *hook;
+	GSList *list;
 
 	if (!s || !func)
 		return TCORE_RETURN_EINVAL;
@@ -548,6 +766,11 @@ TReturn tcore_server_add_notification_hook(Server *s,
 
 	s->hook_list_notification = g_slist_append(s->hook_list_notification, hook);
 
+	list = g_hash_table_lookup(s->hook_table_notification, GUINT_TO_POINTER(command));
+	list = g_slist_append(list, hook);
+	g_hash_table_steal(s->hook_table_notification, GUINT_TO_POINTER(command));
+	g_hash_table_insert(s->hook_table_notification, GUINT_TO_POINTER(command), list);
+
 	return TCORE_RETURN_SUCCESS;
 }
 
@@ -555,21 +778,30 @@ TReturn tcore_server_remove_notification_hook(Server *s,
 		TcoreServerNotificationHook func)
 {
 	struct hook_notification_type *hook;
-	GSList *list;
+	GSList *list, *next, *cmd_list;
+	gpointer key;
 
 	if (!s)
 		return TCORE_RETURN_EINVAL;
 
-	for (list = s->hook_list_notification; list; list = list->next) {
+	for (list = s->hook_list_notification; list; list = next) {
+		next = list->next;
+
 		hook = list->data;
 		if (!hook) {
 			continue;
 		}
 
 		if (hook->func == func) {
-			s->hook_list_notification = g_slist_remove(s->hook_list_notification, hook);
+			key = GUINT_TO_POINTER(hook->command);
+			cmd_list = g_hash_table_lookup(s->hook_table_notification, key);
+			cmd_list = g_slist_remove(cmd_list, hook);
+			g_hash_table_steal(s->hook_table_notification, key);
+			if (cmd_list)
+				g_hash_table_insert(s->hook_table_notification, key, cmd_list);
+
+			s->hook_list_notification = g_slist_delete_link(s->hook_list_notification, list);
 			free(hook);
-			list = s->hook_list_notification;
 		}
 	}
 
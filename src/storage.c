@@ -32,9 +32,28 @@
 struct tcore_storage_type {
 	const char *name;
 	struct storage_operations *ops;
+	TcoreStorageBatchWriter set_batch;
+	struct storage_statement_operations *stmt_ops;
 	GHashTable *callback;
 
+	/*
+	 * write-back cache, only keys with a write policy are in it. Sets may
+	 * come from plugin workers while the write timers run on the context
+	 * of parent_plugin, cache_lock serializes both.
+	 */
+	GHashTable *cache;
+	struct tcore_storage_cache_stats cache_stats;
+	GRecMutex cache_lock;
+
+	/* prepared statements, keyed on handle and query text */
+	GHashTable *statements;
+	/* every statement handed out and not released yet, cached or not */
+	GSList *statements_in_use;
+
 	TcorePlugin *parent_plugin;
+
+	/* tcore_storage_free() and every cache entry hold one */
+	gint ref_count;
 };
 
 struct storage_callback_type{
@@ -42,6 +61,462 @@ struct storage_callback_type{
 	void *user_data;
 };
 
+struct tcore_storage_statement_type {
+	Storage *strg;
+	void *handle;
+	char *query;
+	void *stmt;        /* backend statement */
+	gboolean cached;   /* owned by strg->statements */
+	gboolean in_use;
+};
+
+#define STORAGE_KEY_TYPE(key) ((key) & 0xff000000)
+
+/*
+ * Entries live until tcore_storage_free(), removing a policy only
+ * deactivates them. The cache and every pending write timer hold a
+ * reference, and each entry holds one on its Storage: a timer callback
+ * blocked on cache_lock while the Storage is freed on another thread
+ * still finds both, sees its source destroyed and drops the last ones.
+ */
+struct storage_cache_type {
+	Storage *strg;
+	gint ref_count;
+	enum tcore_storage_key key;
+	gboolean active;
+	enum tcore_storage_write_policy policy;
+	unsigned int interval;
+	guint timer;
+
+	gboolean valid; /* value mirrors the backend, or will once written */
+	gboolean dirty; /* value not written to the backend yet */
+	union {
+		int i;
+		gboolean b;
+		char *s;
+	} value;
+};
+
+static void _cache_clear_value(struct storage_cache_type *entry)
+{
+	if (STORAGE_KEY_TYPE(entry->key) == STORAGE_KEY_STRING && entry->value.s) {
+		free(entry->value.s);
+		entry->value.s = NULL;
+	}
+
+	entry->valid = FALSE;
+}
+
+static void _storage_unref(Storage *strg)
+{
+	if (!g_atomic_int_dec_and_test(&strg->ref_count))
+		return;
+
+	g_rec_mutex_clear(&strg->cache_lock);
+
+	if (strg->name)
+		free((void *)strg->name);
+
+	free(strg);
+}
+
+static struct storage_cache_type *_cache_ref(struct storage_cache_type *entry)
+{
+	g_atomic_int_inc(&entry->ref_count);
+
+	return entry;
+}
+
+static void _cache_unref(gpointer data)
+{
+	struct storage_cache_type *entry = data;
+
+	if (!g_atomic_int_dec_and_test(&entry->ref_count))
+		return;
+
+	_cache_clear_value(entry);
+	_storage_unref(entry->strg);
+	free(entry);
+}
+
+static void _cache_cancel_timer(struct storage_cache_type *entry)
+{
+	if (!entry->timer)
+		return;
+
+	tcore_plugin_remove_source(entry->strg->parent_plugin, entry->timer);
+	entry->timer = 0;
+}
+
+/* cache_lock must be held */
+static struct storage_cache_type *_cache_lookup(Storage *strg,
+		enum tcore_storage_key key)
+{
+	struct storage_cache_type *entry;
+
+	if (!strg->cache)
+		return NULL;
+
+	entry = g_hash_table_lookup(strg->cache, GUINT_TO_POINTER(key));
+	if (!entry || !entry->active)
+		return NULL;
+
+	return entry;
+}
+
+static void _cache_load(Storage *strg, struct storage_cache_type *entry)
+{
+	_cache_clear_value(entry);
+
+	switch (STORAGE_KEY_TYPE(entry->key)) {
+		case STORAGE_KEY_INT:
+			entry->value.i = strg->ops->get_int(strg, entry->key);
+			entry->valid = TRUE;
+			break;
+
+		case STORAGE_KEY_BOOL:
+			entry->value.b = strg->ops->get_bool(strg, entry->key);
+			entry->valid = TRUE;
+			break;
+
+		case STORAGE_KEY_STRING:
+			entry->value.s = strg->ops->get_string(strg, entry->key);
+			entry->valid = (entry->value.s != NULL);
+			break;
+
+		default:
+			break;
+	}
+}
+
+/* TRUE when a notified value (GVariant, may be NULL) is the cached one */
+static gboolean _cache_matches(struct storage_cache_type *entry, void *value)
+{
+	GVariant *v = value;
+
+	if (!entry->valid || !v)
+		return FALSE;
+
+	switch (STORAGE_KEY_TYPE(entry->key)) {
+		case STORAGE_KEY_INT:
+			return g_variant_is_of_type(v, G_VARIANT_TYPE_INT32)
+				&& g_variant_get_int32(v) == entry->value.i;
+
+		case STORAGE_KEY_BOOL:
+			return g_variant_is_of_type(v, G_VARIANT_TYPE_BOOLEAN)
+				&& !g_variant_get_boolean(v) == !entry->value.b;
+
+		case STORAGE_KEY_STRING:
+			return g_variant_is_of_type(v, G_VARIANT_TYPE_STRING)
+				&& g_strcmp0(g_variant_get_string(v, NULL), entry->value.s) == 0;
+
+		default:
+			break;
+	}
+
+	return FALSE;
+}
+
+static void _cache_fetch(Storage *strg, struct storage_cache_type *entry)
+{
+	if (entry->valid) {
+		strg->cache_stats.hits++;
+		return;
+	}
+
+	strg->cache_stats.misses++;
+	_cache_load(strg, entry);
+}
+
+static gboolean _cache_write(Storage *strg, struct storage_cache_type *entry)
+{
+	gboolean ret = FALSE;
+
+	entry->dirty = FALSE;
+
+	switch (STORAGE_KEY_TYPE(entry->key)) {
+		case STORAGE_KEY_INT:
+			ret = strg->ops->set_int(strg, entry->key, entry->value.i);
+			break;
+
+		case STORAGE_KEY_BOOL:
+			ret = strg->ops->set_bool(strg, entry->key, entry->value.b);
+			break;
+
+		case STORAGE_KEY_STRING:
+			ret = strg->ops->set_string(strg, entry->key, entry->value.s);
+			break;
+
+		default:
+			break;
+	}
+
+	if (ret == FALSE) {
+		/* backend state unknown, read it again on next get */
+		err("write of key(0x%x) failed", entry->key);
+		strg->cache_stats.failed++;
+		_cache_clear_value(entry);
+		return FALSE;
+	}
+
+	strg->cache_stats.writes++;
+	return TRUE;
+}
+
+static gboolean _on_cache_timeout(gpointer user_data);
+
+/* As tcore_plugin_add_timeout(), the source holds a reference on the entry */
+static guint _cache_add_timer(struct storage_cache_type *entry)
+{
+	GSource *source;
+	guint id;
+
+	source = g_timeout_source_new(entry->interval);
+	if (!source)
+		return 0;
+
+	g_source_set_callback(source, _on_cache_timeout, _cache_ref(entry), _cache_unref);
+	id = g_source_attach(source,
+			tcore_plugin_ref_main_context(entry->strg->parent_plugin));
+	g_source_unref(source);
+
+	return id;
+}
+
+static gboolean _on_cache_timeout(gpointer user_data)
+{
+	struct storage_cache_type *entry = user_data;
+	Storage *strg = entry->strg;
+
+	g_rec_mutex_lock(&strg->cache_lock);
+
+	/* cancelled by another thread while waiting for the lock */
+	if (g_source_is_destroyed(g_main_current_source())) {
+		g_rec_mutex_unlock(&strg->cache_lock);
+		return FALSE;
+	}
+
+	entry->timer = 0;
+
+	if (entry->dirty)
+		_cache_write(strg, entry);
+
+	g_rec_mutex_unlock(&strg->cache_lock);
+
+	return FALSE;
+}
+
+/*
+ * Stores v in the entry. TCORE_RETURN_EALREADY when the cache already
+ * holds that value, nothing is changed then.
+ */
+static TReturn _cache_assign(Storage *strg, struct storage_cache_type *entry,
+		const struct tcore_storage_value *v)
+{
+	char *copy = NULL;
+
+	switch (STORAGE_KEY_TYPE(entry->key)) {
+		case STORAGE_KEY_INT:
+			if (entry->valid && entry->value.i == v->value.i)
+				break;
+
+			entry->value.i = v->value.i;
+			return TCORE_RETURN_SUCCESS;
+
+		case STORAGE_KEY_BOOL:
+			if (entry->valid && !entry->value.b == !v->value.b)
+				break;
+
+			entry->value.b = v->value.b;
+			return TCORE_RETURN_SUCCESS;
+
+		case STORAGE_KEY_STRING:
+			if (entry->valid && g_strcmp0(entry->value.s, v->value.s) == 0)
+				break;
+
+			if (v->value.s) {
+				copy = strdup(v->value.s);
+				if (!copy)
+					return TCORE_RETURN_ENOMEM;
+			}
+
+			_cache_clear_value(entry);
+			entry->value.s = copy;
+			return TCORE_RETURN_SUCCESS;
+
+		default:
+			return TCORE_RETURN_EINVAL;
+	}
+
+	strg->cache_stats.unchanged++;
+	return TCORE_RETURN_EALREADY;
+}
+
+/*
+ * Marks a freshly assigned value pending. Returns TRUE when the policy
+ * wants it written now, otherwise a timer takes care of it.
+ */
+static gboolean _cache_mark_dirty(Storage *strg, struct storage_cache_type *entry)
+{
+	if (entry->dirty)
+		strg->cache_stats.coalesced++;
+
+	entry->valid = TRUE;
+	entry->dirty = TRUE;
+
+	switch (entry->policy) {
+		case TCORE_STORAGE_WRITE_DEBOUNCE:
+			_cache_cancel_timer(entry);
+			entry->timer = _cache_add_timer(entry);
+			return FALSE;
+
+		case TCORE_STORAGE_WRITE_PERIODIC:
+			if (!entry->timer)
+				entry->timer = _cache_add_timer(entry);
+			return FALSE;
+
+		case TCORE_STORAGE_WRITE_IMMEDIATE:
+		default:
+			break;
+	}
+
+	return TRUE;
+}
+
+static gboolean _cache_set(Storage *strg, struct storage_cache_type *entry,
+		const struct tcore_storage_value *v)
+{
+	TReturn ret;
+
+	ret = _cache_assign(strg, entry, v);
+	if (ret == TCORE_RETURN_EALREADY)
+		return TRUE;
+	else if (ret != TCORE_RETURN_SUCCESS)
+		return FALSE;
+
+	if (_cache_mark_dirty(strg, entry) == FALSE)
+		return TRUE;
+
+	return _cache_write(strg, entry);
+}
+
+/*
+ * Handles a set of a cached key. Returns FALSE when the key is not
+ * cached and the caller has to go to the backend, *ret is the result
+ * of the set otherwise.
+ */
+static gboolean _cache_try_set(Storage *strg,
+		const struct tcore_storage_value *v, gboolean *ret)
+{
+	struct storage_cache_type *entry;
+
+	g_rec_mutex_lock(&strg->cache_lock);
+
+	entry = _cache_lookup(strg, v->key);
+	if (entry)
+		*ret = _cache_set(strg, entry, v);
+
+	g_rec_mutex_unlock(&strg->cache_lock);
+
+	return entry != NULL;
+}
+
+/*
+ * Handles a get of a cached key, a string value is returned as an
+ * allocated copy. Returns FALSE when the key is not cached.
+ */
+static gboolean _cache_try_get(Storage *strg, enum tcore_storage_key key,
+		struct tcore_storage_value *v)
+{
+	struct storage_cache_type *entry;
+
+	memset(v, 0, sizeof(struct tcore_storage_value));
+	v->key = key;
+
+	g_rec_mutex_lock(&strg->cache_lock);
+
+	entry = _cache_lookup(strg, key);
+	if (entry) {
+		_cache_fetch(strg, entry);
+
+		switch (STORAGE_KEY_TYPE(key)) {
+			case STORAGE_KEY_INT:
+				v->value.i = entry->value.i;
+				break;
+
+			case STORAGE_KEY_BOOL:
+				v->value.b = entry->value.b;
+				break;
+
+			case STORAGE_KEY_STRING:
+				if (entry->valid && entry->value.s)
+					v->value.s = strdup(entry->value.s);
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	g_rec_mutex_unlock(&strg->cache_lock);
+
+	return entry != NULL;
+}
+
+/* cache_lock must be held */
+static void _cache_flush_entry(gpointer key, gpointer value, gpointer user_data)
+{
+	struct storage_cache_type *entry = value;
+
+	_cache_cancel_timer(entry);
+
+	if (entry->dirty)
+		_cache_write(entry->strg, entry);
+}
+
+static guint _statement_hash(gconstpointer key)
+{
+	const struct tcore_storage_statement_type *st = key;
+
+	return g_str_hash(st->query) ^ g_direct_hash(st->handle);
+}
+
+static gboolean _statement_equal(gconstpointer a, gconstpointer b)
+{
+	const struct tcore_storage_statement_type *sa = a;
+	const struct tcore_storage_statement_type *sb = b;
+
+	return sa->handle == sb->handle && g_strcmp0(sa->query, sb->query) == 0;
+}
+
+static void _statement_free(gpointer data)
+{
+	struct tcore_storage_statement_type *st = data;
+
+	if (st->in_use)
+		dbg("statement [%s] still in use", st->query);
+
+	st->strg->stmt_ops->finalize_query(st->strg, st->stmt);
+
+	free(st->query);
+	free(st);
+}
+
+static gboolean _statement_match_handle(gpointer key, gpointer value,
+		gpointer user_data)
+{
+	struct tcore_storage_statement_type *st = value;
+
+	return st->handle == user_data;
+}
+
+static gint _statement_compare_handle(gconstpointer a, gconstpointer b)
+{
+	const struct tcore_storage_statement_type *st = a;
+
+	return st->handle == b ? 0 : 1;
+}
+
 Storage *tcore_storage_new(TcorePlugin *plugin, const char *name,
 		struct storage_operations *ops)
 {
@@ -56,7 +531,9 @@ Storage *tcore_storage_new(TcorePlugin *plugin, const char *name,
 
 	strg->parent_plugin = plugin;
 	strg->ops = ops;
-	strg->callback = g_hash_table_new_full(g_str_hash,g_str_equal, g_free, NULL);
+	strg->callback = g_hash_table_new(g_direct_hash, g_direct_equal);
+	g_rec_mutex_init(&strg->cache_lock);
+	strg->ref_count = 1;
 
 	tcore_server_add_storage(tcore_plugin_ref_server(plugin), strg);
 
@@ -68,10 +545,26 @@ void tcore_storage_free(Storage *strg)
 	if (!strg)
 		return;
 
-	if (strg->name)
-		free((void *)strg->name);
+	if (strg->cache) {
+		/* writes pending values out and cancels every timer */
+		tcore_storage_flush(strg);
 
-	free(strg);
+		g_rec_mutex_lock(&strg->cache_lock);
+		g_hash_table_destroy(strg->cache);
+		strg->cache = NULL;
+		g_rec_mutex_unlock(&strg->cache_lock);
+	}
+
+	if (strg->statements) {
+		g_hash_table_destroy(strg->statements);
+		strg->statements = NULL;
+	}
+
+	g_slist_free(strg->statements_in_use);
+	strg->statements_in_use = NULL;
+
+	/* the lock goes with the last timer callback still holding an entry */
+	_storage_unref(strg);
 }
 
 const char *tcore_storage_ref_name(Storage *strg)
@@ -82,6 +575,32 @@ const char *tcore_storage_ref_name(Storage *strg)
 	return strg->name;
 }
 
+TReturn tcore_storage_set_batch_writer(Storage *strg,
+		TcoreStorageBatchWriter func)
+{
+	if (!strg)
+		return TCORE_RETURN_EINVAL;
+
+	strg->set_batch = func;
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+TReturn tcore_storage_set_statement_operations(Storage *strg,
+		struct storage_statement_operations *ops)
+{
+	if (!strg)
+		return TCORE_RETURN_EINVAL;
+
+	/* cached statements are finalized through the ops they came from */
+	if (strg->statements && g_hash_table_size(strg->statements) > 0)
+		return TCORE_RETURN_EPERM;
+
+	strg->stmt_ops = ops;
+
+	return TCORE_RETURN_SUCCESS;
+}
+
 void *tcore_storage_create_handle(Storage *strg, const char *path)
 {
 	if (!path)
@@ -103,95 +622,294 @@ gboolean tcore_storage_remove_handle(Storage *strg, void *handle)
 		return FALSE;
 	}
 
+	/* statements must not outlive their database handle */
+	if (g_slist_find_custom(strg->statements_in_use, handle, _statement_compare_handle)) {
+		err("statements on the handle are still in use");
+		return FALSE;
+	}
+
+	if (strg->statements)
+		g_hash_table_foreach_remove(strg->statements, _statement_match_handle, handle);
+
 	return strg->ops->remove_handle(strg, handle);
 }
 
 gboolean tcore_storage_set_int(Storage *strg, enum tcore_storage_key key,
 		int value)
 {
+	struct tcore_storage_value v;
+	gboolean ret;
+
 	if (!strg || !strg->ops || !strg->ops->set_int) {
 		return FALSE;
 	}
 
+	v.key = key;
+	v.value.i = value;
+	if (_cache_try_set(strg, &v, &ret))
+		return ret;
+
 	return strg->ops->set_int(strg, key, value);
 }
 
 gboolean tcore_storage_set_string(Storage *strg, enum tcore_storage_key key,
 		const char *value)
 {
+	struct tcore_storage_value v;
+	gboolean ret;
+
 	if (!strg || !strg->ops || !strg->ops->set_string) {
 		return FALSE;
 	}
 
+	v.key = key;
+	v.value.s = value;
+	if (_cache_try_set(strg, &v, &ret))
+		return ret;
+
 	return strg->ops->set_string(strg, key, value);
 }
 
 gboolean tcore_storage_set_bool(Storage *strg, enum tcore_storage_key key,
 		gboolean value)
 {
+	struct tcore_storage_value v;
+	gboolean ret;
+
 	if (!strg || !strg->ops || !strg->ops->set_bool) {
 		return FALSE;
 	}
 
+	v.key = key;
+	v.value.b = value;
+	if (_cache_try_set(strg, &v, &ret))
+		return ret;
+
 	return strg->ops->set_bool(strg, key, value);
 }
 
+static gboolean _storage_set_value(Storage *strg,
+		const struct tcore_storage_value *v)
+{
+	switch (STORAGE_KEY_TYPE(v->key)) {
+		case STORAGE_KEY_INT:
+			return strg->ops->set_int(strg, v->key, v->value.i);
+
+		case STORAGE_KEY_BOOL:
+			return strg->ops->set_bool(strg, v->key, v->value.b);
+
+		case STORAGE_KEY_STRING:
+			return strg->ops->set_string(strg, v->key, v->value.s);
+
+		default:
+			break;
+	}
+
+	return FALSE;
+}
+
+gboolean tcore_storage_set_batch(Storage *strg,
+		const struct tcore_storage_value *values, unsigned int count)
+{
+	struct tcore_storage_value *pending;
+	struct storage_cache_type **entries;
+	struct storage_cache_type *entry;
+	unsigned int pending_cnt = 0;
+	unsigned int i;
+	gboolean ret = TRUE;
+	gboolean stored;
+	TReturn assigned;
+
+	if (!strg || !strg->ops || !values || count == 0)
+		return FALSE;
+
+	for (i = 0; i < count; i++) {
+		switch (STORAGE_KEY_TYPE(values[i].key)) {
+			case STORAGE_KEY_INT:
+				ret = strg->ops->set_int != NULL;
+				break;
+
+			case STORAGE_KEY_BOOL:
+				ret = strg->ops->set_bool != NULL;
+				break;
+
+			case STORAGE_KEY_STRING:
+				ret = strg->ops->set_string != NULL;
+				break;
+
+			default:
+				ret = FALSE;
+				break;
+		}
+
+		if (ret == FALSE && !strg->set_batch) {
+			dbg("key(0x%x) can not be stored", values[i].key);
+			return FALSE;
+		}
+	}
+
+	pending = calloc(sizeof(struct tcore_storage_value), count);
+	entries = calloc(sizeof(struct storage_cache_type *), count);
+	if (!pending || !entries) {
+		free(pending);
+		free(entries);
+		return FALSE;
+	}
+
+	/*
+	 * Cached keys drop out when unchanged and already stored. Every other
+	 * value goes to the backend together, a debounced or periodic write
+	 * policy is overridden so no key of the batch lands on its own later.
+	 */
+	ret = TRUE;
+	g_rec_mutex_lock(&strg->cache_lock);
+
+	for (i = 0; i < count; i++) {
+		entry = _cache_lookup(strg, values[i].key);
+		if (entry) {
+			assigned = _cache_assign(strg, entry, &values[i]);
+			if (assigned == TCORE_RETURN_EALREADY && !entry->dirty)
+				continue;
+
+			if (assigned != TCORE_RETURN_SUCCESS
+					&& assigned != TCORE_RETURN_EALREADY) {
+				ret = FALSE;
+				continue;
+			}
+
+			if (entry->dirty && assigned == TCORE_RETURN_SUCCESS)
+				strg->cache_stats.coalesced++;
+
+			_cache_cancel_timer(entry);
+			entry->valid = TRUE;
+			entry->dirty = TRUE;
+		}
+
+		entries[pending_cnt] = entry;
+		pending[pending_cnt++] = values[i];
+	}
+
+	if (pending_cnt == 0)
+		goto out;
+
+	if (strg->set_batch) {
+		/* ret may already be FALSE for a value the cache failed to take */
+		stored = strg->set_batch(strg, pending, pending_cnt);
+		if (stored == FALSE)
+			ret = FALSE;
+
+		for (i = 0; i < pending_cnt; i++) {
+			if (!entries[i])
+				continue;
+
+			entries[i]->dirty = FALSE;
+			if (stored) {
+				strg->cache_stats.writes++;
+			} else {
+				strg->cache_stats.failed++;
+				_cache_clear_value(entries[i]);
+			}
+		}
+	} else {
+		for (i = 0; i < pending_cnt; i++) {
+			if (entries[i]) {
+				if (_cache_write(strg, entries[i]) == FALSE)
+					ret = FALSE;
+			} else if (_storage_set_value(strg, &pending[i]) == FALSE) {
+				ret = FALSE;
+			}
+		}
+	}
+
+out:
+	g_rec_mutex_unlock(&strg->cache_lock);
+
+	free(pending);
+	free(entries);
+
+	return ret;
+}
+
 int tcore_storage_get_int(Storage *strg, enum tcore_storage_key key)
 {
+	struct tcore_storage_value v;
+
 	if (!strg || !strg->ops || !strg->ops->get_int) {
 		return FALSE;
 	}
 
+	if (_cache_try_get(strg, key, &v))
+		return v.value.i;
+
 	return strg->ops->get_int(strg, key);
 }
 
 char *tcore_storage_get_string(Storage *strg, enum tcore_storage_key key)
 {
+	struct tcore_storage_value v;
+
 	if (!strg || !strg->ops || !strg->ops->get_string) {
 		return FALSE;
 	}
 
+	if (_cache_try_get(strg, key, &v))
+		return (char *)v.value.s;
+
 	return strg->ops->get_string(strg, key);
 }
 
 gboolean tcore_storage_get_bool(Storage *strg, enum tcore_storage_key key)
 {
+	struct tcore_storage_value v;
+
 	if (!strg || !strg->ops || !strg->ops->get_bool) {
 		return FALSE;
 	}
 
+	if (_cache_try_get(strg, key, &v))
+		return v.value.b;
+
 	return strg->ops->get_bool(strg, key);
 }
 
 static void tcore_storage_vkey_callback_dispatcher(Storage *strg,
 		enum tcore_storage_key key, void *value)
 {
-	gpointer tmp = NULL;
-	gchar *key_gen = NULL;
+	GSList *cb_data = NULL;
+	GSList *next = NULL;
 	struct storage_callback_type *tmp_cb = NULL;
-
-	key_gen = g_strdup_printf("%d", key);
-	tmp = g_hash_table_lookup(strg->callback, key_gen);
-
-	if (tmp != NULL) {
-
-		GSList *cb_data = (GSList *) tmp;
-
-		do {
-			tmp_cb = cb_data->data;
-			tmp_cb->cb_fn(key, value, tmp_cb->user_data);
-		} while ((cb_data = g_slist_next(cb_data)));
+	struct storage_cache_type *entry;
+
+	/*
+	 * Changed outside, re-read it so later gets and unchanged-value
+	 * checks see what the backend holds. The echo of our own write
+	 * carries the cached value and needs no read. A pending write is
+	 * newer from our point of view and wins.
+	 */
+	g_rec_mutex_lock(&strg->cache_lock);
+	entry = _cache_lookup(strg, key);
+	if (entry && !entry->dirty && !_cache_matches(entry, value))
+		_cache_load(strg, entry);
+	g_rec_mutex_unlock(&strg->cache_lock);
+
+	cb_data = g_hash_table_lookup(strg->callback, GUINT_TO_POINTER(key));
+
+	while (cb_data) {
+		/* the callback may remove itself */
+		next = g_slist_next(cb_data);
+		tmp_cb = cb_data->data;
+		tmp_cb->cb_fn(key, value, tmp_cb->user_data);
+		cb_data = next;
 	}
 
-	g_free(key_gen);
 	return;
 }
 
 gboolean tcore_storage_set_key_callback(Storage *strg,
 		enum tcore_storage_key key, TcoreStorageKeyCallback cb, void *user_data)
 {
-	gpointer tmp = NULL;
-	gchar *key_gen = NULL;
+	GSList *list = NULL;
+	GSList *cb_data = NULL;
 	struct storage_callback_type *strg_cb_data = NULL;
 	struct storage_callback_type *tmp_cb = NULL;
 
@@ -200,83 +918,196 @@ gboolean tcore_storage_set_key_callback(Storage *strg,
 		return FALSE;
 	}
 
+	list = g_hash_table_lookup(strg->callback, GUINT_TO_POINTER(key));
+	for (cb_data = list; cb_data; cb_data = g_slist_next(cb_data)) {
+		tmp_cb = cb_data->data;
+		if (tmp_cb->cb_fn == cb)
+			return FALSE;
+	}
+
 	strg_cb_data = g_new0(struct storage_callback_type, 1);
 	strg_cb_data->cb_fn = cb;
 	strg_cb_data->user_data = user_data;
 
-	key_gen = g_strdup_printf("%d", key);
-	tmp = g_hash_table_lookup(strg->callback, key_gen);
-	if (tmp != NULL) {
-		GSList *cb_data = (GSList *) tmp;
-
-		do {
-			tmp_cb = cb_data->data;
-			if (tmp_cb->cb_fn == cb) {
-				g_free(key_gen);
-				g_free(strg_cb_data);
-				return FALSE;
-			}
-
-		} while ((cb_data = g_slist_next(cb_data)));
-
-		tmp = g_slist_append( (GSList *)tmp, strg_cb_data);
+	if (list != NULL) {
+		list = g_slist_append(list, strg_cb_data);
 	}
 	else {
-		GSList *data = NULL;
-		data = g_slist_append(data, strg_cb_data);
-		g_hash_table_insert(strg->callback, g_strdup(key_gen), data);
+		list = g_slist_append(list, strg_cb_data);
+		g_hash_table_insert(strg->callback, GUINT_TO_POINTER(key), list);
 		strg->ops->set_key_callback(strg, key, tcore_storage_vkey_callback_dispatcher);
 	}
 
-	g_free(key_gen);
 	return TRUE;
 }
 
 gboolean tcore_storage_remove_key_callback(Storage *strg,
 		enum tcore_storage_key key, TcoreStorageKeyCallback cb)
 {
-	gpointer tmp = NULL;
-	gchar *key_gen = NULL;
+	GSList *list = NULL;
 	GSList *cb_data = NULL;
-	int cb_cnt = 0;
 	struct storage_callback_type *tmp_cb = NULL;
 
 	if (!strg || !strg->ops || !strg->ops->remove_key_callback) {
 		return FALSE;
 	}
 
-	key_gen = g_strdup_printf("%d", key);
-	tmp = g_hash_table_lookup(strg->callback, key_gen);
-
-	if (tmp == NULL){
-		g_free(key_gen);
+	list = g_hash_table_lookup(strg->callback, GUINT_TO_POINTER(key));
+	if (list == NULL)
 		return FALSE;
-	}
 
-	cb_data = (GSList *) tmp;
-
-	do {
+	for (cb_data = list; cb_data; cb_data = g_slist_next(cb_data)) {
 		tmp_cb = cb_data->data;
 		if (tmp_cb->cb_fn == cb) {
-			tmp = g_slist_remove((GSList *) tmp, cb_data->data);
-			g_free(cb_data->data);
+			list = g_slist_delete_link(list, cb_data);
+			g_free(tmp_cb);
 			break;
 		}
+	}
 
-	} while ((cb_data = g_slist_next(cb_data)));
-
-	cb_cnt = g_slist_length( (GSList *) tmp );
-	dbg("glist cnt (%d)", cb_cnt);
+	dbg("glist cnt (%d)", g_slist_length(list));
 
-	if(cb_cnt == 0){
-		g_hash_table_remove(strg->callback, key_gen);
+	if (list == NULL) {
+		g_hash_table_remove(strg->callback, GUINT_TO_POINTER(key));
 		strg->ops->remove_key_callback(strg, key);
+	} else {
+		/* head may have changed */
+		g_hash_table_insert(strg->callback, GUINT_TO_POINTER(key), list);
 	}
 
-	g_free(key_gen);
 	return TRUE;
 }
 
+TReturn tcore_storage_set_write_policy(Storage *strg,
+		enum tcore_storage_key key,
+		enum tcore_storage_write_policy policy, unsigned int interval_ms)
+{
+	struct storage_cache_type *entry;
+
+	if (!strg || !strg->ops)
+		return TCORE_RETURN_EINVAL;
+
+	if (policy != TCORE_STORAGE_WRITE_IMMEDIATE && interval_ms == 0)
+		return TCORE_RETURN_EINVAL;
+
+	switch (STORAGE_KEY_TYPE(key)) {
+		case STORAGE_KEY_INT:
+			if (!strg->ops->set_int || !strg->ops->get_int)
+				return TCORE_RETURN_EINVAL;
+			break;
+
+		case STORAGE_KEY_BOOL:
+			if (!strg->ops->set_bool || !strg->ops->get_bool)
+				return TCORE_RETURN_EINVAL;
+			break;
+
+		case STORAGE_KEY_STRING:
+			if (!strg->ops->set_string || !strg->ops->get_string)
+				return TCORE_RETURN_EINVAL;
+			break;
+
+		default:
+			return TCORE_RETURN_EINVAL;
+	}
+
+	g_rec_mutex_lock(&strg->cache_lock);
+
+	if (!strg->cache) {
+		strg->cache = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+				NULL, _cache_unref);
+	}
+
+	entry = g_hash_table_lookup(strg->cache, GUINT_TO_POINTER(key));
+	if (entry) {
+		/* pending value goes out under the old policy first */
+		_cache_flush_entry(NULL, entry, NULL);
+	} else {
+		entry = calloc(sizeof(struct storage_cache_type), 1);
+		if (!entry) {
+			g_rec_mutex_unlock(&strg->cache_lock);
+			return TCORE_RETURN_ENOMEM;
+		}
+
+		entry->strg = strg;
+		entry->ref_count = 1;
+		entry->key = key;
+		g_atomic_int_inc(&strg->ref_count);
+		g_hash_table_insert(strg->cache, GUINT_TO_POINTER(key), entry);
+	}
+
+	entry->active = TRUE;
+	entry->policy = policy;
+	entry->interval = interval_ms;
+
+	g_rec_mutex_unlock(&strg->cache_lock);
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+TReturn tcore_storage_remove_write_policy(Storage *strg,
+		enum tcore_storage_key key)
+{
+	struct storage_cache_type *entry;
+
+	if (!strg)
+		return TCORE_RETURN_EINVAL;
+
+	g_rec_mutex_lock(&strg->cache_lock);
+
+	entry = _cache_lookup(strg, key);
+	if (!entry) {
+		g_rec_mutex_unlock(&strg->cache_lock);
+		return TCORE_RETURN_ENOENT;
+	}
+
+	_cache_flush_entry(NULL, entry, NULL);
+	_cache_clear_value(entry);
+	entry->active = FALSE;
+
+	g_rec_mutex_unlock(&strg->cache_lock);
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+TReturn tcore_storage_flush(Storage *strg)
+{
+	unsigned int failed;
+
+	if (!strg)
+		return TCORE_RETURN_EINVAL;
+
+	g_rec_mutex_lock(&strg->cache_lock);
+
+	if (!strg->cache) {
+		g_rec_mutex_unlock(&strg->cache_lock);
+		return TCORE_RETURN_SUCCESS;
+	}
+
+	failed = strg->cache_stats.failed;
+	g_hash_table_foreach(strg->cache, _cache_flush_entry, NULL);
+	failed = strg->cache_stats.failed - failed;
+
+	g_rec_mutex_unlock(&strg->cache_lock);
+
+	if (failed)
+		return TCORE_RETURN_FAILURE;
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+TReturn tcore_storage_get_cache_stats(Storage *strg,
+		struct tcore_storage_cache_stats *stats)
+{
+	if (!strg || !stats)
+		return TCORE_RETURN_EINVAL;
+
+	g_rec_mutex_lock(&strg->cache_lock);
+	memcpy(stats, &strg->cache_stats, sizeof(struct tcore_storage_cache_stats));
+	g_rec_mutex_unlock(&strg->cache_lock);
+
+	return TCORE_RETURN_SUCCESS;
+}
+
 gboolean tcore_storage_update_query_database(Storage *strg, void *handle,
 		const char *query, GHashTable *in_param)
 {
@@ -330,3 +1161,231 @@ gboolean tcore_storage_remove_query_database(Storage *strg, void *handle,
 
 	return strg->ops->remove_query_database(strg, handle, query, in_param);
 }
+
+static gboolean _statement_insert_row(TcoreStorageStatement *st,
+		GHashTable *in_param)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	const char *text;
+
+	if (in_param) {
+		g_hash_table_iter_init(&iter, in_param);
+		while (g_hash_table_iter_next(&iter, &key, &value) == TRUE) {
+			text = value;
+			if (text && text[0] == '\0')
+				text = NULL;
+
+			if (tcore_storage_bind_string(st, atoi(key), text) == FALSE)
+				return FALSE;
+		}
+	}
+
+	return tcore_storage_step_query(st) == TCORE_STORAGE_STEP_DONE;
+}
+
+gboolean tcore_storage_insert_bulk_query_database(Storage *strg, void *handle,
+		const char *query, GSList *in_params)
+{
+	TcoreStorageStatement *st = NULL;
+	GSList *list;
+	gboolean in_transaction = FALSE;
+	gboolean ret = TRUE;
+
+	if (!strg || !handle || !query)
+		return FALSE;
+
+	if (!strg->ops || !strg->ops->insert_query_database) {
+		return FALSE;
+	}
+
+	/*
+	 * One explicit transaction for all rows instead of an implicit one
+	 * per row, and the query compiled once when the backend has
+	 * statements. A backend without transactions still inserts every
+	 * row, just not atomically.
+	 */
+	if (in_params && in_params->next) {
+		in_transaction = tcore_storage_begin_transaction(strg, handle);
+
+		if (strg->stmt_ops && strg->stmt_ops->bind_string && strg->stmt_ops->step_query)
+			st = tcore_storage_prepare_query(strg, handle, query);
+	}
+
+	for (list = in_params; list; list = list->next) {
+		if (st) {
+			ret = _statement_insert_row(st, list->data);
+			tcore_storage_reset_query(st);
+		} else {
+			ret = strg->ops->insert_query_database(strg, handle, query, list->data);
+		}
+
+		if (ret == FALSE) {
+			err("bulk insert failed at row %d", g_slist_position(in_params, list));
+			break;
+		}
+	}
+
+	if (st)
+		tcore_storage_release_query(st);
+
+	if (in_transaction) {
+		if (tcore_storage_end_transaction(strg, handle, ret) == FALSE)
+			ret = FALSE;
+	}
+
+	return ret;
+}
+
+TcoreStorageStatement *tcore_storage_prepare_query(Storage *strg,
+		void *handle, const char *query)
+{
+	struct tcore_storage_statement_type lookup;
+	TcoreStorageStatement *cached;
+	TcoreStorageStatement *st;
+
+	if (!strg || !handle || !query)
+		return NULL;
+
+	if (!strg->stmt_ops || !strg->stmt_ops->prepare_query
+			|| !strg->stmt_ops->finalize_query || !strg->stmt_ops->reset_query) {
+		return NULL;
+	}
+
+	if (!strg->statements) {
+		strg->statements = g_hash_table_new_full(_statement_hash,
+				_statement_equal, NULL, _statement_free);
+	}
+
+	lookup.handle = handle;
+	lookup.query = (char *)query;
+
+	cached = g_hash_table_lookup(strg->statements, &lookup);
+	if (cached && !cached->in_use) {
+		cached->in_use = TRUE;
+		strg->statements_in_use = g_slist_prepend(strg->statements_in_use, cached);
+		return cached;
+	}
+
+	st = calloc(sizeof(struct tcore_storage_statement_type), 1);
+	if (!st)
+		return NULL;
+
+	st->strg = strg;
+	st->handle = handle;
+	st->query = strdup(query);
+	if (!st->query) {
+		free(st);
+		return NULL;
+	}
+
+	st->stmt = strg->stmt_ops->prepare_query(strg, handle, query);
+	if (!st->stmt) {
+		err("prepare failed [%s]", query);
+		free(st->query);
+		free(st);
+		return NULL;
+	}
+
+	st->in_use = TRUE;
+	strg->statements_in_use = g_slist_prepend(strg->statements_in_use, st);
+
+	/* the cached one is busy (nested use), this one goes on release */
+	if (!cached) {
+		st->cached = TRUE;
+		g_hash_table_insert(strg->statements, st, st);
+	}
+
+	return st;
+}
+
+void tcore_storage_release_query(TcoreStorageStatement *stmt)
+{
+	if (!stmt)
+		return;
+
+	stmt->strg->stmt_ops->reset_query(stmt->strg, stmt->stmt);
+	stmt->in_use = FALSE;
+	stmt->strg->statements_in_use = g_slist_remove(stmt->strg->statements_in_use, stmt);
+
+	/* nested duplicate of a cached statement, not kept */
+	if (stmt->cached == FALSE)
+		_statement_free(stmt);
+}
+
+gboolean tcore_storage_reset_query(TcoreStorageStatement *stmt)
+{
+	if (!stmt)
+		return FALSE;
+
+	return stmt->strg->stmt_ops->reset_query(stmt->strg, stmt->stmt);
+}
+
+gboolean tcore_storage_bind_int(TcoreStorageStatement *stmt, int index,
+		int value)
+{
+	if (!stmt || !stmt->strg->stmt_ops->bind_int)
+		return FALSE;
+
+	return stmt->strg->stmt_ops->bind_int(stmt->strg, stmt->stmt, index, value);
+}
+
+gboolean tcore_storage_bind_string(TcoreStorageStatement *stmt, int index,
+		const char *value)
+{
+	if (!stmt || !stmt->strg->stmt_ops->bind_string)
+		return FALSE;
+
+	return stmt->strg->stmt_ops->bind_string(stmt->strg, stmt->stmt, index, value);
+}
+
+enum tcore_storage_step tcore_storage_step_query(TcoreStorageStatement *stmt)
+{
+	if (!stmt || !stmt->strg->stmt_ops->step_query)
+		return TCORE_STORAGE_STEP_ERROR;
+
+	return stmt->strg->stmt_ops->step_query(stmt->strg, stmt->stmt);
+}
+
+int tcore_storage_column_int(TcoreStorageStatement *stmt, int column)
+{
+	if (!stmt || !stmt->strg->stmt_ops->column_int)
+		return 0;
+
+	return stmt->strg->stmt_ops->column_int(stmt->strg, stmt->stmt, column);
+}
+
+const char *tcore_storage_ref_column_string(TcoreStorageStatement *stmt,
+		int column)
+{
+	if (!stmt || !stmt->strg->stmt_ops->column_string)
+		return NULL;
+
+	return stmt->strg->stmt_ops->column_string(stmt->strg, stmt->stmt, column);
+}
+
+gboolean tcore_storage_begin_transaction(Storage *strg, void *handle)
+{
+	if (!strg || !handle)
+		return FALSE;
+
+	if (!strg->stmt_ops || !strg->stmt_ops->begin_transaction
+			|| !strg->stmt_ops->end_transaction) {
+		return FALSE;
+	}
+
+	return strg->stmt_ops->begin_transaction(strg, handle);
+}
+
+gboolean tcore_storage_end_transaction(Storage *strg, void *handle,
+		gboolean commit)
+{
+	if (!strg || !handle)
+		return FALSE;
+
+	if (!strg->stmt_ops || !strg->stmt_ops->end_transaction) {
+		return FALSE;
+	}
+
+	return strg->stmt_ops->end_transaction(strg, handle, commit);
+}
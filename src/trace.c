@@ -0,0 +1,235 @@
+/*
+ * libtcore
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Contact: Ja-young Gu <jygu@samsung.com>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "tcore.h"
+#include "trace.h"
+
+/* per thread, a power of two so the index wraps with a mask */
+#define TRACE_RING_SIZE 4096
+
+struct trace_entry_type {
+	gint64 ts;
+	guint64 id;
+	unsigned int event;
+	unsigned int arg;
+};
+
+struct trace_ring_type {
+	unsigned int tid;
+
+	/* entries ever written, only the owning thread moves it */
+	volatile gint head;
+	struct trace_entry_type entries[TRACE_RING_SIZE];
+};
+
+static const char *trace_event_names[TCORE_TRACE_EVENT_MAX] = {
+	"dispatch",
+	"enqueue",
+	"send",
+	"first_byte",
+	"response",
+	"user_response",
+};
+
+static volatile gint trace_enabled;
+static volatile gint trace_seq;
+static volatile gint trace_tid;
+
+static GPrivate trace_ring_key;
+
+/* rings outlive their threads so they can still be exported */
+static GMutex trace_lock;
+static GSList *trace_rings;
+
+static struct trace_ring_type *_trace_ring(void)
+{
+	struct trace_ring_type *ring;
+
+	ring = g_private_get(&trace_ring_key);
+	if (ring)
+		return ring;
+
+	ring = calloc(sizeof(struct trace_ring_type), 1);
+	if (!ring)
+		return NULL;
+
+	ring->tid = g_atomic_int_add(&trace_tid, 1) + 1;
+
+	g_mutex_lock(&trace_lock);
+	trace_rings = g_slist_append(trace_rings, ring);
+	g_mutex_unlock(&trace_lock);
+
+	g_private_set(&trace_ring_key, ring);
+
+	return ring;
+}
+
+guint64 tcore_trace_new_id(void)
+{
+	guint seq;
+
+	/* never 0, which means untraced */
+	do {
+		seq = (guint)g_atomic_int_add(&trace_seq, 1) + 1;
+	} while (seq == 0);
+
+	/* unique across tcore processes feeding the same trace */
+	return ((guint64)getpid() << 32) | seq;
+}
+
+void tcore_trace_set_enabled(gboolean enable)
+{
+	g_atomic_int_set(&trace_enabled, enable ? 1 : 0);
+}
+
+gboolean tcore_trace_is_enabled(void)
+{
+	return g_atomic_int_get(&trace_enabled) ? TRUE : FALSE;
+}
+
+void tcore_trace_record(guint64 trace_id, enum tcore_trace_event event,
+		unsigned int arg)
+{
+	struct trace_ring_type *ring;
+	struct trace_entry_type *entry;
+	guint head;
+
+	if (!g_atomic_int_get(&trace_enabled) || !trace_id)
+		return;
+
+	if ((unsigned int)event >= TCORE_TRACE_EVENT_MAX)
+		return;
+
+	ring = _trace_ring();
+	if (!ring)
+		return;
+
+	head = (guint)ring->head;
+
+	entry = &ring->entries[head & (TRACE_RING_SIZE - 1)];
+	entry->ts = g_get_monotonic_time();
+	entry->id = trace_id;
+	entry->event = event;
+	entry->arg = arg;
+
+	/* publish only once the entry is complete */
+	g_atomic_int_set(&ring->head, (gint)(head + 1));
+}
+
+static void _trace_export_ring(FILE *fp, struct trace_ring_type *ring,
+		struct trace_entry_type *copy, gboolean *first)
+{
+	struct trace_entry_type *entry;
+	guint head, tail, stable, i;
+	const char *name;
+	const char *ph;
+	int pid = getpid();
+
+	head = (guint)g_atomic_int_get(&ring->head);
+	tail = head > TRACE_RING_SIZE ? head - TRACE_RING_SIZE : 0;
+
+	for (i = tail; i != head; i++)
+		copy[i & (TRACE_RING_SIZE - 1)] = ring->entries[i & (TRACE_RING_SIZE - 1)];
+
+	/*
+	 * The owner kept recording while we copied. Slots it may have been
+	 * rewriting are dropped, everything else is a consistent entry.
+	 */
+	stable = (guint)g_atomic_int_get(&ring->head);
+	if (stable >= TRACE_RING_SIZE && stable - TRACE_RING_SIZE + 1 > tail)
+		tail = stable - TRACE_RING_SIZE + 1;
+
+	for (i = tail; (gint)(head - i) > 0; i++) {
+		entry = &copy[i & (TRACE_RING_SIZE - 1)];
+
+		/* a request span runs from dispatch to the user response */
+		if (entry->event == TCORE_TRACE_DISPATCH) {
+			name = "request";
+			ph = "b";
+		} else if (entry->event == TCORE_TRACE_USER_RESPONSE) {
+			name = "request";
+			ph = "e";
+		} else {
+			name = trace_event_names[entry->event];
+			ph = "n";
+		}
+
+		fprintf(fp, "%s\n{\"name\":\"%s\",\"cat\":\"tcore\",\"ph\":\"%s\","
+				"\"id\":\"0x%llx\",\"ts\":%lld,\"pid\":%d,\"tid\":%u,"
+				"\"args\":{\"event\":\"%s\",\"arg\":%u}}",
+				*first ? "" : ",", name, ph,
+				(unsigned long long)entry->id, (long long)entry->ts,
+				pid, ring->tid, trace_event_names[entry->event],
+				entry->arg);
+
+		*first = FALSE;
+	}
+}
+
+TReturn tcore_trace_export(const char *path)
+{
+	struct trace_entry_type *copy;
+	gboolean first = TRUE;
+	GSList *list;
+	FILE *fp;
+	int ret;
+
+	if (!path)
+		return TCORE_RETURN_EINVAL;
+
+	copy = malloc(sizeof(struct trace_entry_type) * TRACE_RING_SIZE);
+	if (!copy)
+		return TCORE_RETURN_ENOMEM;
+
+	fp = fopen(path, "w");
+	if (!fp) {
+		err("trace export to %s failed", path);
+		free(copy);
+		return TCORE_RETURN_FAILURE;
+	}
+
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+	g_mutex_lock(&trace_lock);
+	for (list = trace_rings; list; list = list->next)
+		_trace_export_ring(fp, list->data, copy, &first);
+	g_mutex_unlock(&trace_lock);
+
+	fprintf(fp, "\n]}\n");
+
+	ret = fclose(fp);
+	free(copy);
+
+	if (ret != 0) {
+		err("trace export to %s failed", path);
+		return TCORE_RETURN_FAILURE;
+	}
+
+	dbg("trace exported to %s", path);
+
+	return TCORE_RETURN_SUCCESS;
+}
@@ -27,9 +27,11 @@
 #include "tcore.h"
 #include "user_request.h"
 #include "communicator.h"
+#include "trace.h"
 
 struct tcore_user_request_type {
 	int ref;
+	guint64 trace_id;
 	struct tcore_user_info ui;
 
 	Communicator *comm;
@@ -58,6 +60,7 @@ UserRequest *tcore_user_request_new(Communicator *comm, const char *modem_name)
 		return NULL;
 
 	ur->comm = comm;
+	ur->trace_id = tcore_trace_new_id();
 
 	if (modem_name)
 		ur->modem_name = strdup(modem_name);
@@ -67,15 +70,27 @@ UserRequest *tcore_user_request_new(Communicator *comm, const char *modem_name)
 	return ur;
 }
 
+static gboolean _user_request_drop_ref(UserRequest *ur)
+{
+	int ref;
+
+	/* requests of worker plugins are released from either thread */
+	do {
+		ref = g_atomic_int_get(&ur->ref);
+		if (ref == 0)
+			return FALSE;
+	} while (!g_atomic_int_compare_and_exchange(&ur->ref, ref, ref - 1));
+
+	return TRUE;
+}
+
 void tcore_user_request_free(UserRequest *ur)
 {
 	if (!ur)
 		return;
 
-	if (ur->ref > 0) {
-		ur->ref--;
+	if (_user_request_drop_ref(ur) == TRUE)
 		return;
-	}
 
 	if (ur->free_hook)
 		ur->free_hook(ur);
@@ -99,7 +114,7 @@ UserRequest *tcore_user_request_ref(UserRequest *ur)
 	if (!ur)
 		return NULL;
 
-	ur->ref++;
+	g_atomic_int_inc(&ur->ref);
 
 	return ur;
 }
@@ -109,9 +124,7 @@ void tcore_user_request_unref(UserRequest *ur)
 	if (!ur)
 		return;
 
-	if (ur->ref > 0)
-		ur->ref--;
-	else
+	if (_user_request_drop_ref(ur) == FALSE)
 		tcore_user_request_free(ur);
 
 	return;
@@ -159,6 +172,22 @@ char *tcore_user_request_get_modem_name(UserRequest *ur)
 	return strdup(ur->modem_name);
 }
 
+guint64 tcore_user_request_get_trace_id(UserRequest *ur)
+{
+	if (!ur)
+		return 0;
+
+	return ur->trace_id;
+}
+
+const char *tcore_user_request_ref_modem_name(UserRequest *ur)
+{
+	if (!ur)
+		return NULL;
+
+	return ur->modem_name;
+}
+
 TReturn tcore_user_request_set_user_info(UserRequest *ur,
 		const struct tcore_user_info *ui)
 {
@@ -203,6 +232,8 @@ TReturn tcore_user_request_send_response(UserRequest *ur,
 		return TCORE_RETURN_EINVAL;
 	}
 
+	tcore_trace_record(ur->trace_id, TCORE_TRACE_USER_RESPONSE, command);
+
 	if (ur->response_hook) {
 		ur->response_hook(ur, command, data_len, data,
 				ur->response_hook_user_data);
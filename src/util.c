@@ -29,6 +29,12 @@
 #include <arpa/inet.h>
 #include <netinet/in.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 #include <glib.h>
 #include <glib-object.h>
 
@@ -182,6 +188,311 @@ static gboolean _tcore_util_marshal_convert_str_to_type(GValue *src,
 	return TRUE;
 }
 
+/*
+ * Binary marshal format:
+ *
+ *   header : 'T' 'M' <version>
+ *   map    : <varint count> <entry>*
+ *   entry  : <varint key_len> <key> <tag> <value>
+ *
+ * char/boolean are one octet, int is a zigzag varint, double is
+ * the IEEE-754 bit pattern in little-endian order, string is
+ * <varint len> <bytes> and a nested object is a map.
+ */
+#define MARSHAL_BINARY_MAGIC_0 'T'
+#define MARSHAL_BINARY_MAGIC_1 'M'
+#define MARSHAL_BINARY_MAX_DEPTH 16
+
+enum marshal_binary_tag {
+	MARSHAL_BINARY_TAG_CHAR = 0x01,
+	MARSHAL_BINARY_TAG_BOOLEAN = 0x02,
+	MARSHAL_BINARY_TAG_INT = 0x03,
+	MARSHAL_BINARY_TAG_DOUBLE = 0x04,
+	MARSHAL_BINARY_TAG_STRING = 0x05,
+	MARSHAL_BINARY_TAG_OBJECT = 0x06,
+};
+
+struct marshal_reader_type {
+	const guint8 *data;
+	gsize len;
+	gsize pos;
+};
+
+static void _marshal_binary_put_varint(GByteArray *buf, guint64 v)
+{
+	guint8 tmp[10];
+	guint n = 0;
+
+	do {
+		tmp[n] = v & 0x7F;
+		v >>= 7;
+		if (v)
+			tmp[n] |= 0x80;
+		n++;
+	} while (v);
+
+	g_byte_array_append(buf, tmp, n);
+}
+
+static gboolean _marshal_binary_get_varint(struct marshal_reader_type *r,
+		guint64 *v)
+{
+	guint64 result = 0;
+	guint shift = 0;
+	guint8 b;
+
+	do {
+		if (r->pos >= r->len || shift > 63)
+			return FALSE;
+
+		b = r->data[r->pos++];
+		result |= (guint64)(b & 0x7F) << shift;
+		shift += 7;
+	} while (b & 0x80);
+
+	*v = result;
+	return TRUE;
+}
+
+static gboolean _marshal_binary_get_bytes(struct marshal_reader_type *r,
+		gsize n, const guint8 **p)
+{
+	if (n > r->len - r->pos)
+		return FALSE;
+
+	*p = r->data + r->pos;
+	r->pos += n;
+	return TRUE;
+}
+
+static gboolean _marshal_binary_put_map(GHashTable *ht, GByteArray *buf)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	gsize key_len;
+
+	_marshal_binary_put_varint(buf, g_hash_table_size(ht));
+
+	g_hash_table_iter_init(&iter, ht);
+	while (g_hash_table_iter_next(&iter, &key, &value) == TRUE) {
+		GValue *gval = value;
+		guint8 octet;
+
+		key_len = strlen(key);
+		_marshal_binary_put_varint(buf, key_len);
+		g_byte_array_append(buf, key, key_len);
+
+		switch (G_VALUE_TYPE(gval)) {
+			case G_TYPE_CHAR:
+				octet = MARSHAL_BINARY_TAG_CHAR;
+				g_byte_array_append(buf, &octet, 1);
+				octet = (guint8) g_value_get_char(gval);
+				g_byte_array_append(buf, &octet, 1);
+				break;
+
+			case G_TYPE_BOOLEAN:
+				octet = MARSHAL_BINARY_TAG_BOOLEAN;
+				g_byte_array_append(buf, &octet, 1);
+				octet = g_value_get_boolean(gval) ? 1 : 0;
+				g_byte_array_append(buf, &octet, 1);
+				break;
+
+			case G_TYPE_INT: {
+				gint32 i = g_value_get_int(gval);
+
+				octet = MARSHAL_BINARY_TAG_INT;
+				g_byte_array_append(buf, &octet, 1);
+				_marshal_binary_put_varint(buf,
+						((guint32) i << 1) ^ (guint32) (i >> 31));
+			}
+				break;
+
+			case G_TYPE_DOUBLE: {
+				gdouble d = g_value_get_double(gval);
+				guint64 bits;
+
+				memcpy(&bits, &d, sizeof(bits));
+				bits = GUINT64_TO_LE(bits);
+
+				octet = MARSHAL_BINARY_TAG_DOUBLE;
+				g_byte_array_append(buf, &octet, 1);
+				g_byte_array_append(buf, (const guint8 *) &bits, sizeof(bits));
+			}
+				break;
+
+			case G_TYPE_STRING: {
+				const gchar *s = g_value_get_string(gval);
+				gsize s_len = s ? strlen(s) : 0;
+
+				octet = MARSHAL_BINARY_TAG_STRING;
+				g_byte_array_append(buf, &octet, 1);
+				_marshal_binary_put_varint(buf, s_len);
+				g_byte_array_append(buf, (const guint8 *) s, s_len);
+			}
+				break;
+
+			default:
+				if (G_VALUE_TYPE(gval) != G_TYPE_HASH_TABLE) {
+					dbg("unsupported marshal type (%s)", G_VALUE_TYPE_NAME(gval));
+					return FALSE;
+				}
+
+				octet = MARSHAL_BINARY_TAG_OBJECT;
+				g_byte_array_append(buf, &octet, 1);
+				if (_marshal_binary_put_map(g_value_get_boxed(gval), buf) == FALSE)
+					return FALSE;
+				break;
+		}
+	}
+
+	return TRUE;
+}
+
+static GHashTable *_marshal_binary_get_map(struct marshal_reader_type *r,
+		guint depth)
+{
+	GHashTable *ht;
+	guint64 count;
+	guint64 i;
+
+	if (depth > MARSHAL_BINARY_MAX_DEPTH)
+		return NULL;
+
+	if (_marshal_binary_get_varint(r, &count) == FALSE)
+		return NULL;
+
+	ht = tcore_util_marshal_create();
+
+	for (i = 0; i < count; i++) {
+		const guint8 *p;
+		guint64 n;
+		gchar *key;
+		GValue *value;
+		gboolean ok = TRUE;
+
+		if (_marshal_binary_get_varint(r, &n) == FALSE
+				|| _marshal_binary_get_bytes(r, n, &p) == FALSE)
+			goto fail;
+
+		key = g_strndup((const gchar *) p, n);
+
+		if (_marshal_binary_get_bytes(r, 1, &p) == FALSE) {
+			g_free(key);
+			goto fail;
+		}
+
+		value = g_new0(GValue, 1);
+
+		switch (*p) {
+			case MARSHAL_BINARY_TAG_CHAR:
+				ok = _marshal_binary_get_bytes(r, 1, &p);
+				if (ok) {
+					g_value_init(value, G_TYPE_CHAR);
+					g_value_set_char(value, (gchar) *p);
+				}
+				break;
+
+			case MARSHAL_BINARY_TAG_BOOLEAN:
+				ok = _marshal_binary_get_bytes(r, 1, &p);
+				if (ok) {
+					g_value_init(value, G_TYPE_BOOLEAN);
+					g_value_set_boolean(value, *p ? TRUE : FALSE);
+				}
+				break;
+
+			case MARSHAL_BINARY_TAG_INT:
+				ok = _marshal_binary_get_varint(r, &n) && n <= G_MAXUINT32;
+				if (ok) {
+					guint32 u = (guint32) n;
+
+					g_value_init(value, G_TYPE_INT);
+					g_value_set_int(value, (gint32) ((u >> 1) ^ (~(u & 1) + 1)));
+				}
+				break;
+
+			case MARSHAL_BINARY_TAG_DOUBLE:
+				ok = _marshal_binary_get_bytes(r, sizeof(guint64), &p);
+				if (ok) {
+					guint64 bits;
+					gdouble d;
+
+					memcpy(&bits, p, sizeof(bits));
+					bits = GUINT64_FROM_LE(bits);
+					memcpy(&d, &bits, sizeof(d));
+
+					g_value_init(value, G_TYPE_DOUBLE);
+					g_value_set_double(value, d);
+				}
+				break;
+
+			case MARSHAL_BINARY_TAG_STRING:
+				ok = _marshal_binary_get_varint(r, &n)
+						&& _marshal_binary_get_bytes(r, n, &p);
+				if (ok) {
+					g_value_init(value, G_TYPE_STRING);
+					g_value_take_string(value, g_strndup((const gchar *) p, n));
+				}
+				break;
+
+			case MARSHAL_BINARY_TAG_OBJECT: {
+				GHashTable *sub_ht = _marshal_binary_get_map(r, depth + 1);
+
+				ok = (sub_ht != NULL);
+				if (ok)
+					_tcore_util_marshal_create_gvalue(value, sub_ht,
+							TCORE_UTIL_MARSHAL_DATA_OBJECT_TYPE);
+			}
+				break;
+
+			default:
+				ok = FALSE;
+				break;
+		}
+
+		if (!ok) {
+			g_free(value);
+			g_free(key);
+			goto fail;
+		}
+
+		g_hash_table_insert(ht, key, value);
+	}
+
+	return ht;
+
+fail:
+	g_hash_table_destroy(ht);
+	return NULL;
+}
+
+static GHashTable *_tcore_util_marshal_dup(GHashTable *src)
+{
+	GHashTable *ht;
+	GHashTableIter iter;
+	gpointer key, value;
+
+	ht = tcore_util_marshal_create();
+
+	g_hash_table_iter_init(&iter, src);
+	while (g_hash_table_iter_next(&iter, &key, &value) == TRUE) {
+		GValue *dest = g_new0(GValue, 1);
+
+		if (G_VALUE_TYPE((GValue *) value) == G_TYPE_HASH_TABLE) {
+			_tcore_util_marshal_create_gvalue(dest,
+					_tcore_util_marshal_dup(g_value_get_boxed(value)),
+					TCORE_UTIL_MARSHAL_DATA_OBJECT_TYPE);
+		}
+		else {
+			g_value_init(dest, G_VALUE_TYPE((GValue *) value));
+			g_value_copy(value, dest);
+		}
+
+		g_hash_table_insert(ht, g_strdup(key), dest);
+	}
+
+	return ht;
+}
+
 TReturn tcore_util_netif_up(const char *name)
 {
 	int ret;
@@ -456,225 +767,926 @@ unsigned char *tcore_util_decode_hex(const char *src, int len)
 	return buf;
 }
 
-unsigned char *tcore_util_unpack_gsm7bit(const unsigned char *src, unsigned int src_len)
+static const char hex_digits_upper[] = "0123456789ABCDEF";
+
+/* Nibble value + 1 of each character, 0 for non-hex characters */
+static const unsigned char hex_char_values[256] = {
+	['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+	['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+	['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+	['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16,
+};
+
+static inline int _hex_char_value(unsigned char c)
 {
-	unsigned char *dest;
-	int i = 0;
-	unsigned int pos = 0;
-	unsigned char shift = 0;
-	int outlen = 0;
+	return hex_char_values[c] - 1;
+}
 
-	if (!src || src_len == 0) {
-		return NULL;
-	}
+#if defined(__SSE2__)
 
-	outlen = (src_len * 8) / 7;
+static inline __m128i _hex_nibbles_to_ascii(__m128i n)
+{
+	__m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(n, _mm_set1_epi8(9)),
+			_mm_set1_epi8('A' - '0' - 10));
 
-	dest = calloc(outlen + 1, 1);
-	if (!dest)
-		return NULL;
+	return _mm_add_epi8(_mm_add_epi8(n, _mm_set1_epi8('0')), alpha);
+}
 
-	for (i = 0; pos < src_len; i++, pos++) {
-		dest[i] = (src[pos] << shift) & 0x7F;
+/* 16 octets -> 32 characters per iteration, returns octets consumed */
+static unsigned int _hex_encode_simd(const unsigned char *src,
+		unsigned int src_len, char *dest)
+{
+	const __m128i mask = _mm_set1_epi8(0x0F);
+	unsigned int i;
+
+	for (i = 0; i + 16 <= src_len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+		__m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+		__m128i lo = _mm_and_si128(v, mask);
+
+		_mm_storeu_si128((__m128i *) (dest + i * 2),
+				_hex_nibbles_to_ascii(_mm_unpacklo_epi8(hi, lo)));
+		_mm_storeu_si128((__m128i *) (dest + i * 2 + 16),
+				_hex_nibbles_to_ascii(_mm_unpackhi_epi8(hi, lo)));
+	}
 
-		if (pos != 0) {
-			/* except the first byte, a character contains some bits from the previous byte.*/
-			dest[i] |= src[pos - 1] >> (8 - shift);
-		}
+	return i;
+}
 
-		shift++;
+/*
+ * 16 characters -> 8 octets per iteration. Stops at the first block
+ * holding a non-hex character and leaves it to the scalar loop, which
+ * reports the exact position. Returns characters consumed.
+ */
+static unsigned int _hex_decode_simd(const char *src, unsigned int src_len,
+		unsigned char *dest)
+{
+	unsigned int i;
+
+	for (i = 0; i + 16 <= src_len; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (src + i));
+		__m128i l = _mm_or_si128(v, _mm_set1_epi8(0x20));
+		__m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+				_mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+		__m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(l, _mm_set1_epi8('a' - 1)),
+				_mm_cmplt_epi8(l, _mm_set1_epi8('f' + 1)));
+		__m128i nib;
+		__m128i out;
+
+		if (_mm_movemask_epi8(_mm_or_si128(digit, alpha)) != 0xFFFF)
+			break;
 
-		if (shift == 7) {
-			shift = 0;
+		nib = _mm_or_si128(
+				_mm_and_si128(digit, _mm_sub_epi8(v, _mm_set1_epi8('0'))),
+				_mm_and_si128(alpha, _mm_sub_epi8(l, _mm_set1_epi8('a' - 10))));
 
-			/* a possible extra complete character is available */
-			i++;
-			dest[i] = src[pos] >> 1;
-		}
+		/* each 16-bit lane holds (high nibble | low nibble << 8) */
+		out = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(nib, _mm_set1_epi16(0x00FF)), 4),
+				_mm_srli_epi16(nib, 8));
+		_mm_storel_epi64((__m128i *) (dest + i / 2),
+				_mm_packus_epi16(out, _mm_setzero_si128()));
 	}
 
-	/*If a character is '\r'(13), change it to space(32) */
-	for (i = 0; i < outlen; i++)
-		if (dest[i] == '\r')
-			dest[i] = ' ';
+	return i;
+}
 
-	dest[outlen] = '\0';
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
 
-	return dest;
+static inline uint8x16_t _hex_nibbles_to_ascii(uint8x16_t n)
+{
+	uint8x16_t alpha = vandq_u8(vcgtq_u8(n, vdupq_n_u8(9)),
+			vdupq_n_u8('A' - '0' - 10));
+
+	return vaddq_u8(vaddq_u8(n, vdupq_n_u8('0')), alpha);
 }
 
-unsigned char *tcore_util_pack_gsm7bit(const unsigned char *src, unsigned int src_len)
+static unsigned int _hex_encode_simd(const unsigned char *src,
+		unsigned int src_len, char *dest)
 {
-	unsigned char *dest;
-	unsigned int i = 0;
-	unsigned int pos = 0, shift = 0;
-	unsigned int outlen = 0;
+	unsigned int i;
 
-	if (!src || src_len == 0) {
-		return NULL;
+	for (i = 0; i + 16 <= src_len; i += 16) {
+		uint8x16_t v = vld1q_u8(src + i);
+		uint8x16x2_t out;
+
+		out.val[0] = _hex_nibbles_to_ascii(vshrq_n_u8(v, 4));
+		out.val[1] = _hex_nibbles_to_ascii(vandq_u8(v, vdupq_n_u8(0x0F)));
+		vst2q_u8((uint8_t *) (dest + i * 2), out);
 	}
 
-	outlen = ((src_len * 7) / 8) + 1;
+	return i;
+}
 
-	dest = calloc(outlen + 1, 1);
-	if (!dest)
-		return NULL;
+static inline uint8x16_t _hex_ascii_to_nibbles(uint8x16_t v, uint8x16_t *valid)
+{
+	uint8x16_t d = vsubq_u8(v, vdupq_n_u8('0'));
+	uint8x16_t a = vsubq_u8(vorrq_u8(v, vdupq_n_u8(0x20)), vdupq_n_u8('a'));
+	uint8x16_t digit = vcltq_u8(d, vdupq_n_u8(10));
+	uint8x16_t alpha = vcltq_u8(a, vdupq_n_u8(6));
 
-	for (pos = 0, i = 0; i < src_len; pos++, i++) {
-		if (pos >= outlen) {
-			free(dest);
-			return NULL;
-		}
+	*valid = vandq_u8(*valid, vorrq_u8(digit, alpha));
 
-		/* pack the low bits */
-		dest[pos] = src[i] >> shift;
+	return vbslq_u8(digit, d, vaddq_u8(a, vdupq_n_u8(10)));
+}
 
-		if (i + 1 < src_len) {
-			/* pack the high bits using the low bits of the next character */
-			dest[pos] |= src[i + 1] << (7 - shift);
+/* 32 characters -> 16 octets per iteration, see the SSE2 variant */
+static unsigned int _hex_decode_simd(const char *src, unsigned int src_len,
+		unsigned char *dest)
+{
+	unsigned int i;
 
-			shift++;
+	for (i = 0; i + 32 <= src_len; i += 32) {
+		uint8x16x2_t in = vld2q_u8((const uint8_t *) (src + i));
+		uint8x16_t valid = vdupq_n_u8(0xFF);
+		uint8x16_t hi = _hex_ascii_to_nibbles(in.val[0], &valid);
+		uint8x16_t lo = _hex_ascii_to_nibbles(in.val[1], &valid);
+		uint8x8_t folded = vand_u8(vget_low_u8(valid), vget_high_u8(valid));
 
-			if (shift == 7) {
-				shift = 0;
-				i++;
-			}
-		}
-		else {
-			if (shift == 6)
-				dest[pos] |= 0x1a;
-		}
+		if (vget_lane_u64(vreinterpret_u64_u8(folded), 0) != ~0ULL)
+			break;
+
+		vst1q_u8(dest + i / 2, vorrq_u8(vshlq_n_u8(hi, 4), lo));
 	}
 
-	return dest;
+	return i;
 }
 
-char* tcore_util_convert_bcd2ascii(const char* src, int src_len, int max_len)
+#else
+
+static unsigned int _hex_encode_simd(const unsigned char *src,
+		unsigned int src_len, char *dest)
 {
-	int index = 0, len=0;
-	char l_bcd = 0x00, h_bcd = 0x0F;
-	char *dest = NULL;
+	return 0;
+}
 
-	if(!src)
-		return NULL;
+static unsigned int _hex_decode_simd(const char *src, unsigned int src_len,
+		unsigned char *dest)
+{
+	return 0;
+}
 
-	if(src_len*2 > max_len){
-		err("[SAT] PARSER - number length exceeds the max");
-		return NULL;
-	}
+#endif
 
-	dest = malloc((src_len*2)*sizeof(char)+1);
-	memset(dest, 0, (src_len*2)*sizeof(char)+1);
+/*
+ * Writes upper-case hex and a terminating NUL, so dest must hold
+ * src_len * 2 + 1 bytes.
+ */
+TReturn tcore_util_hex_encode(const unsigned char *src, unsigned int src_len,
+		char *dest, unsigned int dest_size)
+{
+	unsigned int i;
 
-	for(index = 0; index < src_len; index++){
-		l_bcd = src[index] & 0x0F;
-		h_bcd = (src[index] & 0xF0) >> 0x04;
+	if ((!src && src_len) || !dest)
+		return TCORE_RETURN_EINVAL;
 
-		switch(l_bcd){
-			case 0x0A:
-				dest[len++] = '*';
-				break;
-			case 0x0B:
-				dest[len++] = '#';
-				break;
-			case 0x0C:
-				dest[len++] = 'p'; //Pause
-				break;
-			case 0x0D:
-				dest[len++] = '?'; //Wild Card character
-				break;
-			case 0x0E: //ignore, RFU
-			case 0x0F: //ignore in l_bcd
-				break;
-			default:
-				dest[len++] = l_bcd+'0'; //digits 0~9
-				break;
-		}//l_lbcd switch
+	if (src_len > (G_MAXUINT - 1) / 2 || dest_size < src_len * 2 + 1)
+		return TCORE_RETURN_EMSGSIZE;
 
-		switch(h_bcd){
-			case 0x0A:
-				dest[len++] = '*';
-				break;
-			case 0x0B:
-				dest[len++] = '#';
-				break;
-			case 0x0C:
-				dest[len++] = 'p'; //Pause
-				break;
-			case 0x0D:
-				dest[len++] = '?'; //Wild Card character
-				break;
-			case 0x0E: //ignore, RFU
-			case 0x0F:
-				dest[len] = '\0'; //Null termination
-				break;
-			default:
-				dest[len++] = h_bcd+'0'; //digits 0~9
-				break;
-		}//h_bcd switch
+	i = _hex_encode_simd(src, src_len, dest);
+
+	for (; i < src_len; i++) {
+		dest[i * 2] = hex_digits_upper[src[i] >> 4];
+		dest[i * 2 + 1] = hex_digits_upper[src[i] & 0x0F];
 	}
 
-	if(h_bcd != 0x0F)
-		dest[len] = '\0';
+	dest[src_len * 2] = '\0';
 
-	dbg("[SAT] SAT PARSER - number(%s) len(%d)", dest, len);
-	return dest;
+	return TCORE_RETURN_SUCCESS;
 }
 
-GHashTable *tcore_util_marshal_create()
+/*
+ * Accepts either case. On a non-hex character returns
+ * TCORE_RETURN_EINVAL with decoded_len set to the number of octets
+ * written before the offending pair.
+ */
+TReturn tcore_util_hex_decode(const char *src, unsigned int src_len,
+		unsigned char *dest, unsigned int dest_size, unsigned int *decoded_len)
 {
-	GHashTable *ht = NULL;
+	unsigned int i;
 
-	ht = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
-			_tcore_util_marshal_remove_value);
+	if (decoded_len)
+		*decoded_len = 0;
 
-	return ht;
-}
+	if ((!src && src_len) || (!dest && src_len))
+		return TCORE_RETURN_EINVAL;
 
-void tcore_util_marshal_destory(GHashTable *ht)
-{
-	if (!ht)
-		return;
+	if (src_len % 2) {
+		dbg("odd hex string length (%u)", src_len);
+		return TCORE_RETURN_EINVAL;
+	}
 
-	g_hash_table_destroy(ht);
-}
+	if (dest_size < src_len / 2)
+		return TCORE_RETURN_EMSGSIZE;
 
+	i = _hex_decode_simd(src, src_len, dest);
 
-GHashTable *tcore_util_marshal_deserialize_string(const gchar *serialized_string)
-{
-	int index = 0;
-	gchar **tuple = NULL;
-	GHashTable *ht = NULL;
+	for (; i < src_len; i += 2) {
+		int hi = _hex_char_value(src[i]);
+		int lo = _hex_char_value(src[i + 1]);
 
-	ht = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
-			_tcore_util_marshal_remove_value);
+		if (hi < 0 || lo < 0) {
+			dbg("invalid hex character at offset %u", (hi < 0) ? i : i + 1);
+			if (decoded_len)
+				*decoded_len = i / 2;
+			return TCORE_RETURN_EINVAL;
+		}
 
-	if (strlen(serialized_string) == 0) {
-		return ht;
+		dest[i / 2] = (hi << 4) | lo;
 	}
 
-	tuple = g_strsplit((gchar *) serialized_string, " ", 0);
+	if (decoded_len)
+		*decoded_len = src_len / 2;
 
-	while (strlen(tuple[index]) > 3) {
-		int tmp = 0;
-		guchar *content = NULL;
-		gchar **inner_tuple = NULL;
-		GValue *src = g_new0(GValue, 1);
-		GValue *dest = g_new0(GValue, 1);
-		unsigned int type = 0;
+	return TCORE_RETURN_SUCCESS;
+}
 
-		inner_tuple = g_strsplit(tuple[index], ":", 0);
-		type = atoi(inner_tuple[1]);
-		content = g_base64_decode(inner_tuple[2], (gsize *)&tmp);
+/*
+ * GSM 03.38 default alphabet and its single shift (escape) table.
+ * National language shift tables are not supported.
+ */
+#define GSM7_ESC 0x1B
+#define GSM7_EXT 0x100
+
+static const guint16 gsm7_default_ucs[128] = {
+	0x0040, 0x00A3, 0x0024, 0x00A5, 0x00E8, 0x00E9, 0x00F9, 0x00EC,
+	0x00F2, 0x00C7, 0x000A, 0x00D8, 0x00F8, 0x000D, 0x00C5, 0x00E5,
+	0x0394, 0x005F, 0x03A6, 0x0393, 0x039B, 0x03A9, 0x03A0, 0x03A8,
+	0x03A3, 0x0398, 0x039E, 0x00A0, 0x00C6, 0x00E6, 0x00DF, 0x00C9,
+	0x0020, 0x0021, 0x0022, 0x0023, 0x00A4, 0x0025, 0x0026, 0x0027,
+	0x0028, 0x0029, 0x002A, 0x002B, 0x002C, 0x002D, 0x002E, 0x002F,
+	0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037,
+	0x0038, 0x0039, 0x003A, 0x003B, 0x003C, 0x003D, 0x003E, 0x003F,
+	0x00A1, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047,
+	0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F,
+	0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057,
+	0x0058, 0x0059, 0x005A, 0x00C4, 0x00D6, 0x00D1, 0x00DC, 0x00A7,
+	0x00BF, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+	0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F,
+	0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077,
+	0x0078, 0x0079, 0x007A, 0x00E4, 0x00F6, 0x00F1, 0x00FC, 0x00E0,
+};
+
+/* 0 where the extension table has no entry */
+static const guint16 gsm7_ext_ucs[128] = {
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x000C, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x005E, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x007B, 0x007D, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x005C,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x005B, 0x007E, 0x005D, 0x0000,
+	0x007C, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x20AC, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+};
+
+/* U+0000..U+00FF -> septet, GSM7_EXT marks an escape sequence */
+static const guint16 gsm7_from_latin1[256] = {
+	0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+	0xFFFF, 0xFFFF, 0x000A, 0xFFFF, 0x010A, 0x000D, 0xFFFF, 0xFFFF,
+	0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+	0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+	0x0020, 0x0021, 0x0022, 0x0023, 0x0002, 0x0025, 0x0026, 0x0027,
+	0x0028, 0x0029, 0x002A, 0x002B, 0x002C, 0x002D, 0x002E, 0x002F,
+	0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037,
+	0x0038, 0x0039, 0x003A, 0x003B, 0x003C, 0x003D, 0x003E, 0x003F,
+	0x0000, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047,
+	0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F,
+	0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057,
+	0x0058, 0x0059, 0x005A, 0x013C, 0x012F, 0x013E, 0x0114, 0x0011,
+	0xFFFF, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+	0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F,
+	0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077,
+	0x0078, 0x0079, 0x007A, 0x0128, 0x0140, 0x0129, 0x013D, 0xFFFF,
+	0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+	0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+	0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+	0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+	0xFFFF, 0x0040, 0xFFFF, 0x0001, 0x0024, 0x0003, 0xFFFF, 0x005F,
+	0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+	0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+	0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0x0060,
+	0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0x005B, 0x000E, 0x001C, 0x0009,
+	0xFFFF, 0x001F, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+	0xFFFF, 0x005D, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0x005C, 0xFFFF,
+	0x000B, 0xFFFF, 0xFFFF, 0xFFFF, 0x005E, 0xFFFF, 0xFFFF, 0x001E,
+	0x007F, 0xFFFF, 0xFFFF, 0xFFFF, 0x007B, 0x000F, 0x001D, 0xFFFF,
+	0x0004, 0x0005, 0xFFFF, 0xFFFF, 0x0007, 0xFFFF, 0xFFFF, 0xFFFF,
+	0xFFFF, 0x007D, 0x0008, 0xFFFF, 0xFFFF, 0xFFFF, 0x007C, 0xFFFF,
+	0x000C, 0x0006, 0xFFFF, 0xFFFF, 0x007E, 0xFFFF, 0xFFFF, 0xFFFF,
+};
+
+static const struct gsm7_map_type {
+	guint16 ucs;
+	guint16 gsm;
+} gsm7_from_other[] = {
+	{ 0x0393, 0x013 },
+	{ 0x0394, 0x010 },
+	{ 0x0398, 0x019 },
+	{ 0x039B, 0x014 },
+	{ 0x039E, 0x01A },
+	{ 0x03A0, 0x016 },
+	{ 0x03A3, 0x018 },
+	{ 0x03A6, 0x012 },
+	{ 0x03A8, 0x017 },
+	{ 0x03A9, 0x015 },
+	{ 0x20AC, 0x165 },
+};
+
+static inline guint64 _gsm7_load_le64(const unsigned char *p)
+{
+	guint64 w;
 
-		g_value_init(src, G_TYPE_STRING);
-		g_value_init(dest, type);
+	memcpy(&w, p, sizeof(w));
+	return GUINT64_FROM_LE(w);
+}
 
-		g_value_set_string(src, (const gchar *)content);
-		_tcore_util_marshal_convert_str_to_type(src, dest, type);
-		g_hash_table_insert(ht, g_strdup(inner_tuple[0]), dest);
+static inline void _gsm7_store_le56(unsigned char *p, guint64 w)
+{
+	unsigned int i;
 
-		g_free(content);
+	for (i = 0; i < 7; i++)
+		p[i] = (unsigned char) (w >> (i * 8));
+}
+
+/*
+ * Packs septet_count septets after fill_bits (0..6) zero bits, as used to
+ * align user data behind a UDH. Whole groups of 8 septets are packed as a
+ * single 56-bit word.
+ */
+TReturn tcore_util_gsm7bit_pack(const unsigned char *septets,
+		unsigned int septet_count, unsigned int fill_bits,
+		unsigned char *dest, unsigned int dest_size, unsigned int *packed_len)
+{
+	unsigned int len;
+	unsigned int i = 0;
+	unsigned int o = 0;
+	unsigned int bit;
+	guint64 carry = 0;
+
+	if (packed_len)
+		*packed_len = 0;
+
+	if ((!septets && septet_count) || !dest || fill_bits > 6)
+		return TCORE_RETURN_EINVAL;
+
+	if (septet_count > (G_MAXUINT - 7) / 7)
+		return TCORE_RETURN_EMSGSIZE;
+
+	len = (fill_bits + septet_count * 7 + 7) / 8;
+	if (dest_size < len)
+		return TCORE_RETURN_EMSGSIZE;
+
+	for (; i + 8 <= septet_count; i += 8, o += 7) {
+		guint64 w = 0;
+		unsigned int k;
+
+		for (k = 0; k < 8; k++)
+			w |= (guint64) (septets[i + k] & 0x7F) << (k * 7);
+
+		w = (w << fill_bits) | carry;
+		_gsm7_store_le56(dest + o, w);
+		carry = w >> 56;
+	}
+
+	if (o < len) {
+		memset(dest + o, 0, len - o);
+		dest[o] = (unsigned char) carry;
+	}
+
+	for (bit = o * 8 + fill_bits; i < septet_count; i++, bit += 7) {
+		unsigned int c = septets[i] & 0x7F;
+
+		dest[bit / 8] |= (unsigned char) (c << (bit % 8));
+		if (bit % 8 > 1)
+			dest[bit / 8 + 1] |= (unsigned char) (c >> (8 - bit % 8));
+	}
+
+	if (packed_len)
+		*packed_len = len;
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+/*
+ * Unpacks every septet that src holds after fill_bits (0..6) leading bits,
+ * at most dest_size of them. Callers that know the real septet count
+ * (e.g. TP-UDL) pass it as dest_size to drop the padding septet.
+ */
+TReturn tcore_util_gsm7bit_unpack(const unsigned char *src,
+		unsigned int src_len, unsigned int fill_bits,
+		unsigned char *dest, unsigned int dest_size, unsigned int *septet_count)
+{
+	unsigned int count;
+	unsigned int i = 0;
+	unsigned int o = 0;
+	unsigned int bit;
+
+	if (septet_count)
+		*septet_count = 0;
+
+	if ((!src && src_len) || (!dest && dest_size) || fill_bits > 6)
+		return TCORE_RETURN_EINVAL;
+
+	if (src_len > G_MAXUINT / 8)
+		return TCORE_RETURN_EMSGSIZE;
+
+	count = src_len * 8 > fill_bits ? (src_len * 8 - fill_bits) / 7 : 0;
+	if (count > dest_size)
+		count = dest_size;
+
+	/* 8 octets are loaded to cover the fill bits, so stop one short */
+	for (; i + 8 <= count && o + 8 <= src_len; i += 8, o += 7) {
+		guint64 w = _gsm7_load_le64(src + o) >> fill_bits;
+		unsigned int k;
+
+		for (k = 0; k < 8; k++)
+			dest[i + k] = (w >> (k * 7)) & 0x7F;
+	}
+
+	for (bit = o * 8 + fill_bits; i < count; i++, bit += 7) {
+		unsigned int c = src[bit / 8] >> (bit % 8);
+
+		if (bit % 8 > 1)
+			c |= src[bit / 8 + 1] << (8 - bit % 8);
+
+		dest[i] = c & 0x7F;
+	}
+
+	if (septet_count)
+		*septet_count = count;
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+/*
+ * Converts septets to NUL-terminated UTF-8. An escape followed by a code
+ * with no extension entry falls back to the default alphabet, a trailing
+ * escape is rendered as a space (3GPP TS 23.038 6.2.1.1).
+ */
+TReturn tcore_util_gsm7bit_to_utf8(const unsigned char *septets,
+		unsigned int septet_count, char *dest, unsigned int dest_size,
+		unsigned int *utf8_len)
+{
+	unsigned int i;
+	unsigned int o = 0;
+
+	if (utf8_len)
+		*utf8_len = 0;
+
+	if ((!septets && septet_count) || !dest || dest_size == 0)
+		return TCORE_RETURN_EINVAL;
+
+	for (i = 0; i < septet_count; i++) {
+		unsigned int c = septets[i] & 0x7F;
+		guint16 ucs;
+
+		if (c == GSM7_ESC) {
+			if (i + 1 < septet_count) {
+				c = septets[++i] & 0x7F;
+				ucs = gsm7_ext_ucs[c] ? gsm7_ext_ucs[c] : gsm7_default_ucs[c];
+			}
+			else {
+				ucs = ' ';
+			}
+		}
+		else {
+			ucs = gsm7_default_ucs[c];
+		}
+
+		if (ucs < 0x80) {
+			if (o + 1 >= dest_size)
+				goto overflow;
+			dest[o++] = (char) ucs;
+		}
+		else if (ucs < 0x800) {
+			if (o + 2 >= dest_size)
+				goto overflow;
+			dest[o++] = (char) (0xC0 | (ucs >> 6));
+			dest[o++] = (char) (0x80 | (ucs & 0x3F));
+		}
+		else {
+			if (o + 3 >= dest_size)
+				goto overflow;
+			dest[o++] = (char) (0xE0 | (ucs >> 12));
+			dest[o++] = (char) (0x80 | ((ucs >> 6) & 0x3F));
+			dest[o++] = (char) (0x80 | (ucs & 0x3F));
+		}
+	}
+
+	dest[o] = '\0';
+
+	if (utf8_len)
+		*utf8_len = o;
+
+	return TCORE_RETURN_SUCCESS;
+
+overflow:
+	dest[o] = '\0';
+
+	if (utf8_len)
+		*utf8_len = o;
+
+	return TCORE_RETURN_EMSGSIZE;
+}
+
+static guint16 _gsm7_from_ucs(gunichar ucs)
+{
+	unsigned int lo = 0;
+	unsigned int hi = G_N_ELEMENTS(gsm7_from_other);
+
+	if (ucs < 0x100)
+		return gsm7_from_latin1[ucs];
+
+	while (lo < hi) {
+		unsigned int mid = (lo + hi) / 2;
+
+		if (gsm7_from_other[mid].ucs == ucs)
+			return gsm7_from_other[mid].gsm;
+
+		if (gsm7_from_other[mid].ucs < ucs)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return 0xFFFF;
+}
+
+/*
+ * Converts UTF-8 to septets, using escape sequences where needed.
+ * Returns TCORE_RETURN_EINVAL on malformed UTF-8 or on a character
+ * the GSM alphabet cannot represent (callers fall back to UCS2), with
+ * septet_count set to the septets produced before it.
+ */
+TReturn tcore_util_utf8_to_gsm7bit(const char *src, unsigned int src_len,
+		unsigned char *dest, unsigned int dest_size, unsigned int *septet_count)
+{
+	const char *p = src;
+	const char *end = src + src_len;
+	unsigned int o = 0;
+	TReturn ret = TCORE_RETURN_SUCCESS;
+
+	if ((!src && src_len) || (!dest && dest_size))
+		return TCORE_RETURN_EINVAL;
+
+	while (p < end) {
+		gunichar ucs;
+		guint16 gsm;
+
+		if ((unsigned char) *p < 0x80) {
+			ucs = (unsigned char) *p++;
+		}
+		else {
+			ucs = g_utf8_get_char_validated(p, end - p);
+			if (ucs == (gunichar) -1 || ucs == (gunichar) -2) {
+				ret = TCORE_RETURN_EINVAL;
+				break;
+			}
+			p = g_utf8_next_char(p);
+		}
+
+		gsm = _gsm7_from_ucs(ucs);
+		if (gsm == 0xFFFF) {
+			dbg("U+%04X has no GSM 7-bit mapping", ucs);
+			ret = TCORE_RETURN_EINVAL;
+			break;
+		}
+
+		if (gsm & GSM7_EXT) {
+			if (o + 2 > dest_size) {
+				ret = TCORE_RETURN_EMSGSIZE;
+				break;
+			}
+			dest[o++] = GSM7_ESC;
+			dest[o++] = gsm & 0x7F;
+		}
+		else {
+			if (o + 1 > dest_size) {
+				ret = TCORE_RETURN_EMSGSIZE;
+				break;
+			}
+			dest[o++] = (unsigned char) gsm;
+		}
+	}
+
+	if (septet_count)
+		*septet_count = o;
+
+	return ret;
+}
+
+unsigned char *tcore_util_unpack_gsm7bit(const unsigned char *src, unsigned int src_len)
+{
+	unsigned char *dest;
+	unsigned int i = 0;
+	unsigned int outlen = 0;
+
+	if (!src || src_len == 0) {
+		return NULL;
+	}
+
+	outlen = (src_len * 8) / 7;
+
+	dest = calloc(outlen + 1, 1);
+	if (!dest)
+		return NULL;
+
+	tcore_util_gsm7bit_unpack(src, src_len, 0, dest, outlen, NULL);
+
+	/*If a character is '\r'(13), change it to space(32) */
+	for (i = 0; i < outlen; i++)
+		if (dest[i] == '\r')
+			dest[i] = ' ';
+
+	dest[outlen] = '\0';
+
+	return dest;
+}
+
+unsigned char *tcore_util_pack_gsm7bit(const unsigned char *src, unsigned int src_len)
+{
+	unsigned char *dest;
+	unsigned int outlen = 0;
+	unsigned int packed_len = 0;
+
+	if (!src || src_len == 0) {
+		return NULL;
+	}
+
+	outlen = ((src_len * 7) / 8) + 1;
+
+	dest = calloc(outlen + 1, 1);
+	if (!dest)
+		return NULL;
+
+	if (tcore_util_gsm7bit_pack(src, src_len, 0, dest, outlen, &packed_len)
+			!= TCORE_RETURN_SUCCESS) {
+		free(dest);
+		return NULL;
+	}
+
+	/* 7 spare bits would read as '@', pad them with <CR> instead */
+	if (src_len % 8 == 7)
+		dest[packed_len - 1] |= 0x1a;
+
+	return dest;
+}
+
+/*
+ * Dialing number BCD (3GPP TS 31.102 4.4.2.3, TS 24.008 10.5.4.7):
+ * digits are packed low nibble first, 'A' = '*', 'B' = '#',
+ * 'C' = pause ('P'), 'D' = wild ('?'), 'E' is RFU and skipped,
+ * 'F' is filler and ends the number.
+ */
+/* octet -> { low nibble, high nibble } digits, 0 for RFU (E) and filler (F) */
+static const char bcd_digit_pair[256][2] = {
+	{ '0', '0' }, { '1', '0' }, { '2', '0' }, { '3', '0' }, { '4', '0' }, { '5', '0' }, { '6', '0' }, { '7', '0' },
+	{ '8', '0' }, { '9', '0' }, { '*', '0' }, { '#', '0' }, { 'P', '0' }, { '?', '0' }, { 0, '0' }, { 0, '0' },
+	{ '0', '1' }, { '1', '1' }, { '2', '1' }, { '3', '1' }, { '4', '1' }, { '5', '1' }, { '6', '1' }, { '7', '1' },
+	{ '8', '1' }, { '9', '1' }, { '*', '1' }, { '#', '1' }, { 'P', '1' }, { '?', '1' }, { 0, '1' }, { 0, '1' },
+	{ '0', '2' }, { '1', '2' }, { '2', '2' }, { '3', '2' }, { '4', '2' }, { '5', '2' }, { '6', '2' }, { '7', '2' },
+	{ '8', '2' }, { '9', '2' }, { '*', '2' }, { '#', '2' }, { 'P', '2' }, { '?', '2' }, { 0, '2' }, { 0, '2' },
+	{ '0', '3' }, { '1', '3' }, { '2', '3' }, { '3', '3' }, { '4', '3' }, { '5', '3' }, { '6', '3' }, { '7', '3' },
+	{ '8', '3' }, { '9', '3' }, { '*', '3' }, { '#', '3' }, { 'P', '3' }, { '?', '3' }, { 0, '3' }, { 0, '3' },
+	{ '0', '4' }, { '1', '4' }, { '2', '4' }, { '3', '4' }, { '4', '4' }, { '5', '4' }, { '6', '4' }, { '7', '4' },
+	{ '8', '4' }, { '9', '4' }, { '*', '4' }, { '#', '4' }, { 'P', '4' }, { '?', '4' }, { 0, '4' }, { 0, '4' },
+	{ '0', '5' }, { '1', '5' }, { '2', '5' }, { '3', '5' }, { '4', '5' }, { '5', '5' }, { '6', '5' }, { '7', '5' },
+	{ '8', '5' }, { '9', '5' }, { '*', '5' }, { '#', '5' }, { 'P', '5' }, { '?', '5' }, { 0, '5' }, { 0, '5' },
+	{ '0', '6' }, { '1', '6' }, { '2', '6' }, { '3', '6' }, { '4', '6' }, { '5', '6' }, { '6', '6' }, { '7', '6' },
+	{ '8', '6' }, { '9', '6' }, { '*', '6' }, { '#', '6' }, { 'P', '6' }, { '?', '6' }, { 0, '6' }, { 0, '6' },
+	{ '0', '7' }, { '1', '7' }, { '2', '7' }, { '3', '7' }, { '4', '7' }, { '5', '7' }, { '6', '7' }, { '7', '7' },
+	{ '8', '7' }, { '9', '7' }, { '*', '7' }, { '#', '7' }, { 'P', '7' }, { '?', '7' }, { 0, '7' }, { 0, '7' },
+	{ '0', '8' }, { '1', '8' }, { '2', '8' }, { '3', '8' }, { '4', '8' }, { '5', '8' }, { '6', '8' }, { '7', '8' },
+	{ '8', '8' }, { '9', '8' }, { '*', '8' }, { '#', '8' }, { 'P', '8' }, { '?', '8' }, { 0, '8' }, { 0, '8' },
+	{ '0', '9' }, { '1', '9' }, { '2', '9' }, { '3', '9' }, { '4', '9' }, { '5', '9' }, { '6', '9' }, { '7', '9' },
+	{ '8', '9' }, { '9', '9' }, { '*', '9' }, { '#', '9' }, { 'P', '9' }, { '?', '9' }, { 0, '9' }, { 0, '9' },
+	{ '0', '*' }, { '1', '*' }, { '2', '*' }, { '3', '*' }, { '4', '*' }, { '5', '*' }, { '6', '*' }, { '7', '*' },
+	{ '8', '*' }, { '9', '*' }, { '*', '*' }, { '#', '*' }, { 'P', '*' }, { '?', '*' }, { 0, '*' }, { 0, '*' },
+	{ '0', '#' }, { '1', '#' }, { '2', '#' }, { '3', '#' }, { '4', '#' }, { '5', '#' }, { '6', '#' }, { '7', '#' },
+	{ '8', '#' }, { '9', '#' }, { '*', '#' }, { '#', '#' }, { 'P', '#' }, { '?', '#' }, { 0, '#' }, { 0, '#' },
+	{ '0', 'P' }, { '1', 'P' }, { '2', 'P' }, { '3', 'P' }, { '4', 'P' }, { '5', 'P' }, { '6', 'P' }, { '7', 'P' },
+	{ '8', 'P' }, { '9', 'P' }, { '*', 'P' }, { '#', 'P' }, { 'P', 'P' }, { '?', 'P' }, { 0, 'P' }, { 0, 'P' },
+	{ '0', '?' }, { '1', '?' }, { '2', '?' }, { '3', '?' }, { '4', '?' }, { '5', '?' }, { '6', '?' }, { '7', '?' },
+	{ '8', '?' }, { '9', '?' }, { '*', '?' }, { '#', '?' }, { 'P', '?' }, { '?', '?' }, { 0, '?' }, { 0, '?' },
+	{ '0', 0 }, { '1', 0 }, { '2', 0 }, { '3', 0 }, { '4', 0 }, { '5', 0 }, { '6', 0 }, { '7', 0 },
+	{ '8', 0 }, { '9', 0 }, { '*', 0 }, { '#', 0 }, { 'P', 0 }, { '?', 0 }, { 0, 0 }, { 0, 0 },
+	{ '0', 0 }, { '1', 0 }, { '2', 0 }, { '3', 0 }, { '4', 0 }, { '5', 0 }, { '6', 0 }, { '7', 0 },
+	{ '8', 0 }, { '9', 0 }, { '*', 0 }, { '#', 0 }, { 'P', 0 }, { '?', 0 }, { 0, 0 }, { 0, 0 },
+};
+
+/* dial string character -> nibble, 0xFF where it has no BCD code */
+static const unsigned char bcd_nibble[256] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0x0B, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x0A, 0xFF, 0x0C, 0xFF, 0xFF, 0xFF,
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x0D,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0x0C, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0x0C, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+TReturn tcore_util_bcd_decode(const unsigned char *src, unsigned int src_len,
+		char *dest, unsigned int dest_size, unsigned int *digit_len)
+{
+	unsigned int i;
+	unsigned int o = 0;
+	TReturn ret = TCORE_RETURN_SUCCESS;
+
+	if (digit_len)
+		*digit_len = 0;
+
+	if ((!src && src_len) || !dest || dest_size == 0)
+		return TCORE_RETURN_EINVAL;
+
+	for (i = 0; i < src_len; i++) {
+		const char *pair = bcd_digit_pair[src[i]];
+		unsigned int k;
+
+		/* Near the end of dest, the nibble loop writes what still fits */
+		if (pair[0] && pair[1] && o + 2 < dest_size) {
+			dest[o++] = pair[0];
+			dest[o++] = pair[1];
+			continue;
+		}
+
+		for (k = 0; k < 2; k++) {
+			unsigned int nibble = k ? (src[i] >> 4) : (src[i] & 0x0F);
+
+			if (nibble == 0x0F)
+				goto done;
+
+			if (nibble == 0x0E)
+				continue;
+
+			if (o + 1 >= dest_size) {
+				ret = TCORE_RETURN_EMSGSIZE;
+				goto done;
+			}
+
+			dest[o++] = pair[k];
+		}
+	}
+
+done:
+	dest[o] = '\0';
+
+	if (digit_len)
+		*digit_len = o;
+
+	return ret;
+}
+
+/*
+ * Writes (digit_len + 1) / 2 octets, an odd length is padded with 'F'.
+ * Returns TCORE_RETURN_EINVAL on a character with no BCD code.
+ */
+TReturn tcore_util_bcd_encode(const char *digits, unsigned int digit_len,
+		unsigned char *dest, unsigned int dest_size, unsigned int *bcd_len)
+{
+	unsigned int i;
+	unsigned int len;
+
+	if (bcd_len)
+		*bcd_len = 0;
+
+	if ((!digits && digit_len) || (!dest && digit_len))
+		return TCORE_RETURN_EINVAL;
+
+	len = digit_len / 2 + digit_len % 2;
+	if (dest_size < len)
+		return TCORE_RETURN_EMSGSIZE;
+
+	for (i = 0; i < digit_len; i += 2) {
+		unsigned char lo = bcd_nibble[(unsigned char) digits[i]];
+		unsigned char hi = 0x0F;
+
+		if (i + 1 < digit_len)
+			hi = bcd_nibble[(unsigned char) digits[i + 1]];
+
+		if (lo == 0xFF || hi == 0xFF) {
+			dbg("invalid dialing digit at offset %u", lo == 0xFF ? i : i + 1);
+			return TCORE_RETURN_EINVAL;
+		}
+
+		dest[i / 2] = (hi << 4) | lo;
+	}
+
+	if (bcd_len)
+		*bcd_len = len;
+
+	return TCORE_RETURN_SUCCESS;
+}
+
+/* bit 8 is always set, bits 7..5 are the TON and bits 4..1 the NPI */
+unsigned char tcore_util_encode_ton_npi(unsigned int ton, unsigned int npi)
+{
+	return 0x80 | ((ton & 0x07) << 4) | (npi & 0x0F);
+}
+
+void tcore_util_decode_ton_npi(unsigned char ton_npi, unsigned int *ton,
+		unsigned int *npi)
+{
+	if (ton)
+		*ton = (ton_npi >> 4) & 0x07;
+
+	if (npi)
+		*npi = ton_npi & 0x0F;
+}
+
+char* tcore_util_convert_bcd2ascii(const char* src, int src_len, int max_len)
+{
+	char *dest = NULL;
+	unsigned int len = 0;
+
+	if(!src)
+		return NULL;
+
+	if(src_len*2 > max_len){
+		err("[SAT] PARSER - number length exceeds the max");
+		return NULL;
+	}
+
+	dest = malloc((src_len*2)*sizeof(char)+1);
+	if (!dest)
+		return NULL;
+
+	tcore_util_bcd_decode((const unsigned char *)src, src_len, dest,
+			src_len * 2 + 1, &len);
+
+	dbg("[SAT] SAT PARSER - number(%s) len(%d)", dest, len);
+	return dest;
+}
+
+GHashTable *tcore_util_marshal_create()
+{
+	GHashTable *ht = NULL;
+
+	ht = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			_tcore_util_marshal_remove_value);
+
+	return ht;
+}
+
+void tcore_util_marshal_destory(GHashTable *ht)
+{
+	if (!ht)
+		return;
+
+	g_hash_table_destroy(ht);
+}
+
+
+GHashTable *tcore_util_marshal_deserialize_string(const gchar *serialized_string)
+{
+	int index = 0;
+	gchar **tuple = NULL;
+	GHashTable *ht = NULL;
+
+	ht = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			_tcore_util_marshal_remove_value);
+
+	if (strlen(serialized_string) == 0) {
+		return ht;
+	}
+
+	tuple = g_strsplit((gchar *) serialized_string, " ", 0);
+
+	while (strlen(tuple[index]) > 3) {
+		int tmp = 0;
+		guchar *content = NULL;
+		gchar **inner_tuple = NULL;
+		GValue *src = g_new0(GValue, 1);
+		GValue *dest = g_new0(GValue, 1);
+		unsigned int type = 0;
+
+		inner_tuple = g_strsplit(tuple[index], ":", 0);
+		type = atoi(inner_tuple[1]);
+		content = g_base64_decode(inner_tuple[2], (gsize *)&tmp);
+
+		g_value_init(src, G_TYPE_STRING);
+		g_value_init(dest, type);
+
+		g_value_set_string(src, (const gchar *)content);
+		_tcore_util_marshal_convert_str_to_type(src, dest, type);
+		g_hash_table_insert(ht, g_strdup(inner_tuple[0]), dest);
+
+		g_free(content);
 		g_strfreev(inner_tuple);
 		index++;
 	}
@@ -725,6 +1737,61 @@ gchar *tcore_util_marshal_serialize(GHashTable *ht)
 	return rv_str;
 }
 
+gboolean tcore_util_marshal_serialize_binary(GHashTable *ht, GByteArray *buf)
+{
+	guint8 header[3] = { MARSHAL_BINARY_MAGIC_0, MARSHAL_BINARY_MAGIC_1,
+			TCORE_UTIL_MARSHAL_BINARY_VERSION };
+	guint start;
+
+	if (!ht || !buf)
+		return FALSE;
+
+	start = buf->len;
+	g_byte_array_append(buf, header, sizeof(header));
+
+	if (_marshal_binary_put_map(ht, buf) == FALSE) {
+		g_byte_array_set_size(buf, start);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+GHashTable *tcore_util_marshal_deserialize_binary(const guint8 *data, gsize len)
+{
+	struct marshal_reader_type r;
+	GHashTable *ht;
+
+	if (!data || len < 3)
+		return NULL;
+
+	if (data[0] != MARSHAL_BINARY_MAGIC_0 || data[1] != MARSHAL_BINARY_MAGIC_1) {
+		dbg("not a binary marshal buffer");
+		return NULL;
+	}
+
+	if (data[2] != TCORE_UTIL_MARSHAL_BINARY_VERSION) {
+		dbg("unsupported marshal version (%d)", data[2]);
+		return NULL;
+	}
+
+	r.data = data;
+	r.len = len;
+	r.pos = 3;
+
+	ht = _marshal_binary_get_map(&r, 0);
+	if (!ht)
+		return NULL;
+
+	if (r.pos != len) {
+		dbg("trailing data in marshal buffer (%u)", (unsigned int)(len - r.pos));
+		g_hash_table_destroy(ht);
+		return NULL;
+	}
+
+	return ht;
+}
+
 gboolean tcore_util_marshal_add_data(GHashTable *ht, const gchar *key,
 		const void *data, enum tcore_util_marshal_data_type type)
 {
@@ -820,3 +1887,397 @@ GHashTable *tcore_util_marshal_get_object(GHashTable *ht, const gchar *key)
 
 	return rvalue;
 }
+
+union marshal_slot_value {
+	gchar c;
+	gboolean b;
+	gint i;
+	gdouble d;
+	gchar *s;
+	GHashTable *o;
+};
+
+struct marshal_slot_type {
+	gboolean present;
+	union marshal_slot_value v;
+};
+
+struct tcore_marshal_record_type {
+	const struct tcore_util_marshal_schema *schema;
+	struct marshal_slot_type slots[];
+};
+
+static struct marshal_slot_type *_record_slot(TcoreMarshalRecord *rec,
+		unsigned int id, enum tcore_util_marshal_data_type type)
+{
+	if (!rec || id >= rec->schema->field_count)
+		return NULL;
+
+	if (rec->schema->fields[id].type != type) {
+		dbg("[%s] field %s type mismatch", rec->schema->name,
+				rec->schema->fields[id].key);
+		return NULL;
+	}
+
+	return &rec->slots[id];
+}
+
+static void _record_slot_clear(TcoreMarshalRecord *rec, unsigned int id)
+{
+	struct marshal_slot_type *slot = &rec->slots[id];
+
+	if (!slot->present)
+		return;
+
+	switch (rec->schema->fields[id].type) {
+		case TCORE_UTIL_MARSHAL_DATA_STRING_TYPE:
+			g_free(slot->v.s);
+			break;
+
+		case TCORE_UTIL_MARSHAL_DATA_OBJECT_TYPE:
+			if (slot->v.o)
+				g_hash_table_destroy(slot->v.o);
+			break;
+
+		default:
+			break;
+	}
+
+	memset(slot, 0, sizeof(struct marshal_slot_type));
+}
+
+TcoreMarshalRecord *tcore_util_marshal_record_new(
+		const struct tcore_util_marshal_schema *schema)
+{
+	TcoreMarshalRecord *rec;
+
+	if (!schema || (schema->field_count && !schema->fields))
+		return NULL;
+
+	rec = calloc(1, sizeof(struct tcore_marshal_record_type)
+			+ schema->field_count * sizeof(struct marshal_slot_type));
+	if (!rec)
+		return NULL;
+
+	rec->schema = schema;
+
+	return rec;
+}
+
+void tcore_util_marshal_record_free(TcoreMarshalRecord *rec)
+{
+	unsigned int i;
+
+	if (!rec)
+		return;
+
+	for (i = 0; i < rec->schema->field_count; i++)
+		_record_slot_clear(rec, i);
+
+	free(rec);
+}
+
+const struct tcore_util_marshal_schema *tcore_util_marshal_record_ref_schema(
+		TcoreMarshalRecord *rec)
+{
+	if (!rec)
+		return NULL;
+
+	return rec->schema;
+}
+
+gboolean tcore_util_marshal_record_has_field(TcoreMarshalRecord *rec,
+		unsigned int id)
+{
+	if (!rec || id >= rec->schema->field_count)
+		return FALSE;
+
+	return rec->slots[id].present;
+}
+
+void tcore_util_marshal_record_unset(TcoreMarshalRecord *rec, unsigned int id)
+{
+	if (!rec || id >= rec->schema->field_count)
+		return;
+
+	_record_slot_clear(rec, id);
+}
+
+gboolean tcore_util_marshal_record_set_char(TcoreMarshalRecord *rec,
+		unsigned int id, gchar value)
+{
+	struct marshal_slot_type *slot;
+
+	slot = _record_slot(rec, id, TCORE_UTIL_MARSHAL_DATA_CHAR_TYPE);
+	if (!slot)
+		return FALSE;
+
+	slot->v.c = value;
+	slot->present = TRUE;
+
+	return TRUE;
+}
+
+gboolean tcore_util_marshal_record_set_boolean(TcoreMarshalRecord *rec,
+		unsigned int id, gboolean value)
+{
+	struct marshal_slot_type *slot;
+
+	slot = _record_slot(rec, id, TCORE_UTIL_MARSHAL_DATA_BOOLEAN_TYPE);
+	if (!slot)
+		return FALSE;
+
+	slot->v.b = value;
+	slot->present = TRUE;
+
+	return TRUE;
+}
+
+gboolean tcore_util_marshal_record_set_int(TcoreMarshalRecord *rec,
+		unsigned int id, gint value)
+{
+	struct marshal_slot_type *slot;
+
+	slot = _record_slot(rec, id, TCORE_UTIL_MARSHAL_DATA_INT_TYPE);
+	if (!slot)
+		return FALSE;
+
+	slot->v.i = value;
+	slot->present = TRUE;
+
+	return TRUE;
+}
+
+gboolean tcore_util_marshal_record_set_double(TcoreMarshalRecord *rec,
+		unsigned int id, gdouble value)
+{
+	struct marshal_slot_type *slot;
+
+	slot = _record_slot(rec, id, TCORE_UTIL_MARSHAL_DATA_DOUBLE_TYPE);
+	if (!slot)
+		return FALSE;
+
+	slot->v.d = value;
+	slot->present = TRUE;
+
+	return TRUE;
+}
+
+gboolean tcore_util_marshal_record_set_string(TcoreMarshalRecord *rec,
+		unsigned int id, const gchar *value)
+{
+	struct marshal_slot_type *slot;
+
+	slot = _record_slot(rec, id, TCORE_UTIL_MARSHAL_DATA_STRING_TYPE);
+	if (!slot)
+		return FALSE;
+
+	_record_slot_clear(rec, id);
+
+	slot->v.s = g_strdup(value);
+	slot->present = TRUE;
+
+	return TRUE;
+}
+
+/*
+ * The record keeps its own copy of the table, the caller's table
+ * is left untouched.
+ */
+gboolean tcore_util_marshal_record_set_object(TcoreMarshalRecord *rec,
+		unsigned int id, GHashTable *value)
+{
+	struct marshal_slot_type *slot;
+
+	slot = _record_slot(rec, id, TCORE_UTIL_MARSHAL_DATA_OBJECT_TYPE);
+	if (!slot)
+		return FALSE;
+
+	_record_slot_clear(rec, id);
+
+	slot->v.o = value ? _tcore_util_marshal_dup(value) : NULL;
+	slot->present = TRUE;
+
+	return TRUE;
+}
+
+gchar tcore_util_marshal_record_get_char(TcoreMarshalRecord *rec,
+		unsigned int id)
+{
+	struct marshal_slot_type *slot;
+
+	slot = _record_slot(rec, id, TCORE_UTIL_MARSHAL_DATA_CHAR_TYPE);
+	if (!slot)
+		return 0;
+
+	return slot->v.c;
+}
+
+gboolean tcore_util_marshal_record_get_boolean(TcoreMarshalRecord *rec,
+		unsigned int id)
+{
+	struct marshal_slot_type *slot;
+
+	slot = _record_slot(rec, id, TCORE_UTIL_MARSHAL_DATA_BOOLEAN_TYPE);
+	if (!slot)
+		return FALSE;
+
+	return slot->v.b;
+}
+
+gint tcore_util_marshal_record_get_int(TcoreMarshalRecord *rec,
+		unsigned int id)
+{
+	struct marshal_slot_type *slot;
+
+	slot = _record_slot(rec, id, TCORE_UTIL_MARSHAL_DATA_INT_TYPE);
+	if (!slot)
+		return 0;
+
+	return slot->v.i;
+}
+
+gdouble tcore_util_marshal_record_get_double(TcoreMarshalRecord *rec,
+		unsigned int id)
+{
+	struct marshal_slot_type *slot;
+
+	slot = _record_slot(rec, id, TCORE_UTIL_MARSHAL_DATA_DOUBLE_TYPE);
+	if (!slot)
+		return 0;
+
+	return slot->v.d;
+}
+
+const gchar *tcore_util_marshal_record_ref_string(TcoreMarshalRecord *rec,
+		unsigned int id)
+{
+	struct marshal_slot_type *slot;
+
+	slot = _record_slot(rec, id, TCORE_UTIL_MARSHAL_DATA_STRING_TYPE);
+	if (!slot)
+		return NULL;
+
+	return slot->v.s;
+}
+
+GHashTable *tcore_util_marshal_record_ref_object(TcoreMarshalRecord *rec,
+		unsigned int id)
+{
+	struct marshal_slot_type *slot;
+
+	slot = _record_slot(rec, id, TCORE_UTIL_MARSHAL_DATA_OBJECT_TYPE);
+	if (!slot)
+		return NULL;
+
+	return slot->v.o;
+}
+
+GHashTable *tcore_util_marshal_record_to_hash(TcoreMarshalRecord *rec)
+{
+	GHashTable *ht;
+	unsigned int i;
+
+	if (!rec)
+		return NULL;
+
+	ht = tcore_util_marshal_create();
+
+	for (i = 0; i < rec->schema->field_count; i++) {
+		const struct tcore_util_marshal_field *field = &rec->schema->fields[i];
+		struct marshal_slot_type *slot = &rec->slots[i];
+
+		if (!slot->present)
+			continue;
+
+		switch (field->type) {
+			case TCORE_UTIL_MARSHAL_DATA_STRING_TYPE:
+				if (slot->v.s)
+					tcore_util_marshal_add_data(ht, field->key, slot->v.s,
+							field->type);
+				break;
+
+			case TCORE_UTIL_MARSHAL_DATA_OBJECT_TYPE:
+				/* the hash form owns (and destroys) its nested tables */
+				if (slot->v.o)
+					tcore_util_marshal_add_data(ht, field->key,
+							_tcore_util_marshal_dup(slot->v.o), field->type);
+				break;
+
+			default:
+				tcore_util_marshal_add_data(ht, field->key, &slot->v,
+						field->type);
+				break;
+		}
+	}
+
+	return ht;
+}
+
+TcoreMarshalRecord *tcore_util_marshal_record_new_from_hash(
+		const struct tcore_util_marshal_schema *schema, GHashTable *ht)
+{
+	TcoreMarshalRecord *rec;
+	unsigned int i;
+
+	if (!ht)
+		return NULL;
+
+	rec = tcore_util_marshal_record_new(schema);
+	if (!rec)
+		return NULL;
+
+	for (i = 0; i < schema->field_count; i++) {
+		const struct tcore_util_marshal_field *field = &schema->fields[i];
+		struct marshal_slot_type *slot = &rec->slots[i];
+		GValue *value;
+		GType expected;
+
+		value = g_hash_table_lookup(ht, field->key);
+		if (!value)
+			continue;
+
+		expected = field->type;
+		if (expected == TCORE_UTIL_MARSHAL_DATA_OBJECT_TYPE)
+			expected = G_TYPE_HASH_TABLE;
+
+		if (G_VALUE_TYPE(value) != expected) {
+			dbg("[%s] field %s has type %s", schema->name, field->key,
+					G_VALUE_TYPE_NAME(value));
+			continue;
+		}
+
+		switch (field->type) {
+			case TCORE_UTIL_MARSHAL_DATA_CHAR_TYPE:
+				slot->v.c = g_value_get_char(value);
+				break;
+
+			case TCORE_UTIL_MARSHAL_DATA_BOOLEAN_TYPE:
+				slot->v.b = g_value_get_boolean(value);
+				break;
+
+			case TCORE_UTIL_MARSHAL_DATA_INT_TYPE:
+				slot->v.i = g_value_get_int(value);
+				break;
+
+			case TCORE_UTIL_MARSHAL_DATA_DOUBLE_TYPE:
+				slot->v.d = g_value_get_double(value);
+				break;
+
+			case TCORE_UTIL_MARSHAL_DATA_STRING_TYPE:
+				slot->v.s = g_value_dup_string(value);
+				break;
+
+			case TCORE_UTIL_MARSHAL_DATA_OBJECT_TYPE:
+				slot->v.o = _tcore_util_marshal_dup(g_value_get_boxed(value));
+				break;
+
+			default:
+				continue;
+		}
+
+		slot->present = TRUE;
+	}
+
+	return rec;
+}
@@ -0,0 +1,419 @@
+/*
+ * libtcore
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * BCD number codec self-test and bulk ADN decoding benchmark.
+ *
+ * Builds a phonebook of EF-ADN records (TS 31.102 4.4.2.3) with numbers
+ * of 0 to 20 digits over '0'-'9', '*', '#', pause and wild, some empty
+ * records, and the 0xF filler of odd lengths.
+ *
+ * Self-test: tcore_util_bcd_decode(), tcore_util_convert_bcd2ascii() and
+ * tcore_sim_decode_xdn() must give back the digits each record was built
+ * from, tcore_util_bcd_encode() and tcore_sim_encode_xdn() the record
+ * octets. Fixed vectors cover RFU nibbles, filler ending the number,
+ * short buffers and characters with no BCD code.
+ *
+ * Benchmark: the numbers of all records decoded with a per-nibble switch
+ * (the decoder the codec replaces), tcore_util_convert_bcd2ascii() and
+ * tcore_util_bcd_decode(), then whole records with tcore_sim_decode_xdn().
+ *
+ *   bcd_bench [-n rounds] [-r records]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "tcore.h"
+#include "util.h"
+#include "co_sim.h"
+
+#include "test_util.h"
+
+#define ADN_ALPHA_LEN		18
+#define ADN_RECORD_LEN		(ADN_ALPHA_LEN + 14)
+#define ADN_NUMBER_OCTETS	(SIM_XDN_NUMBER_LEN_MAX / 2)
+
+struct adn_entry {
+	unsigned char record[ADN_RECORD_LEN];
+	char digits[SIM_XDN_NUMBER_LEN_MAX + 1];
+	unsigned int digit_len;
+	gboolean empty;
+};
+
+struct bcd_vector {
+	unsigned char bcd[4];
+	unsigned int len;
+	const char *digits;
+};
+
+static const struct bcd_vector vectors[] = {
+	{ { 0x21, 0xF3 }, 2, "123" },
+	{ { 0x21, 0x3E }, 2, "123" },
+	{ { 0xA1, 0xDB }, 2, "1*#?" },
+	{ { 0xC1, 0x0E }, 2, "1P0" },
+	{ { 0x21, 0xFF, 0x43 }, 3, "12" },
+	{ { 0xEE, 0xEE }, 2, "" },
+	{ { 0x1F, 0x32 }, 2, "" },
+	{ { 0xF1 }, 1, "1" },
+	{ { 0xFF }, 1, "" },
+};
+
+static const char dial_chars[] = "0123456789*#P?";
+
+static unsigned char _nibble(char c)
+{
+	return strchr(dial_chars, c) - dial_chars;
+}
+
+/* Record layout independent of the library, octets unused stay 0xFF */
+static void _build_entry(struct adn_entry *e, unsigned int index)
+{
+	unsigned int ton = test_rand() % 3;
+	unsigned int npi = (test_rand() % 2) ? 1 : 0;
+	unsigned char *number;
+	unsigned int i;
+
+	memset(e, 0, sizeof(struct adn_entry));
+	memset(e->record, 0xFF, ADN_RECORD_LEN);
+
+	/* Every 8th record is deleted */
+	if ((index % 8) == 7) {
+		e->empty = TRUE;
+		return;
+	}
+
+	snprintf((char *) e->record, ADN_ALPHA_LEN, "Contact %u", index);
+	e->record[strlen((char *) e->record)] = 0xFF;
+
+	/* Mostly dialable digits, sometimes the DTMF characters */
+	e->digit_len = test_rand() % (SIM_XDN_NUMBER_LEN_MAX + 1);
+	for (i = 0; i < e->digit_len; i++)
+		e->digits[i] = dial_chars[(test_rand() % 4) ? test_rand() % 10 : test_rand() % 14];
+
+	number = e->record + ADN_ALPHA_LEN + 2;
+	for (i = 0; i < e->digit_len; i++) {
+		if (i % 2)
+			number[i / 2] = (number[i / 2] & 0x0F) | (_nibble(e->digits[i]) << 4);
+		else
+			number[i / 2] = 0xF0 | _nibble(e->digits[i]);
+	}
+
+	e->record[ADN_ALPHA_LEN] = (e->digit_len + 1) / 2 + 1;
+	e->record[ADN_ALPHA_LEN + 1] = 0x80 | (ton << 4) | npi;
+}
+
+/* The per-nibble switch the codec replaces */
+static unsigned int _decode_switch(const unsigned char *bcd, unsigned int len, char *dest)
+{
+	unsigned int i, k;
+	unsigned int o = 0;
+	unsigned char nibble;
+
+	memset(dest, 0, len * 2 + 1);
+
+	for (i = 0; i < len; i++) {
+		for (k = 0; k < 2; k++) {
+			nibble = k ? (bcd[i] >> 4) : (bcd[i] & 0x0F);
+
+			switch (nibble) {
+				case 0x0A:
+					dest[o++] = '*';
+					break;
+
+				case 0x0B:
+					dest[o++] = '#';
+					break;
+
+				case 0x0C:
+					dest[o++] = 'P';
+					break;
+
+				case 0x0D:
+					dest[o++] = '?';
+					break;
+
+				case 0x0E:
+					break;
+
+				case 0x0F:
+					return o;
+
+				default:
+					dest[o++] = nibble + '0';
+					break;
+			}
+		}
+	}
+
+	return o;
+}
+
+static unsigned int _number_octets(const struct adn_entry *e)
+{
+	const unsigned char *number = e->record + ADN_ALPHA_LEN + 2;
+	unsigned int len = 0;
+
+	while (len < ADN_NUMBER_OCTETS && number[len] != 0xFF)
+		len++;
+
+	return len;
+}
+
+static int _check_entry(const struct adn_entry *e, unsigned int index)
+{
+	const unsigned char *number = e->record + ADN_ALPHA_LEN + 2;
+	unsigned int octets = _number_octets(e);
+	struct tel_sim_dialing_number xdn;
+	char digits[SIM_XDN_NUMBER_LEN_MAX + 1];
+	unsigned char bcd[ADN_NUMBER_OCTETS];
+	char record[ADN_RECORD_LEN];
+	unsigned int len;
+	char *legacy;
+	int failed = 0;
+
+	if (e->empty) {
+		if (tcore_sim_decode_xdn(&xdn, (unsigned char *) e->record, ADN_RECORD_LEN) != FALSE) {
+			printf("record %u: empty record decoded\n", index);
+			failed++;
+		}
+		return failed;
+	}
+
+	if (tcore_util_bcd_decode(number, octets, digits, sizeof(digits), &len) != TCORE_RETURN_SUCCESS
+			|| len != e->digit_len || strcmp(digits, e->digits) != 0) {
+		printf("record %u: bcd_decode \"%s\", expected \"%s\"\n", index, digits, e->digits);
+		failed++;
+	}
+
+	legacy = tcore_util_convert_bcd2ascii((const char *) number, octets, SIM_XDN_NUMBER_LEN_MAX);
+	if (!legacy || strcmp(legacy, e->digits) != 0) {
+		printf("record %u: convert_bcd2ascii \"%s\", expected \"%s\"\n", index,
+				legacy ? legacy : "(null)", e->digits);
+		failed++;
+	}
+	free(legacy);
+
+	if (tcore_util_bcd_encode(e->digits, e->digit_len, bcd, sizeof(bcd), &len) != TCORE_RETURN_SUCCESS
+			|| len != octets || memcmp(bcd, number, octets) != 0) {
+		printf("record %u: bcd_encode differs\n", index);
+		failed++;
+	}
+
+	if (tcore_sim_decode_xdn(&xdn, (unsigned char *) e->record, ADN_RECORD_LEN) == FALSE
+			|| strcmp(xdn.DiallingNum, e->digits) != 0
+			|| xdn.DiallingnumLength != (int) e->digit_len
+			|| xdn.TypeOfNumber != (enum tel_sim_ton) ((e->record[ADN_ALPHA_LEN + 1] >> 4) & 0x07)
+			|| xdn.NumberingPlanIdent != (enum tel_sim_npi) (e->record[ADN_ALPHA_LEN + 1] & 0x0F)) {
+		printf("record %u: decode_xdn \"%s\", expected \"%s\"\n", index, xdn.DiallingNum, e->digits);
+		failed++;
+		return failed;
+	}
+
+	if (tcore_sim_encode_xdn(record, ADN_RECORD_LEN, &xdn) == FALSE
+			|| memcmp(record, e->record, ADN_RECORD_LEN) != 0) {
+		printf("record %u: encode_xdn differs from the record\n", index);
+		failed++;
+	}
+
+	return failed;
+}
+
+static int _check_vectors(void)
+{
+	char digits[16];
+	unsigned char bcd[4];
+	unsigned int len;
+	unsigned int ton, npi;
+	unsigned int i;
+	int failed = 0;
+
+	for (i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+		if (tcore_util_bcd_decode(vectors[i].bcd, vectors[i].len, digits, sizeof(digits), &len)
+				!= TCORE_RETURN_SUCCESS || strcmp(digits, vectors[i].digits) != 0
+				|| len != strlen(vectors[i].digits)) {
+			printf("vector %u: \"%s\", expected \"%s\"\n", i, digits, vectors[i].digits);
+			failed++;
+		}
+	}
+
+	/* Room for 3 digits and the NUL only */
+	if (tcore_util_bcd_decode(vectors[2].bcd, vectors[2].len, digits, 4, &len)
+			!= TCORE_RETURN_EMSGSIZE || len != 3 || strcmp(digits, "1*#") != 0) {
+		printf("short decode buffer not reported\n");
+		failed++;
+	}
+
+	if (tcore_util_bcd_encode("12x4", 4, bcd, sizeof(bcd), &len) != TCORE_RETURN_EINVAL) {
+		printf("character with no BCD code accepted\n");
+		failed++;
+	}
+
+	if (tcore_util_bcd_encode("12345", 5, bcd, 2, &len) != TCORE_RETURN_EMSGSIZE) {
+		printf("short encode buffer accepted\n");
+		failed++;
+	}
+
+	if (tcore_util_bcd_encode("1,p", 3, bcd, sizeof(bcd), &len) != TCORE_RETURN_SUCCESS
+			|| len != 2 || bcd[0] != 0xC1 || bcd[1] != 0xFC) {
+		printf("pause characters not encoded\n");
+		failed++;
+	}
+
+	for (i = 0; i < 8 * 16; i++) {
+		tcore_util_decode_ton_npi(tcore_util_encode_ton_npi(i / 16, i % 16), &ton, &npi);
+		if (ton != i / 16 || npi != i % 16) {
+			printf("TON/NPI %u/%u decoded as %u/%u\n", i / 16, i % 16, ton, npi);
+			failed++;
+		}
+	}
+
+	return failed;
+}
+
+static int _self_test(const struct adn_entry *book, unsigned int records)
+{
+	unsigned int i;
+	int failed;
+
+	failed = _check_vectors();
+
+	for (i = 0; i < records && failed < 10; i++)
+		failed += _check_entry(&book[i], i);
+
+	return failed ? -1 : 0;
+}
+
+static void _report(const char *name, gint64 start, unsigned int rounds, unsigned int records)
+{
+	gint64 elapsed = g_get_monotonic_time() - start;
+
+	if (elapsed <= 0)
+		elapsed = 1;
+
+	printf("%-18s: %10.0f records/s %8.1f ns/record\n", name,
+			(double) rounds * records * 1000000 / elapsed,
+			(double) elapsed * 1000 / ((double) rounds * records));
+}
+
+static void _bench(const struct adn_entry *book, unsigned int records, unsigned int rounds)
+{
+	struct tel_sim_dialing_number xdn;
+	char digits[SIM_XDN_NUMBER_LEN_MAX + 1];
+	unsigned int *octets;
+	char *legacy;
+	gint64 start;
+	unsigned int r, i;
+
+	/* Number lengths are found once, every decoder gets the same input */
+	octets = malloc(records * sizeof(unsigned int));
+	if (!octets)
+		return;
+
+	for (i = 0; i < records; i++)
+		octets[i] = book[i].empty ? 0 : _number_octets(&book[i]);
+
+	start = g_get_monotonic_time();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < records; i++)
+			_decode_switch(book[i].record + ADN_ALPHA_LEN + 2, octets[i], digits);
+	}
+	_report("nibble switch", start, rounds, records);
+
+	start = g_get_monotonic_time();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < records; i++) {
+			legacy = tcore_util_convert_bcd2ascii(
+					(const char *) book[i].record + ADN_ALPHA_LEN + 2,
+					octets[i], SIM_XDN_NUMBER_LEN_MAX);
+			free(legacy);
+		}
+	}
+	_report("convert_bcd2ascii", start, rounds, records);
+
+	start = g_get_monotonic_time();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < records; i++)
+			tcore_util_bcd_decode(book[i].record + ADN_ALPHA_LEN + 2, octets[i],
+					digits, sizeof(digits), NULL);
+	}
+	_report("bcd_decode", start, rounds, records);
+
+	start = g_get_monotonic_time();
+	for (r = 0; r < rounds; r++) {
+		for (i = 0; i < records; i++)
+			tcore_sim_decode_xdn(&xdn, (unsigned char *) book[i].record, ADN_RECORD_LEN);
+	}
+	_report("decode_xdn", start, rounds, records);
+
+	free(octets);
+}
+
+int main(int argc, char *argv[])
+{
+	struct adn_entry *book;
+	unsigned int records = 500;
+	unsigned int rounds = 1000;
+	unsigned int i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:r:")) != -1) {
+		switch (opt) {
+			case 'n':
+				rounds = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'r':
+				records = strtoul(optarg, NULL, 0);
+				break;
+
+			default:
+				fprintf(stderr, "usage: %s [-n rounds] [-r records]\n", argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (records == 0 || rounds == 0) {
+		fprintf(stderr, "invalid round or record count\n");
+		return EXIT_FAILURE;
+	}
+
+	book = malloc(records * sizeof(struct adn_entry));
+	if (!book)
+		return EXIT_FAILURE;
+
+	for (i = 0; i < records; i++)
+		_build_entry(&book[i], i);
+
+	if (_self_test(book, records) < 0) {
+		printf("FAIL: BCD codec differs from the reference\n");
+		free(book);
+		return EXIT_FAILURE;
+	}
+	printf("self-test: %u ADN records decode and encode back identically\n", records);
+
+	_bench(book, records, rounds);
+
+	free(book);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,605 @@
+/*
+ * libtcore
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * CMUX decoder benchmark.
+ *
+ * Builds a stream of every frame type (UIH and UI data, SABM, UA, DM, DISC,
+ * MSC/FCon/Test control messages) with corrupted frames mixed in, and feeds
+ * it to the decoder in several read chunkings. Data frames carry numbered
+ * "+BENCH:" lines picked up by AT notifications on the Logical HALs.
+ *
+ * Every corruption is followed by two rounds of data frames over all
+ * Channels; the second round must be delivered completely, otherwise the
+ * decoder did not re-synchronise and the run fails. The lines delivered
+ * must not depend on how the stream is split in reads either.
+ *
+ *   cmux_bench [-n frames] [-e corrupt_every] [-s seed] [-o corpus_prefix]
+ *
+ * With -o the streams are also written to <corpus_prefix>-basic and
+ * <corpus_prefix>-advanced, as seeds for cmux_fuzz.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "tcore.h"
+#include "plugin.h"
+#include "core_object.h"
+#include "hal.h"
+#include "at.h"
+#include "mux.h"
+
+#include "test_util.h"
+
+#define BENCH_CHANNELS		4	/* data Channels, DLCI 1..4 */
+#define BENCH_PREFIX		"+BENCH:"
+
+#define BASIC_FLAG			0xF9
+#define ADVANCED_FLAG		0x7E
+#define ADVANCED_ESCAPE		0x7D
+
+#define FRAME_SABM			0x2F
+#define FRAME_UA			0x63
+#define FRAME_DM			0x0F
+#define FRAME_DISC			0x43
+#define FRAME_UIH			0xEF
+#define FRAME_UI			0x03
+#define FRAME_PF			0x10
+
+struct bench_stream {
+	unsigned char *buf;
+	size_t len;
+	size_t size;
+
+	unsigned int frames;
+	unsigned int lines;
+	unsigned int corruptions;
+
+	/* per line: 1 sent, 2 must be delivered (resync round) */
+	unsigned char *expect;
+	unsigned int expect_size;
+};
+
+struct bench_chunking {
+	const char *name;
+	size_t min;
+	size_t max;
+};
+
+static const struct bench_chunking chunkings[] = {
+	{ "1",       1,   1 },
+	{ "1-16",    1,   16 },
+	{ "64-512",  64,  512 },
+	{ "4096",    4096, 4096 },
+	{ "whole",   0,   0 },
+};
+
+static const struct tcore_cmux_channel_object bench_map[BENCH_CHANNELS + 1] = {
+	{ "bench_0", { NULL, NULL, NULL } },
+	{ "bench_1", { "bench_co_1", NULL, NULL } },
+	{ "bench_2", { "bench_co_2", NULL, NULL } },
+	{ "bench_3", { "bench_co_3", NULL, NULL } },
+	{ "bench_4", { "bench_co_4", NULL, NULL } },
+};
+
+static unsigned char *delivered;
+static unsigned char *reference;
+static unsigned int delivered_size;
+
+static unsigned int _rand_range(unsigned int min, unsigned int max)
+{
+	return min + (test_rand() % (max - min + 1));
+}
+
+/* 27.010 FCS, bit by bit, independent from the table driven decoder */
+static unsigned char _fcs(const unsigned char *p, unsigned int len)
+{
+	unsigned char fcs = 0xFF;
+	int bit;
+
+	while (len--) {
+		fcs ^= *p++;
+		for (bit = 0; bit < 8; bit++)
+			fcs = (fcs & 0x01) ? (fcs >> 1) ^ 0xE0 : (fcs >> 1);
+	}
+
+	return 0xFF - fcs;
+}
+
+static void _stream_put(struct bench_stream *s, const unsigned char *data, size_t len)
+{
+	if (s->len + len > s->size) {
+		while (s->len + len > s->size)
+			s->size = s->size ? s->size * 2 : 65536;
+
+		s->buf = realloc(s->buf, s->size);
+		if (!s->buf) {
+			fprintf(stderr, "out of memory\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	memcpy(s->buf + s->len, data, len);
+	s->len += len;
+}
+
+/* Encodes one frame, returns its length in 'out' */
+static size_t _encode_frame(enum tcore_cmux_mode mode, unsigned char *out,
+		unsigned int dlci, unsigned char control,
+		const unsigned char *info, unsigned int info_len)
+{
+	unsigned char raw[8 + 4096];
+	unsigned int header_len = 0;
+	unsigned int raw_len;
+	unsigned int i;
+	size_t len = 0;
+
+	raw[header_len++] = (dlci << 2) | 0x03;	/* EA, C/R */
+	raw[header_len++] = control;
+
+	if (CMUX_MODE_BASIC == mode) {
+		if (info_len < 128) {
+			raw[header_len++] = (info_len << 1) | 0x01;
+		} else {
+			raw[header_len++] = info_len << 1;
+			raw[header_len++] = info_len >> 7;
+		}
+	}
+
+	if (info_len)
+		memcpy(raw + header_len, info, info_len);
+	raw_len = header_len + info_len;
+
+	/* FCS over the header, over the Information field too for UI */
+	if (FRAME_UI == (control & ~FRAME_PF))
+		raw[raw_len] = _fcs(raw, raw_len);
+	else
+		raw[raw_len] = _fcs(raw, header_len);
+	raw_len++;
+
+	if (CMUX_MODE_BASIC == mode) {
+		out[len++] = BASIC_FLAG;
+		memcpy(out + len, raw, raw_len);
+		len += raw_len;
+		out[len++] = BASIC_FLAG;
+		return len;
+	}
+
+	out[len++] = ADVANCED_FLAG;
+	for (i = 0; i < raw_len; i++) {
+		if (raw[i] == ADVANCED_FLAG || raw[i] == ADVANCED_ESCAPE) {
+			out[len++] = ADVANCED_ESCAPE;
+			out[len++] = raw[i] ^ 0x20;
+		} else {
+			out[len++] = raw[i];
+		}
+	}
+	out[len++] = ADVANCED_FLAG;
+
+	return len;
+}
+
+static void _put_frame(struct bench_stream *s, enum tcore_cmux_mode mode,
+		unsigned int dlci, unsigned char control,
+		const unsigned char *info, unsigned int info_len)
+{
+	unsigned char out[2 * (8 + 4096)];
+
+	_stream_put(s, out, _encode_frame(mode, out, dlci, control, info, info_len));
+	s->frames++;
+}
+
+/* UIH or UI frame holding one numbered line */
+static void _put_line(struct bench_stream *s, enum tcore_cmux_mode mode,
+		unsigned int dlci, gboolean must_deliver)
+{
+	static const char pad[] = "0123456789ABCDEF";
+	char line[4096];
+	unsigned int len;
+	unsigned int pad_len;
+	unsigned int i;
+
+	if (s->lines == s->expect_size) {
+		s->expect_size = s->expect_size ? s->expect_size * 2 : 4096;
+		s->expect = realloc(s->expect, s->expect_size);
+		if (!s->expect) {
+			fprintf(stderr, "out of memory\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	/* Mostly short responses, some PDU sized and a few near N1 */
+	switch (test_rand() % 16) {
+		case 0:
+			pad_len = _rand_range(1024, 3000);
+			break;
+
+		case 1:
+		case 2:
+		case 3:
+			pad_len = _rand_range(128, 400);
+			break;
+
+		default:
+			pad_len = _rand_range(0, 64);
+			break;
+	}
+
+	len = snprintf(line, sizeof(line), "\r\n" BENCH_PREFIX " %u,", s->lines);
+	for (i = 0; i < pad_len; i++)
+		line[len++] = pad[test_rand() & 0x0F];
+	line[len++] = '\r';
+	line[len++] = '\n';
+
+	_put_frame(s, mode, dlci, (test_rand() % 8) ? FRAME_UIH : FRAME_UI,
+			(const unsigned char *) line, len);
+
+	s->expect[s->lines++] = must_deliver ? 2 : 1;
+}
+
+/* Any frame other than data: link control on the data Channels, control
+ * messages on the Control Channel. Nothing that closes the MUX.
+ */
+static void _put_control(struct bench_stream *s, enum tcore_cmux_mode mode)
+{
+	unsigned char msg[8];
+	unsigned int dlci = _rand_range(1, BENCH_CHANNELS);
+
+	switch (test_rand() % 7) {
+		case 0:
+			_put_frame(s, mode, dlci, FRAME_SABM | FRAME_PF, NULL, 0);
+			break;
+
+		case 1:
+			_put_frame(s, mode, dlci, FRAME_UA | FRAME_PF, NULL, 0);
+			break;
+
+		case 2:
+			_put_frame(s, mode, dlci, FRAME_DM | FRAME_PF, NULL, 0);
+			break;
+
+		case 3:
+			_put_frame(s, mode, dlci, FRAME_DISC | FRAME_PF, NULL, 0);
+			break;
+
+		case 4:
+			/* MSC command: RTC and RTR, no flow control */
+			msg[0] = 0xE3;
+			msg[1] = (2 << 1) | 0x01;
+			msg[2] = (dlci << 2) | 0x03;
+			msg[3] = 0x0D;
+			_put_frame(s, mode, 0, FRAME_UIH, msg, 4);
+			break;
+
+		case 5:
+			/* FCon command */
+			msg[0] = 0xA3;
+			msg[1] = 0x01;
+			_put_frame(s, mode, 0, FRAME_UIH, msg, 2);
+			break;
+
+		default:
+			/* Test command, answered with NSC */
+			msg[0] = 0x23;
+			msg[1] = (4 << 1) | 0x01;
+			msg[2] = 'P';
+			msg[3] = 'I';
+			msg[4] = 'N';
+			msg[5] = 'G';
+			_put_frame(s, mode, 0, FRAME_UIH, msg, 6);
+			break;
+	}
+}
+
+/* A corrupted frame may take the frames behind it along (basic mode UIH
+ * has no FCS over the Information field), but never more than the 88 or
+ * more octets of the first round of data frames that follows it.
+ */
+static void _put_corruption(struct bench_stream *s, enum tcore_cmux_mode mode)
+{
+	unsigned char out[2 * (8 + 4096)];
+	unsigned char info[60];
+	size_t len;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(info); i++)
+		info[i] = 'a' + (test_rand() % 26);
+
+	switch (test_rand() % 4) {
+		case 0:
+			/* Line noise, Flags included */
+			len = _rand_range(1, 32);
+			for (i = 0; i < len; i++) {
+				out[i] = test_rand();
+				if (test_rand() % 4 == 0)
+					out[i] = (CMUX_MODE_BASIC == mode) ? BASIC_FLAG : ADVANCED_FLAG;
+			}
+			break;
+
+		case 1:
+			/* Frame cut short, the next one follows right away */
+			len = _encode_frame(mode, out, _rand_range(1, BENCH_CHANNELS), FRAME_UIH,
+					info, _rand_range(1, sizeof(info)));
+			len = _rand_range(2, len - 2);
+			break;
+
+		case 2:
+			/* Bad FCS */
+			len = _encode_frame(mode, out, _rand_range(1, BENCH_CHANNELS), FRAME_UIH,
+					info, _rand_range(1, sizeof(info)));
+			out[len - 2] ^= 0x01;
+			if (out[len - 2] == ADVANCED_FLAG || out[len - 2] == ADVANCED_ESCAPE
+					|| out[len - 2] == BASIC_FLAG)
+				out[len - 2] ^= 0x02;
+			break;
+
+		default:
+			/* Header bit error: address, control or length */
+			len = _encode_frame(mode, out, _rand_range(1, BENCH_CHANNELS), FRAME_UIH,
+					info, _rand_range(1, 20));
+			out[_rand_range(1, 3)] ^= 1 << (test_rand() % 8);
+			break;
+	}
+
+	_stream_put(s, out, len);
+	s->corruptions++;
+}
+
+static void _build_stream(struct bench_stream *s, enum tcore_cmux_mode mode,
+		unsigned int frames, unsigned int corrupt_every)
+{
+	unsigned int dlci;
+
+	memset(s, 0, sizeof(*s));
+
+	/* UA for the SABM of every DLC */
+	for (dlci = 0; dlci <= BENCH_CHANNELS; dlci++)
+		_put_frame(s, mode, dlci, FRAME_UA | FRAME_PF, NULL, 0);
+
+	while (s->frames < frames) {
+		if (corrupt_every && (test_rand() % corrupt_every) == 0) {
+			_put_corruption(s, mode);
+
+			/* The first round may be lost with the corrupted frame,
+			 * the second one must get through on every Channel.
+			 */
+			for (dlci = 1; dlci <= BENCH_CHANNELS; dlci++)
+				_put_line(s, mode, dlci, FALSE);
+			for (dlci = 1; dlci <= BENCH_CHANNELS; dlci++)
+				_put_line(s, mode, dlci, TRUE);
+
+			continue;
+		}
+
+		if (test_rand() % 5 == 0)
+			_put_control(s, mode);
+		else
+			_put_line(s, mode, _rand_range(1, BENCH_CHANNELS), FALSE);
+	}
+}
+
+static gboolean _on_line(TcoreAT *at, const GSList *lines, void *user_data)
+{
+	const char *line = lines->data;
+	char *end = NULL;
+	unsigned long seq;
+
+	seq = strtoul(line + strlen(BENCH_PREFIX), &end, 10);
+	if (!end || *end != ',' || seq >= delivered_size)
+		return TRUE;
+
+	delivered[seq] = 1;
+
+	return TRUE;
+}
+
+static TReturn _phy_send(TcoreHal *hal, unsigned int data_len, void *data)
+{
+	return TCORE_RETURN_SUCCESS;
+}
+
+static struct tcore_hal_operations phy_ops = {
+	.send = _phy_send,
+};
+
+static int _run(TcorePlugin *p, CoreObject **co, const struct bench_stream *s,
+		enum tcore_cmux_mode mode, const struct bench_chunking *chunking)
+{
+	TcoreHal *phy;
+	TcoreHal *hal;
+	unsigned char *data;
+	gint64 start;
+	gint64 elapsed;
+	size_t pos = 0;
+	size_t chunk;
+	unsigned int sent = 0, got = 0;
+	unsigned int resync = 0, resync_got = 0;
+	unsigned int mismatch = 0;
+	unsigned int i;
+
+	phy = tcore_hal_new(p, "bench_phy", &phy_ops, TCORE_HAL_MODE_AT);
+	if (!phy)
+		return -1;
+
+	if (tcore_cmux_init_hal(p, phy, mode, 0, bench_map, BENCH_CHANNELS + 1) != TCORE_RETURN_SUCCESS) {
+		fprintf(stderr, "tcore_cmux_init_hal() failed\n");
+		tcore_hal_free(phy);
+		return -1;
+	}
+
+	for (i = 0; i < BENCH_CHANNELS; i++) {
+		hal = tcore_object_get_hal(co[i]);
+		tcore_at_add_notification(tcore_hal_get_at(hal), BENCH_PREFIX, FALSE, _on_line, NULL);
+	}
+
+	memset(delivered, 0, delivered_size);
+
+	/* Reads are decoded in place, feed a copy */
+	data = malloc(s->len);
+	if (!data) {
+		tcore_hal_free(phy);
+		return -1;
+	}
+	memcpy(data, s->buf, s->len);
+
+	start = g_get_monotonic_time();
+
+	while (pos < s->len) {
+		chunk = chunking->max ? _rand_range(chunking->min, chunking->max) : s->len;
+		if (chunk > s->len - pos)
+			chunk = s->len - pos;
+
+		tcore_cmux_rcv_hal(phy, data + pos, chunk);
+		pos += chunk;
+	}
+
+	while (g_main_context_iteration(NULL, FALSE));
+
+	elapsed = g_get_monotonic_time() - start;
+	if (elapsed <= 0)
+		elapsed = 1;
+
+	for (i = 0; i < s->lines; i++) {
+		sent++;
+		got += delivered[i];
+
+		if (s->expect[i] == 2) {
+			resync++;
+			resync_got += delivered[i];
+		}
+
+		if (chunking != &chunkings[0] && delivered[i] != reference[i])
+			mismatch++;
+	}
+
+	printf("%-8s chunk %-6s: %7u frames %8.2f MB %10.0f frames/s %8.2f MB/s"
+			"  lines %u/%u  resync %u/%u",
+			(CMUX_MODE_BASIC == mode) ? "basic" : "advanced", chunking->name,
+			s->frames, s->len / 1e6,
+			s->frames * 1e6 / elapsed, s->len / (double) elapsed,
+			got, sent, resync_got, resync);
+	if (mismatch)
+		printf("  %u lines differ from chunk %s", mismatch, chunkings[0].name);
+	printf("\n");
+
+	tcore_hal_free(phy);
+	free(data);
+
+	return (resync_got == resync && mismatch == 0) ? 0 : -1;
+}
+
+int main(int argc, char *argv[])
+{
+	TcorePlugin *p;
+	CoreObject *co[BENCH_CHANNELS];
+	struct bench_stream s;
+	enum tcore_cmux_mode mode;
+	unsigned int frames = 20000;
+	unsigned int corrupt_every = 32;
+	unsigned int seed = 1;
+	const char *corpus = NULL;
+	char *path;
+	FILE *fp;
+	unsigned int i;
+	int failed = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:e:s:o:")) != -1) {
+		switch (opt) {
+			case 'n':
+				frames = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'e':
+				corrupt_every = strtoul(optarg, NULL, 0);
+				break;
+
+			case 's':
+				seed = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'o':
+				corpus = optarg;
+				break;
+
+			default:
+				fprintf(stderr, "usage: %s [-n frames] [-e corrupt_every] [-s seed] [-o corpus_prefix]\n", argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	test_srand(seed);
+
+	p = tcore_plugin_new(NULL, NULL, "cmux_bench", NULL);
+	if (!p)
+		return EXIT_FAILURE;
+
+	for (i = 0; i < BENCH_CHANNELS; i++)
+		co[i] = tcore_object_new(p, bench_map[i + 1].core_object_name[0], NULL);
+
+	for (mode = CMUX_MODE_BASIC; mode <= CMUX_MODE_ADVANCED; mode++) {
+		_build_stream(&s, mode, frames, corrupt_every);
+
+		delivered_size = s.lines;
+		delivered = calloc(delivered_size ? delivered_size : 1, 1);
+		reference = calloc(delivered_size ? delivered_size : 1, 1);
+		if (!delivered || !reference)
+			return EXIT_FAILURE;
+
+		for (i = 0; i < sizeof(chunkings) / sizeof(chunkings[0]); i++) {
+			if (_run(p, co, &s, mode, &chunkings[i]) < 0)
+				failed = 1;
+
+			/* Octet by octet reads are the reference for the others */
+			if (i == 0)
+				memcpy(reference, delivered, delivered_size);
+		}
+
+		/* Seed for the fuzz target: mode octet, then the stream */
+		if (corpus) {
+			path = g_strdup_printf("%s-%s", corpus,
+					(CMUX_MODE_BASIC == mode) ? "basic" : "advanced");
+			fp = fopen(path, "wb");
+			if (fp) {
+				fputc((CMUX_MODE_BASIC == mode) ? 0x04 : 0x05, fp);
+				fwrite(s.buf, 1, s.len, fp);
+				fclose(fp);
+			}
+			g_free(path);
+		}
+
+		free(delivered);
+		free(reference);
+		free(s.buf);
+		free(s.expect);
+	}
+
+	tcore_plugin_free(p);
+
+	if (failed) {
+		printf("FAIL: lines lost after re-synchronisation or depending on the read size\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
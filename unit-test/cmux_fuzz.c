@@ -0,0 +1,177 @@
+/*
+ * libtcore
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * CMUX decoder fuzz target.
+ *
+ * Built with -fsanitize=fuzzer (ENABLE_FUZZER) it is a libFuzzer target,
+ * otherwise it runs each file given on the command line, or stdin, once
+ * (AFL, corpus replay).
+ *
+ * Input layout:
+ *   octet 0     bit 0: Advanced mode, bit 1: negotiate N1 from octets 1-2,
+ *               bits 2-7: seed of the read chunking
+ *   octet 1-2   N1 (little endian), only with bit 1
+ *   rest        octets received on the Physical HAL
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "tcore.h"
+#include "hal.h"
+#include "mux.h"
+
+int LLVMFuzzerTestOneInput(const unsigned char *data, size_t size);
+
+static TReturn _phy_send(TcoreHal *hal, unsigned int data_len, void *data)
+{
+	return TCORE_RETURN_SUCCESS;
+}
+
+static struct tcore_hal_operations phy_ops = {
+	.send = _phy_send,
+};
+
+int LLVMFuzzerTestOneInput(const unsigned char *data, size_t size)
+{
+	TcoreHal *phy;
+	enum tcore_cmux_mode mode;
+	unsigned int frame_size = 0;
+	unsigned int seed;
+	unsigned char *stream;
+	size_t pos = 0;
+	size_t chunk;
+
+	if (size < 1)
+		return 0;
+
+	mode = (data[0] & 0x01) ? CMUX_MODE_ADVANCED : CMUX_MODE_BASIC;
+	seed = (data[0] >> 2) + 1;
+
+	if (data[0] & 0x02) {
+		if (size < 3)
+			return 0;
+
+		frame_size = 1 + ((data[1] | (data[2] << 8)) % 32767);
+		data += 3;
+		size -= 3;
+	} else {
+		data++;
+		size--;
+	}
+
+	phy = tcore_hal_new(NULL, "fuzz", &phy_ops, TCORE_HAL_MODE_AT);
+	if (!phy)
+		return 0;
+
+	if (tcore_cmux_init_hal(NULL, phy, mode, frame_size, NULL, 0) != TCORE_RETURN_SUCCESS) {
+		tcore_hal_free(phy);
+		return 0;
+	}
+
+	/* The decoder works on the read in place, give it a writable copy */
+	stream = malloc(size + 1);
+	if (!stream) {
+		tcore_hal_free(phy);
+		return 0;
+	}
+	memcpy(stream, data, size);
+
+	/* Split the input in reads of 1 to 64 octets, or all at once */
+	while (pos < size) {
+		seed = seed * 1103515245 + 12345;
+		chunk = (seed >> 16) & 0x3F;
+		if (chunk == 0 || chunk > size - pos)
+			chunk = size - pos;
+
+		/* A received close down frees the MUX, the rest is ignored */
+		tcore_cmux_rcv_hal(phy, stream + pos, chunk);
+		pos += chunk;
+
+		while (g_main_context_iteration(NULL, FALSE));
+	}
+
+	tcore_hal_free(phy);
+	free(stream);
+
+	return 0;
+}
+
+#ifndef TCORE_LIBFUZZER
+static int _run_file(FILE *fp)
+{
+	unsigned char *buf = NULL;
+	unsigned char *tmp;
+	size_t len = 0;
+	size_t size = 0;
+	size_t n;
+
+	while (1) {
+		if (len == size) {
+			size = size ? size * 2 : 4096;
+			tmp = realloc(buf, size);
+			if (!tmp) {
+				free(buf);
+				return -1;
+			}
+			buf = tmp;
+		}
+
+		n = fread(buf + len, 1, size - len, fp);
+		if (n == 0)
+			break;
+
+		len += n;
+	}
+
+	LLVMFuzzerTestOneInput(buf, len);
+	free(buf);
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	FILE *fp;
+	int i;
+
+	if (argc < 2)
+		return _run_file(stdin) ? EXIT_FAILURE : EXIT_SUCCESS;
+
+	for (i = 1; i < argc; i++) {
+		fp = fopen(argv[i], "rb");
+		if (!fp) {
+			fprintf(stderr, "%s: cannot open\n", argv[i]);
+			return EXIT_FAILURE;
+		}
+
+		if (_run_file(fp) < 0) {
+			fclose(fp);
+			return EXIT_FAILURE;
+		}
+
+		fclose(fp);
+	}
+
+	return EXIT_SUCCESS;
+}
+#endif
@@ -0,0 +1,517 @@
+/*
+ * libtcore
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * GSM 7-bit codec self-test and benchmark.
+ *
+ * Self-test: tcore_util_gsm7bit_pack() and _unpack() against a bit at a
+ * time packer for every fill_bits 0..6 and every length up to 300 septets,
+ * which covers each length around a multiple of 8; unpack must not write
+ * past dest_size. tcore_util_pack_gsm7bit() and _unpack_gsm7bit() must
+ * give the same octets as the bit by bit helpers they replaced. Fixed
+ * vectors cover the escape table, escapes with no extension entry, a
+ * trailing escape, unmappable and malformed UTF-8 and short buffers, then
+ * every septet and random texts go through UTF-8 and back.
+ *
+ * Benchmark: an SMS (160 septets), a concatenated SMS part behind a UDH
+ * (153 septets, 1 fill bit) and a 4K buffer, packed and unpacked with the
+ * bit by bit helpers and the codec, in MB of septets per second.
+ *
+ *   gsm7_bench [-m MB per size]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "tcore.h"
+#include "util.h"
+
+#include "test_util.h"
+
+#define CHECK_LENGTH_MAX	300
+#define BENCH_LENGTH_MAX	4096
+
+#define GSM7_ESC	0x1B
+
+struct bench_size {
+	const char *name;
+	unsigned int len;
+	unsigned int fill_bits;
+};
+
+static const struct bench_size bench_sizes[] = {
+	{ "SMS", 160, 0 },
+	{ "UDH", 153, 1 },
+	{ "4K", BENCH_LENGTH_MAX, 0 },
+};
+
+struct gsm7_vector {
+	unsigned char septets[8];
+	unsigned int len;
+	const char *utf8;
+};
+
+/* Decoding, the first five encode back to the same septets */
+static const struct gsm7_vector vectors[] = {
+	{ { 0x00, 0x01, 0x02, 0x10 }, 4, "@\xC2\xA3$\xCE\x94" },
+	{ { GSM7_ESC, 0x65 }, 2, "\xE2\x82\xAC" },
+	{ { GSM7_ESC, 0x28, GSM7_ESC, 0x29, GSM7_ESC, 0x3C, GSM7_ESC, 0x3E }, 8, "{}[]" },
+	{ { GSM7_ESC, 0x14, GSM7_ESC, 0x2F, GSM7_ESC, 0x3D, GSM7_ESC, 0x40 }, 8, "^\\~|" },
+	{ { 0x48, 0x69, GSM7_ESC, 0x0A }, 4, "Hi\f" },
+	/* No extension entry: the default alphabet character */
+	{ { GSM7_ESC, 0x41, GSM7_ESC, 0x00 }, 4, "A@" },
+	/* Trailing escape reads as a space */
+	{ { 0x41, GSM7_ESC }, 2, "A " },
+	{ { GSM7_ESC }, 1, " " },
+};
+
+/* The helpers tcore_util_pack_gsm7bit() and _unpack_gsm7bit() had before */
+static unsigned char *_legacy_unpack(const unsigned char *src, unsigned int src_len)
+{
+	unsigned char *dest;
+	int i = 0;
+	unsigned int pos = 0;
+	unsigned char shift = 0;
+	int outlen = 0;
+
+	if (!src || src_len == 0)
+		return NULL;
+
+	outlen = (src_len * 8) / 7;
+
+	dest = calloc(outlen + 1, 1);
+	if (!dest)
+		return NULL;
+
+	for (i = 0; pos < src_len; i++, pos++) {
+		dest[i] = (src[pos] << shift) & 0x7F;
+
+		if (pos != 0)
+			dest[i] |= src[pos - 1] >> (8 - shift);
+
+		shift++;
+
+		if (shift == 7) {
+			shift = 0;
+			i++;
+			dest[i] = src[pos] >> 1;
+		}
+	}
+
+	for (i = 0; i < outlen; i++)
+		if (dest[i] == '\r')
+			dest[i] = ' ';
+
+	dest[outlen] = '\0';
+
+	return dest;
+}
+
+static unsigned char *_legacy_pack(const unsigned char *src, unsigned int src_len)
+{
+	unsigned char *dest;
+	unsigned int i = 0;
+	unsigned int pos = 0, shift = 0;
+	unsigned int outlen = 0;
+
+	if (!src || src_len == 0)
+		return NULL;
+
+	outlen = ((src_len * 7) / 8) + 1;
+
+	dest = calloc(outlen + 1, 1);
+	if (!dest)
+		return NULL;
+
+	for (pos = 0, i = 0; i < src_len; pos++, i++) {
+		if (pos >= outlen) {
+			free(dest);
+			return NULL;
+		}
+
+		dest[pos] = src[i] >> shift;
+
+		if (i + 1 < src_len) {
+			dest[pos] |= src[i + 1] << (7 - shift);
+
+			shift++;
+
+			if (shift == 7) {
+				shift = 0;
+				i++;
+			}
+		}
+		else {
+			if (shift == 6)
+				dest[pos] |= 0x1a;
+		}
+	}
+
+	return dest;
+}
+
+/* 23.038 6.1.2.1.1: septet n starts at bit fill_bits + 7n, LSB first */
+static unsigned int _pack_bits(const unsigned char *septets, unsigned int count,
+		unsigned int fill_bits, unsigned char *dest)
+{
+	unsigned int len = (fill_bits + count * 7 + 7) / 8;
+	unsigned int bit;
+	unsigned int i;
+
+	memset(dest, 0, len);
+
+	for (i = 0; i < count * 7; i++) {
+		bit = fill_bits + i;
+		if (septets[i / 7] & (1 << (i % 7)))
+			dest[bit / 8] |= 1 << (bit % 8);
+	}
+
+	return len;
+}
+
+static int _check_length(const unsigned char *septets, unsigned int len, unsigned int fill_bits)
+{
+	unsigned char ref[CHECK_LENGTH_MAX + 1];
+	unsigned char packed[CHECK_LENGTH_MAX + 1];
+	unsigned char out[CHECK_LENGTH_MAX + 16];
+	unsigned int ref_len;
+	unsigned int packed_len;
+	unsigned int count;
+	unsigned int max;
+	TReturn ret;
+
+	ref_len = _pack_bits(septets, len, fill_bits, ref);
+
+	ret = tcore_util_gsm7bit_pack(septets, len, fill_bits, packed, ref_len, &packed_len);
+	if (ret != TCORE_RETURN_SUCCESS || packed_len != ref_len
+			|| memcmp(packed, ref, ref_len) != 0) {
+		printf("pack mismatch: %u septets, %u fill bits\n", len, fill_bits);
+		return 1;
+	}
+
+	/* Every septet the octets hold: the last may be padding */
+	max = (ref_len * 8 - fill_bits) / 7;
+	memset(out, 0xEE, sizeof(out));
+	ret = tcore_util_gsm7bit_unpack(packed, packed_len, fill_bits, out, sizeof(out), &count);
+	if (ret != TCORE_RETURN_SUCCESS || count != max || memcmp(out, septets, len) != 0
+			|| (count > len && out[len] != 0)) {
+		printf("unpack mismatch: %u septets, %u fill bits\n", len, fill_bits);
+		return 1;
+	}
+
+	/* Bounded by TP-UDL: nothing written past it */
+	memset(out, 0xEE, sizeof(out));
+	ret = tcore_util_gsm7bit_unpack(packed, packed_len, fill_bits, out, len, &count);
+	if (ret != TCORE_RETURN_SUCCESS || count != len || memcmp(out, septets, len) != 0
+			|| out[len] != 0xEE) {
+		printf("bounded unpack mismatch: %u septets, %u fill bits\n", len, fill_bits);
+		return 1;
+	}
+
+	if (len > 0 && tcore_util_gsm7bit_pack(septets, len, fill_bits, packed, ref_len - 1, NULL)
+			!= TCORE_RETURN_EMSGSIZE) {
+		printf("short pack buffer accepted: %u septets, %u fill bits\n", len, fill_bits);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int _check_legacy(const unsigned char *septets, unsigned int len)
+{
+	unsigned char *legacy;
+	unsigned char *codec;
+	unsigned int size;
+	int failed = 0;
+
+	/* Both allocate and zero one octet more than they fill */
+	size = (len * 7) / 8 + 2;
+	legacy = _legacy_pack(septets, len);
+	codec = tcore_util_pack_gsm7bit(septets, len);
+	if (!legacy || !codec || memcmp(legacy, codec, size) != 0) {
+		printf("pack differs from the bit by bit helper: %u septets\n", len);
+		failed++;
+	}
+	free(legacy);
+	free(codec);
+
+	/* Here 'len' is a count of octets */
+	size = (len * 8) / 7 + 1;
+	legacy = _legacy_unpack(septets, len);
+	codec = tcore_util_unpack_gsm7bit(septets, len);
+	if (!legacy || !codec || memcmp(legacy, codec, size) != 0) {
+		printf("unpack differs from the bit by bit helper: %u octets\n", len);
+		failed++;
+	}
+	free(legacy);
+	free(codec);
+
+	return failed;
+}
+
+static int _check_vectors(void)
+{
+	unsigned char septets[16];
+	char utf8[32];
+	unsigned int len;
+	unsigned int i;
+	TReturn ret;
+	int failed = 0;
+
+	for (i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+		ret = tcore_util_gsm7bit_to_utf8(vectors[i].septets, vectors[i].len,
+				utf8, sizeof(utf8), &len);
+		if (ret != TCORE_RETURN_SUCCESS || strcmp(utf8, vectors[i].utf8) != 0
+				|| len != strlen(vectors[i].utf8)) {
+			printf("vector %u: \"%s\", expected \"%s\"\n", i, utf8, vectors[i].utf8);
+			failed++;
+		}
+
+		if (i >= 5)
+			continue;
+
+		ret = tcore_util_utf8_to_gsm7bit(vectors[i].utf8, strlen(vectors[i].utf8),
+				septets, sizeof(septets), &len);
+		if (ret != TCORE_RETURN_SUCCESS || len != vectors[i].len
+				|| memcmp(septets, vectors[i].septets, len) != 0) {
+			printf("vector %u does not encode back\n", i);
+			failed++;
+		}
+	}
+
+	/* CJK has no mapping, the septets before it are kept */
+	ret = tcore_util_utf8_to_gsm7bit("ab\xE4\xB8\xAD", 5, septets, sizeof(septets), &len);
+	if (ret != TCORE_RETURN_EINVAL || len != 2) {
+		printf("unmappable character not reported\n");
+		failed++;
+	}
+
+	ret = tcore_util_utf8_to_gsm7bit("a\xC3", 2, septets, sizeof(septets), &len);
+	if (ret != TCORE_RETURN_EINVAL || len != 1) {
+		printf("truncated UTF-8 sequence not reported\n");
+		failed++;
+	}
+
+	/* An escape pair is not split over the end of dest */
+	ret = tcore_util_utf8_to_gsm7bit("a\xE2\x82\xAC", 4, septets, 2, &len);
+	if (ret != TCORE_RETURN_EMSGSIZE || len != 1) {
+		printf("short septet buffer not reported\n");
+		failed++;
+	}
+
+	/* Room for "@" and the NUL, not for the two octets of the pound sign */
+	ret = tcore_util_gsm7bit_to_utf8(vectors[0].septets, 2, utf8, 3, &len);
+	if (ret != TCORE_RETURN_EMSGSIZE || len != 1 || strcmp(utf8, "@") != 0) {
+		printf("short UTF-8 buffer not reported\n");
+		failed++;
+	}
+
+	if (tcore_util_gsm7bit_pack(vectors[0].septets, 4, 7, (unsigned char *) utf8,
+				sizeof(utf8), NULL) != TCORE_RETURN_EINVAL) {
+		printf("7 fill bits accepted\n");
+		failed++;
+	}
+
+	return failed;
+}
+
+/* A septet stream that converts back to itself: escapes only in front of
+ * a code with an extension entry.
+ */
+static unsigned int _random_text(unsigned char *septets, unsigned int len)
+{
+	static const unsigned char ext[] = { 0x0A, 0x14, 0x28, 0x29, 0x2F, 0x3C, 0x3D, 0x3E, 0x40, 0x65 };
+	unsigned int i = 0;
+
+	while (i < len) {
+		if (i + 1 < len && test_rand() % 8 == 0) {
+			septets[i++] = GSM7_ESC;
+			septets[i++] = ext[test_rand() % sizeof(ext)];
+			continue;
+		}
+
+		septets[i] = test_rand() & 0x7F;
+		if (septets[i] != GSM7_ESC)
+			i++;
+	}
+
+	return i;
+}
+
+static int _check_utf8(void)
+{
+	unsigned char septets[CHECK_LENGTH_MAX];
+	unsigned char back[CHECK_LENGTH_MAX];
+	char utf8[CHECK_LENGTH_MAX * 3 + 1];
+	unsigned int len, utf8_len, count;
+	unsigned int i;
+	int failed = 0;
+
+	/* Every septet of the default alphabet on its own */
+	for (i = 0; i < 128; i++) {
+		if (i == GSM7_ESC)
+			continue;
+
+		septets[0] = i;
+		if (tcore_util_gsm7bit_to_utf8(septets, 1, utf8, sizeof(utf8), &utf8_len)
+				!= TCORE_RETURN_SUCCESS
+				|| tcore_util_utf8_to_gsm7bit(utf8, utf8_len, back, sizeof(back), &count)
+				!= TCORE_RETURN_SUCCESS || count != 1 || back[0] != i) {
+			printf("septet 0x%02x does not round trip through UTF-8\n", i);
+			failed++;
+		}
+	}
+
+	for (i = 0; i < 2000 && failed < 10; i++) {
+		len = _random_text(septets, test_rand() % CHECK_LENGTH_MAX);
+
+		if (tcore_util_gsm7bit_to_utf8(septets, len, utf8, sizeof(utf8), &utf8_len)
+				!= TCORE_RETURN_SUCCESS
+				|| g_utf8_validate(utf8, utf8_len, NULL) == FALSE
+				|| tcore_util_utf8_to_gsm7bit(utf8, utf8_len, back, sizeof(back), &count)
+				!= TCORE_RETURN_SUCCESS
+				|| count != len || memcmp(back, septets, len) != 0) {
+			printf("text of %u septets does not round trip through UTF-8\n", len);
+			failed++;
+		}
+	}
+
+	return failed;
+}
+
+static int _self_test(void)
+{
+	unsigned char septets[CHECK_LENGTH_MAX];
+	unsigned int len, fill_bits;
+	int failed = 0;
+
+	for (len = 0; len < CHECK_LENGTH_MAX; len++)
+		septets[len] = test_rand() & 0x7F;
+
+	for (fill_bits = 0; fill_bits <= 6; fill_bits++) {
+		for (len = 0; len < CHECK_LENGTH_MAX && failed < 10; len++)
+			failed += _check_length(septets, len, fill_bits);
+	}
+
+	for (len = 1; len < CHECK_LENGTH_MAX && failed < 10; len++)
+		failed += _check_legacy(septets, len);
+
+	failed += _check_vectors();
+	failed += _check_utf8();
+
+	return failed ? -1 : 0;
+}
+
+static double _rate(gint64 start, unsigned int rounds, unsigned int len)
+{
+	gint64 elapsed = g_get_monotonic_time() - start;
+
+	if (elapsed <= 0)
+		elapsed = 1;
+
+	return ((double) rounds * len) / elapsed;
+}
+
+static void _bench(const struct bench_size *size, const unsigned char *septets, unsigned int total)
+{
+	static unsigned char packed[BENCH_LENGTH_MAX];
+	static unsigned char out[BENCH_LENGTH_MAX + 8];
+	unsigned int rounds = total / size->len + 1;
+	unsigned int packed_len = 0;
+	unsigned int count;
+	unsigned char *legacy;
+	double pack_legacy, pack, unpack_legacy, unpack;
+	gint64 start;
+	unsigned int i;
+
+	/* The helpers have no fill bits, they are timed without them */
+	start = g_get_monotonic_time();
+	for (i = 0; i < rounds; i++) {
+		legacy = _legacy_pack(septets, size->len);
+		free(legacy);
+	}
+	pack_legacy = _rate(start, rounds, size->len);
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < rounds; i++)
+		tcore_util_gsm7bit_pack(septets, size->len, size->fill_bits,
+				packed, sizeof(packed), &packed_len);
+	pack = _rate(start, rounds, size->len);
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < rounds; i++) {
+		legacy = _legacy_unpack(packed, packed_len);
+		free(legacy);
+	}
+	unpack_legacy = _rate(start, rounds, size->len);
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < rounds; i++)
+		tcore_util_gsm7bit_unpack(packed, packed_len, size->fill_bits,
+				out, size->len, &count);
+	unpack = _rate(start, rounds, size->len);
+
+	printf("%-3s %4u septets: pack   bit by bit %8.1f MB/s  gsm7bit_pack   %8.1f MB/s  x%.2f\n",
+			size->name, size->len, pack_legacy, pack, pack / pack_legacy);
+	printf("%-3s %4u septets: unpack bit by bit %8.1f MB/s  gsm7bit_unpack %8.1f MB/s  x%.2f\n",
+			size->name, size->len, unpack_legacy, unpack, unpack / unpack_legacy);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned char *septets;
+	unsigned int total = 16;
+	unsigned int i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "m:")) != -1) {
+		switch (opt) {
+			case 'm':
+				total = strtoul(optarg, NULL, 0);
+				break;
+
+			default:
+				fprintf(stderr, "usage: %s [-m MB per size]\n", argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (_self_test() < 0) {
+		printf("FAIL: GSM 7-bit codec differs from the reference\n");
+		return EXIT_FAILURE;
+	}
+	printf("self-test: GSM 7-bit codec matches the bit by bit packer and helpers\n");
+
+	septets = malloc(BENCH_LENGTH_MAX);
+	if (!septets)
+		return EXIT_FAILURE;
+
+	for (i = 0; i < BENCH_LENGTH_MAX; i++)
+		septets[i] = test_rand() & 0x7F;
+
+	for (i = 0; i < sizeof(bench_sizes) / sizeof(bench_sizes[0]); i++)
+		_bench(&bench_sizes[i], septets, total * 1000000);
+
+	free(septets);
+
+	return EXIT_SUCCESS;
+}
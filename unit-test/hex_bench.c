@@ -0,0 +1,271 @@
+/*
+ * libtcore
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Hex codec self-test and benchmark.
+ *
+ * Self-test: tcore_util_hex_encode() against a sprintf("%02X") loop and
+ * tcore_util_hex_decode() against tcore_util_decode_hex(), in both cases,
+ * for every length up to 300 octets and every alignment. A bad character
+ * at any position must be reported with the octets decoded before it.
+ *
+ * Benchmark: SMS TPDU (176 octets), SAT proactive command (255 octets)
+ * and larger buffers, against the sprintf loop and tcore_util_decode_hex()
+ * with its calloc()/free(), in MB of octets per second.
+ *
+ *   hex_bench [-m MB per size]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "tcore.h"
+#include "util.h"
+
+#include "test_util.h"
+
+#define CHECK_LENGTH_MAX	300
+#define BENCH_LENGTH_MAX	4096
+
+struct bench_size {
+	const char *name;
+	unsigned int len;
+};
+
+static const struct bench_size bench_sizes[] = {
+	{ "SMS", 176 },
+	{ "SAT", 255 },
+	{ "1K", 1024 },
+	{ "4K", BENCH_LENGTH_MAX },
+};
+
+static void _encode_sprintf(const unsigned char *src, unsigned int len, char *dest)
+{
+	unsigned int i;
+
+	for (i = 0; i < len; i++)
+		sprintf(dest + i * 2, "%02X", src[i]);
+
+	dest[len * 2] = '\0';
+}
+
+static int _check_length(const unsigned char *src, unsigned int len, unsigned int align)
+{
+	char ref[CHECK_LENGTH_MAX * 2 + 1];
+	char hex[CHECK_LENGTH_MAX * 2 + 16 + 1];
+	unsigned char out[CHECK_LENGTH_MAX + 16];
+	unsigned char *legacy;
+	unsigned int decoded;
+	unsigned int i;
+	TReturn ret;
+
+	_encode_sprintf(src, len, ref);
+
+	ret = tcore_util_hex_encode(src, len, hex + align, len * 2 + 1);
+	if (ret != TCORE_RETURN_SUCCESS || strcmp(hex + align, ref) != 0) {
+		printf("encode mismatch: length %u, alignment %u\n", len, align);
+		return 1;
+	}
+
+	ret = tcore_util_hex_decode(hex + align, len * 2, out + align, len, &decoded);
+	if (ret != TCORE_RETURN_SUCCESS || decoded != len || memcmp(out + align, src, len) != 0) {
+		printf("decode mismatch: length %u, alignment %u\n", len, align);
+		return 1;
+	}
+
+	if (len > 0) {
+		legacy = tcore_util_decode_hex(hex + align, len);
+		if (!legacy || memcmp(legacy, src, len) != 0) {
+			printf("legacy decode differs: length %u, alignment %u\n", len, align);
+			free(legacy);
+			return 1;
+		}
+		free(legacy);
+	}
+
+	/* Lower case decodes the same */
+	for (i = 0; i < len * 2; i++)
+		hex[align + i] = g_ascii_tolower(hex[align + i]);
+
+	ret = tcore_util_hex_decode(hex + align, len * 2, out + align, len, &decoded);
+	if (ret != TCORE_RETURN_SUCCESS || memcmp(out + align, src, len) != 0) {
+		printf("lower case decode mismatch: length %u, alignment %u\n", len, align);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int _check_errors(const unsigned char *src)
+{
+	static const char bad[] = { 'G', 'g', 'x', ' ', '/', ':', '@', '`', '\0', (char) 0xB0 };
+	char hex[64 * 2 + 1];
+	unsigned char out[64];
+	unsigned int decoded;
+	unsigned int pos;
+	unsigned int i;
+	char saved;
+	int failed = 0;
+
+	tcore_util_hex_encode(src, 64, hex, sizeof(hex));
+
+	for (pos = 0; pos < 64 * 2; pos++) {
+		saved = hex[pos];
+
+		for (i = 0; i < sizeof(bad); i++) {
+			hex[pos] = bad[i];
+			if (tcore_util_hex_decode(hex, 64 * 2, out, sizeof(out), &decoded)
+					!= TCORE_RETURN_EINVAL || decoded != pos / 2) {
+				printf("bad character 0x%02x at %u not reported\n",
+						(unsigned char) bad[i], pos);
+				failed++;
+			}
+		}
+
+		hex[pos] = saved;
+	}
+
+	if (tcore_util_hex_decode(hex, 63, out, sizeof(out), &decoded) != TCORE_RETURN_EINVAL) {
+		printf("odd length accepted\n");
+		failed++;
+	}
+
+	if (tcore_util_hex_decode(hex, 64 * 2, out, 63, &decoded) != TCORE_RETURN_EMSGSIZE) {
+		printf("short decode buffer accepted\n");
+		failed++;
+	}
+
+	if (tcore_util_hex_encode(src, 64, hex, 64 * 2) != TCORE_RETURN_EMSGSIZE) {
+		printf("encode buffer without room for the NUL accepted\n");
+		failed++;
+	}
+
+	return failed;
+}
+
+static int _self_test(void)
+{
+	unsigned char src[CHECK_LENGTH_MAX];
+	unsigned int len, align;
+	int failed = 0;
+
+	for (len = 0; len < CHECK_LENGTH_MAX; len++)
+		src[len] = test_rand();
+
+	for (len = 0; len <= CHECK_LENGTH_MAX && failed < 10; len++) {
+		for (align = 0; align < 16; align++)
+			failed += _check_length(src, len, align);
+	}
+
+	failed += _check_errors(src);
+
+	return failed ? -1 : 0;
+}
+
+static double _rate(gint64 start, unsigned int rounds, unsigned int len)
+{
+	gint64 elapsed = g_get_monotonic_time() - start;
+
+	if (elapsed <= 0)
+		elapsed = 1;
+
+	return ((double) rounds * len) / elapsed;
+}
+
+static void _bench(const struct bench_size *size, const unsigned char *src, unsigned int total)
+{
+	static char hex[BENCH_LENGTH_MAX * 2 + 1];
+	static unsigned char out[BENCH_LENGTH_MAX];
+	unsigned int rounds = total / size->len + 1;
+	unsigned int decoded;
+	unsigned char *legacy;
+	double enc_sprintf, enc, dec_legacy, dec;
+	gint64 start;
+	unsigned int i;
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < rounds; i++)
+		_encode_sprintf(src, size->len, hex);
+	enc_sprintf = _rate(start, rounds, size->len);
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < rounds; i++)
+		tcore_util_hex_encode(src, size->len, hex, sizeof(hex));
+	enc = _rate(start, rounds, size->len);
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < rounds; i++) {
+		legacy = tcore_util_decode_hex(hex, size->len);
+		free(legacy);
+	}
+	dec_legacy = _rate(start, rounds, size->len);
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < rounds; i++)
+		tcore_util_hex_decode(hex, size->len * 2, out, sizeof(out), &decoded);
+	dec = _rate(start, rounds, size->len);
+
+	printf("%-3s %4u octets: encode sprintf %8.1f MB/s  hex_encode %8.1f MB/s  x%.2f\n",
+			size->name, size->len, enc_sprintf, enc, enc / enc_sprintf);
+	printf("%-3s %4u octets: decode_hex     %8.1f MB/s  hex_decode %8.1f MB/s  x%.2f\n",
+			size->name, size->len, dec_legacy, dec, dec / dec_legacy);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned char *src;
+	unsigned int total = 16;
+	unsigned int i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "m:")) != -1) {
+		switch (opt) {
+			case 'm':
+				total = strtoul(optarg, NULL, 0);
+				break;
+
+			default:
+				fprintf(stderr, "usage: %s [-m MB per size]\n", argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (_self_test() < 0) {
+		printf("FAIL: hex codec differs from the reference\n");
+		return EXIT_FAILURE;
+	}
+	printf("self-test: hex codec matches sprintf and tcore_util_decode_hex\n");
+
+	src = malloc(BENCH_LENGTH_MAX);
+	if (!src)
+		return EXIT_FAILURE;
+
+	for (i = 0; i < BENCH_LENGTH_MAX; i++)
+		src[i] = test_rand();
+
+	for (i = 0; i < sizeof(bench_sizes) / sizeof(bench_sizes[0]); i++)
+		_bench(&bench_sizes[i], src, total * 1000000);
+
+	free(src);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,294 @@
+/*
+ * libtcore
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Marshal benchmark, binary against text wire format.
+ *
+ * Two payloads: a call status notification (a flat table of a few fields)
+ * and a phonebook read response (one nested table per record). Each is
+ * serialized and deserialized with both formats, and the decoded tables
+ * must be equal to the original, otherwise the run fails.
+ *
+ *   marshal_bench [-n iterations] [-r phonebook records]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "tcore.h"
+#include "util.h"
+
+struct bench_result {
+	gsize size;
+	gint64 encode;
+	gint64 decode;
+};
+
+static GHashTable *_call_status(void)
+{
+	GHashTable *ht = tcore_util_marshal_create();
+	gint id = 3, status = 4, type = 1;
+	gboolean mt = TRUE;
+	gdouble duration = 127.25;
+
+	tcore_util_marshal_add_data(ht, "id", &id, TCORE_UTIL_MARSHAL_DATA_INT_TYPE);
+	tcore_util_marshal_add_data(ht, "status", &status, TCORE_UTIL_MARSHAL_DATA_INT_TYPE);
+	tcore_util_marshal_add_data(ht, "type", &type, TCORE_UTIL_MARSHAL_DATA_INT_TYPE);
+	tcore_util_marshal_add_data(ht, "mt", &mt, TCORE_UTIL_MARSHAL_DATA_BOOLEAN_TYPE);
+	tcore_util_marshal_add_data(ht, "duration", &duration, TCORE_UTIL_MARSHAL_DATA_DOUBLE_TYPE);
+	tcore_util_marshal_add_data(ht, "number", "+821012345678", TCORE_UTIL_MARSHAL_DATA_STRING_TYPE);
+
+	return ht;
+}
+
+static GHashTable *_phonebook(int records)
+{
+	GHashTable *ht = tcore_util_marshal_create();
+	GHashTable *rec;
+	gchar key[16];
+	gchar name[32];
+	gchar number[24];
+	gboolean hidden;
+	gint i;
+
+	tcore_util_marshal_add_data(ht, "count", &records, TCORE_UTIL_MARSHAL_DATA_INT_TYPE);
+
+	for (i = 0; i < records; i++) {
+		rec = tcore_util_marshal_create();
+
+		snprintf(name, sizeof(name), "Contact %04d", i);
+		snprintf(number, sizeof(number), "+8210%08d", i * 7919);
+		hidden = (i % 5) == 0;
+
+		tcore_util_marshal_add_data(rec, "index", &i, TCORE_UTIL_MARSHAL_DATA_INT_TYPE);
+		tcore_util_marshal_add_data(rec, "name", name, TCORE_UTIL_MARSHAL_DATA_STRING_TYPE);
+		tcore_util_marshal_add_data(rec, "number", number, TCORE_UTIL_MARSHAL_DATA_STRING_TYPE);
+		tcore_util_marshal_add_data(rec, "hidden", &hidden, TCORE_UTIL_MARSHAL_DATA_BOOLEAN_TYPE);
+
+		snprintf(key, sizeof(key), "%d", i);
+		tcore_util_marshal_add_data(ht, key, rec, TCORE_UTIL_MARSHAL_DATA_OBJECT_TYPE);
+	}
+
+	return ht;
+}
+
+static gboolean _equal(GHashTable *a, GHashTable *b)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	GValue *va, *vb;
+
+	if (!a || !b || g_hash_table_size(a) != g_hash_table_size(b))
+		return FALSE;
+
+	g_hash_table_iter_init(&iter, a);
+	while (g_hash_table_iter_next(&iter, &key, &value) == TRUE) {
+		va = value;
+		vb = g_hash_table_lookup(b, key);
+		if (!vb || G_VALUE_TYPE(va) != G_VALUE_TYPE(vb))
+			return FALSE;
+
+		switch (G_VALUE_TYPE(va)) {
+			case G_TYPE_BOOLEAN:
+				if (g_value_get_boolean(va) != g_value_get_boolean(vb))
+					return FALSE;
+				break;
+
+			case G_TYPE_INT:
+				if (g_value_get_int(va) != g_value_get_int(vb))
+					return FALSE;
+				break;
+
+			case G_TYPE_DOUBLE:
+				if (g_value_get_double(va) != g_value_get_double(vb))
+					return FALSE;
+				break;
+
+			case G_TYPE_STRING:
+				if (g_strcmp0(g_value_get_string(va), g_value_get_string(vb)) != 0)
+					return FALSE;
+				break;
+
+			default:
+				if (G_VALUE_TYPE(va) != G_TYPE_HASH_TABLE
+						|| !_equal(g_value_get_boxed(va), g_value_get_boxed(vb)))
+					return FALSE;
+				break;
+		}
+	}
+
+	return TRUE;
+}
+
+static gboolean _run_text(GHashTable *ht, int iterations, struct bench_result *res)
+{
+	GHashTable *out = NULL;
+	gchar *str = NULL;
+	gint64 start;
+	gboolean ok;
+	int i;
+
+	memset(res, 0, sizeof(struct bench_result));
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < iterations; i++) {
+		g_free(str);
+		str = tcore_util_marshal_serialize(ht);
+	}
+	res->encode = g_get_monotonic_time() - start;
+	res->size = strlen(str);
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < iterations; i++) {
+		tcore_util_marshal_destory(out);
+		out = tcore_util_marshal_deserialize_string(str);
+	}
+	res->decode = g_get_monotonic_time() - start;
+
+	ok = _equal(ht, out);
+
+	tcore_util_marshal_destory(out);
+	g_free(str);
+
+	return ok;
+}
+
+static gboolean _run_binary(GHashTable *ht, int iterations, struct bench_result *res)
+{
+	GHashTable *out = NULL;
+	GByteArray *buf;
+	gint64 start;
+	gboolean ok;
+	int i;
+
+	memset(res, 0, sizeof(struct bench_result));
+
+	/* The caller owned buffer is reused, as it would be on an IPC path */
+	buf = g_byte_array_new();
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < iterations; i++) {
+		g_byte_array_set_size(buf, 0);
+		if (tcore_util_marshal_serialize_binary(ht, buf) == FALSE) {
+			g_byte_array_free(buf, TRUE);
+			return FALSE;
+		}
+	}
+	res->encode = g_get_monotonic_time() - start;
+	res->size = buf->len;
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < iterations; i++) {
+		tcore_util_marshal_destory(out);
+		out = tcore_util_marshal_deserialize_binary(buf->data, buf->len);
+	}
+	res->decode = g_get_monotonic_time() - start;
+
+	ok = _equal(ht, out);
+
+	tcore_util_marshal_destory(out);
+	g_byte_array_free(buf, TRUE);
+
+	return ok;
+}
+
+static void _report(const char *payload, const char *format, int iterations,
+		const struct bench_result *res)
+{
+	gint64 encode = res->encode > 0 ? res->encode : 1;
+	gint64 decode = res->decode > 0 ? res->decode : 1;
+
+	printf("%-10s %-6s: %7u octets  encode %9.0f ops/s %8.2f MB/s"
+			"  decode %9.0f ops/s %8.2f MB/s\n",
+			payload, format, (unsigned int) res->size,
+			iterations * 1000000.0 / encode,
+			(double) iterations * res->size / encode,
+			iterations * 1000000.0 / decode,
+			(double) iterations * res->size / decode);
+}
+
+static int _bench(const char *payload, GHashTable *ht, int iterations)
+{
+	struct bench_result text, binary;
+	int failed = 0;
+
+	if (_run_text(ht, iterations, &text) == FALSE) {
+		printf("%s: text format does not round trip\n", payload);
+		failed++;
+	}
+
+	if (_run_binary(ht, iterations, &binary) == FALSE) {
+		printf("%s: binary format does not round trip\n", payload);
+		failed++;
+	}
+
+	_report(payload, "text", iterations, &text);
+	_report(payload, "binary", iterations, &binary);
+
+	return failed;
+}
+
+int main(int argc, char *argv[])
+{
+	GHashTable *ht;
+	int iterations = 20000;
+	int records = 250;
+	int failed = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:r:")) != -1) {
+		switch (opt) {
+			case 'n':
+				iterations = atoi(optarg);
+				break;
+
+			case 'r':
+				records = atoi(optarg);
+				break;
+
+			default:
+				fprintf(stderr, "usage: %s [-n iterations] [-r phonebook records]\n", argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (iterations < 1 || records < 0) {
+		fprintf(stderr, "invalid iteration or record count\n");
+		return EXIT_FAILURE;
+	}
+
+	ht = _call_status();
+	failed += _bench("call", ht, iterations);
+	tcore_util_marshal_destory(ht);
+
+	/* A few hundred times fewer rounds, the payload is that much larger */
+	ht = _phonebook(records);
+	failed += _bench("phonebook", ht, iterations / 100 + 1);
+	tcore_util_marshal_destory(ht);
+
+	if (failed) {
+		printf("FAIL: decoded tables differ from the original\n");
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
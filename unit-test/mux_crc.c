@@ -0,0 +1,202 @@
+/*
+ * libtcore
+ *
+ * Copyright (c) 2012 Samsung Electronics Co., Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * CMUX FCS self-test and microbenchmark.
+ *
+ * The FCS kernels are internal to libtcore; src/mux_fcs.c is built into
+ * this program on its own, without the library.
+ *
+ * Self-test: crc_table against the 27.010 polynomial computed bit by bit,
+ * then slicing-by-8 against octet at a time folding for every length up
+ * to 1024 + 7 and some up to the largest N1, every alignment and start
+ * value. Any difference fails.
+ *
+ * Benchmark: both kernels on UI frame sized buffers, in MB/s.
+ *
+ *   mux_crc [-m MB per size]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "tcore.h"
+
+#include "../src/mux_fcs.h"
+#include "test_util.h"
+
+static const int bench_sizes[] = { 16, 64, 128, 512, 1500, 4096, 32767 };
+static const int long_sizes[] = { 2047, 2048, 4095, 4096, 4097, 32767 };
+
+/* 27.010 Annex B: reversed polynomial x^8 + x^2 + x + 1, bit by bit */
+static unsigned char _fold_bits(unsigned char FCS, const unsigned char *data, int length)
+{
+	int bit;
+
+	while (length-- > 0) {
+		FCS ^= *data++;
+		for (bit = 0; bit < 8; bit++)
+			FCS = (FCS & 0x01) ? (FCS >> 1) ^ 0xE0 : (FCS >> 1);
+	}
+
+	return FCS;
+}
+
+/* Both kernels and tcore_cmux_fcs_fold() for every alignment and start value */
+static int _check_length(const unsigned char *buf, int len)
+{
+	unsigned char ref;
+	int align, start;
+	int failed = 0;
+
+	for (align = 0; align < 8; align++) {
+		/* Every start value on short buffers, a sample on long ones */
+		for (start = 0; start < 256; start += (len <= 64) ? 1 : 37) {
+			ref = tcore_cmux_fcs_fold_octets(start, buf + align, len);
+
+			if (tcore_cmux_fcs_fold_slice8(start, buf + align, len) != ref
+					|| tcore_cmux_fcs_fold(start, buf + align, len) != ref
+					|| (len <= 512 && _fold_bits(start, buf + align, len) != ref)) {
+				printf("FCS mismatch: length %d, alignment %d, start 0x%02x\n",
+						len, align, start);
+				failed++;
+			}
+		}
+	}
+
+	return failed;
+}
+
+static int _self_test(void)
+{
+	unsigned char *buf;
+	unsigned char ref;
+	int len;
+	int failed = 0;
+	int i;
+
+	for (i = 0; i < 256; i++) {
+		ref = i;
+		if (crc_table[i] != _fold_bits(0, &ref, 1)) {
+			printf("crc_table[0x%02x] = 0x%02x, expected 0x%02x\n",
+					i, crc_table[i], _fold_bits(0, &ref, 1));
+			failed++;
+		}
+	}
+
+	if (!tcore_cmux_fcs_init()) {
+		printf("slicing-by-8 tables failed their own check\n");
+		failed++;
+	}
+
+	buf = malloc(32767 + 16);
+	if (!buf)
+		return -1;
+
+	for (i = 0; i < 32767 + 16; i++)
+		buf[i] = test_rand();
+
+	for (len = 0; len <= 1024 + 7 && failed < 10; len++)
+		failed += _check_length(buf, len);
+
+	for (i = 0; i < (int) (sizeof(long_sizes) / sizeof(long_sizes[0])); i++)
+		failed += _check_length(buf, long_sizes[i]);
+
+	/* FCS over a whole frame is 0xCF when the frame is received intact */
+	for (len = 1; len <= 4096; len++) {
+		ref = 0xFF - tcore_cmux_fcs_fold(0xFF, buf, len);
+		buf[len] = ref;
+		if (tcore_cmux_fcs_fold(0xFF, buf, len + 1) != 0xCF) {
+			if (failed++ < 10)
+				printf("Residue mismatch: length %d\n", len);
+		}
+	}
+
+	free(buf);
+
+	return failed ? -1 : 0;
+}
+
+static double _bench(unsigned char (*fold)(unsigned char, const unsigned char *, int),
+		const unsigned char *buf, int size, unsigned int total)
+{
+	volatile unsigned char sink = 0;
+	unsigned int rounds = total / size + 1;
+	unsigned int i;
+	gint64 start;
+	gint64 elapsed;
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < rounds; i++)
+		sink ^= fold(i, buf, size);
+	elapsed = g_get_monotonic_time() - start;
+	if (elapsed <= 0)
+		elapsed = 1;
+
+	return ((double) rounds * size) / elapsed;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned char *buf;
+	unsigned int total = 16;
+	double table, slice;
+	unsigned int i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "m:")) != -1) {
+		switch (opt) {
+			case 'm':
+				total = strtoul(optarg, NULL, 0);
+				break;
+
+			default:
+				fprintf(stderr, "usage: %s [-m MB per size]\n", argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (_self_test() < 0) {
+		printf("FAIL: slicing-by-8 FCS differs from crc_table\n");
+		return EXIT_FAILURE;
+	}
+	printf("self-test: slicing-by-8 FCS bit-identical to crc_table\n");
+
+	buf = malloc(32767);
+	if (!buf)
+		return EXIT_FAILURE;
+
+	for (i = 0; i < 32767; i++)
+		buf[i] = test_rand();
+
+	for (i = 0; i < sizeof(bench_sizes) / sizeof(bench_sizes[0]); i++) {
+		table = _bench(tcore_cmux_fcs_fold_octets, buf, bench_sizes[i], total * 1000000);
+		slice = _bench(tcore_cmux_fcs_fold_slice8, buf, bench_sizes[i], total * 1000000);
+
+		printf("%5d octets: table %8.1f MB/s  slicing-by-8 %8.1f MB/s  x%.2f\n",
+				bench_sizes[i], table, slice, slice / table);
+	}
+
+	free(buf);
+
+	return EXIT_SUCCESS;
+}